@@ -0,0 +1,387 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// Python module for batch processing with the plug-in's DSP.
+//
+//   import circulate, numpy as np
+//   fx = circulate.Effect(sample_rate=48000, channels=2)
+//   fx.set("depth", 1.0)
+//   fx.process(audio, center=np.linspace(0.2, 0.8, audio.shape[-1]), feedback=0.7)
+//
+// Audio is a C contiguous float32 or float64 array, shape (samples,) or (channels, samples), and
+// is processed in place. float32 is never copied, float64 goes through a chunk sized scratch
+// buffer. Parameters are normalised (0 to 1) as in the plug-in, given either as a constant or as
+// one value per sample, and go through the same AudioEffectParameters chunk/smoothing model as
+// host automation. The GIL is released while processing, so separate Effect instances scale
+// across a Python thread pool.
+//
+// render processes one whole file over several threads, cutting it in time (ParallelRender.h):
+//
+//   report = fx.render(audio, threads=8, verify=True)   # report["max_seam_error"]
+//
+// Batch runs many mono instances together, with the instances in SIMD lanes (BatchEffect.h):
+//
+//   batch = circulate.Batch(instances=1000, sample_rate=48000)
+//   batch.set("center", np.random.rand(1000))
+//   batch.process(audio)   # shape (1000, samples)
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "BatchEffect.h"
+#include "CirculateParameters.h"
+#include "DenormalProtection.h"
+#include "ParallelRender.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace {
+
+	struct NamedParameter {
+		const char* name;
+		int id;
+	};
+
+	const NamedParameter NamedParameters[] = {
+		{ "center", CIRCULATE_PARAMS::kCenter },
+		{ "note", CIRCULATE_PARAMS::kCenterST },
+		{ "center_type", CIRCULATE_PARAMS::kSetSwitch },
+		{ "note_offset", CIRCULATE_PARAMS::kNoteOffset },
+		{ "focus", CIRCULATE_PARAMS::kFocus },
+		{ "depth", CIRCULATE_PARAMS::kDepth },
+		{ "feedback", CIRCULATE_PARAMS::kFeed },
+		{ "sidechain_amount", CIRCULATE_PARAMS::kSidechain },
+		{ "chord", CIRCULATE_PARAMS::kChord },
+		{ "precision", CIRCULATE_PARAMS::kPrecision },
+		{ "engine", CIRCULATE_PARAMS::kEngine },
+		{ "spread", CIRCULATE_PARAMS::kSpread },
+		{ "spread_shape", CIRCULATE_PARAMS::kSpreadShape },
+		{ "stage_limit", CIRCULATE_PARAMS::kStageLimit },
+		{ "band_split", CIRCULATE_PARAMS::kBandSplit },
+	};
+
+	using RENDER::Automation;
+
+	class PythonEffect {
+	public:
+		PythonEffect(double sampleRate, int numChannels) :
+			Main(sampleRate, std::max(numChannels, 1)) {
+
+			if (numChannels < 1) {
+				throw std::invalid_argument("channels must be at least 1");
+			}
+		}
+
+		void reset() {
+			Main.reset();
+		}
+
+		/// <summary>
+		/// Set a parameter without smoothing, it keeps the value until changed
+		/// </summary>
+		void set(const std::string& name, double value) {
+			getUnit(name)->fillWith(value);
+		}
+
+		double get(const std::string& name) {
+			return getUnit(name)->getLastValue();
+		}
+
+		/// <summary>
+		/// Delay of the output in samples, non zero with the spectral engine or band split
+		/// </summary>
+		int getLatency() {
+			return Main.Effects[0].getLatency();
+		}
+
+		/// <summary>
+		/// Snapshot of the parameters and processing state, restore continues from it
+		/// </summary>
+		py::bytes checkpoint() {
+			std::vector<uint8_t> State = Main.saveCheckpoint();
+			return py::bytes(reinterpret_cast<const char*>(State.data()), State.size());
+		}
+
+		void restore(const py::bytes& State) {
+			std::string Buffer = State;
+			if (!Main.restoreCheckpoint(Buffer.data(), Buffer.size())) {
+				throw std::invalid_argument("checkpoint doesn't match this effect (sample rate, channels) or is damaged");
+			}
+		}
+
+		template <typename T>
+		void process(py::array_t<T, py::array::c_style> Buffer, py::object Sidechain, py::kwargs Parameters) {
+			Call<T> C(*this, Buffer, Sidechain, Parameters);
+
+			// Constants behave as a host sending one change, smoothed from the previous value
+			for (const Automation& A : C.Automations) {
+				if (!A.values) {
+					A.unit->lastExplicit = A.constant;
+				}
+			}
+
+			py::gil_scoped_release release;
+			Main.process(C.data, C.numSamples, C.numChannels, 0, C.numSamples, C.sidechain, C.Automations);
+		}
+
+		/// <summary>
+		/// Render a whole file from cleared memory, split in time over threads (see ParallelRender.h)
+		/// </summary>
+		template <typename T>
+		py::dict render(py::array_t<T, py::array::c_style> Buffer, py::object Sidechain, int threads, double preroll, bool verify, py::kwargs Parameters) {
+			Call<T> C(*this, Buffer, Sidechain, Parameters);
+
+			RENDER::RenderOptions Options;
+			Options.numThreads = threads > 0 ? threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+			Options.prerollSeconds = preroll;
+			Options.verify = verify;
+
+			RENDER::RenderReport Report;
+			{
+				py::gil_scoped_release release;
+				Report = RENDER::renderParallel(Main, Pool, C.data, C.numChannels, C.numSamples, C.sidechain, C.Automations, Options);
+			}
+
+			py::dict Result;
+			Result["chunks"] = Report.numChunks;
+			Result["preroll"] = Report.prerollSamples;
+			Result["feedback"] = Report.feedback;
+			if (verify) {
+				Result["max_seam_error"] = Report.maxSeamError;
+				Result["max_seam_error_position"] = Report.maxSeamErrorPosition;
+			}
+			return Result;
+		}
+
+	private:
+		RENDER::Instance Main;
+		WorkerPool Pool;
+
+		CIRCULATE_PARAMS::ParamUnit* getUnit(const std::string& name) {
+			for (const NamedParameter& P : NamedParameters) {
+				if (name == P.name) {
+					return Main.Params.getParameter(P.id);
+				}
+			}
+			throw std::invalid_argument("unknown parameter '" + name + "'");
+		}
+
+		/// <summary>
+		/// Arguments of a process or render call, checked and converted. Holds the converted
+		/// arrays until processing is done
+		/// </summary>
+		template <typename T>
+		struct Call {
+			Call(PythonEffect& Effect, py::array_t<T, py::array::c_style>& Buffer, py::object& Sidechain, py::kwargs& Parameters) {
+				if (Buffer.ndim() != 1 && Buffer.ndim() != 2) {
+					throw std::invalid_argument("audio must have shape (samples,) or (channels, samples)");
+				}
+				if (!Buffer.writeable()) {
+					throw std::invalid_argument("audio must be writeable, it is processed in place");
+				}
+
+				numChannels = Buffer.ndim() == 1 ? 1 : static_cast<int>(Buffer.shape(0));
+				numSamples = Buffer.shape(Buffer.ndim() - 1);
+				if (numChannels > Effect.Main.getNumChannels()) {
+					throw std::invalid_argument("audio has more channels than the effect");
+				}
+
+				for (auto item : Parameters) {
+					Automation A;
+					A.unit = Effect.getUnit(py::str(item.first));
+
+					auto Values = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(item.second);
+					if (!Values) {
+						throw std::invalid_argument("parameter values must be numbers or arrays");
+					}
+
+					if (Values.ndim() == 0) {
+						A.constant = *Values.data();
+					}
+					else if (Values.ndim() == 1 && Values.shape(0) == numSamples) {
+						A.values = Values.data();
+						Arrays.push_back(Values);
+					}
+					else {
+						throw std::invalid_argument("per sample parameters must be 1d with one value per sample");
+					}
+					Automations.push_back(A);
+				}
+
+				if (!Sidechain.is_none()) {
+					SidechainArray = py::array_t<float, py::array::c_style | py::array::forcecast>::ensure(Sidechain);
+					if (!SidechainArray || SidechainArray.ndim() != 1 || SidechainArray.shape(0) != numSamples) {
+						throw std::invalid_argument("sidechain must be 1d with one value per sample");
+					}
+					sidechain = SidechainArray.data();
+				}
+
+				data = Buffer.mutable_data();
+			}
+
+			std::vector<py::array_t<double, py::array::c_style | py::array::forcecast>> Arrays;
+			py::array_t<float, py::array::c_style | py::array::forcecast> SidechainArray;
+			std::vector<Automation> Automations;
+
+			T* data = nullptr;
+			const float* sidechain = nullptr;
+			int numChannels = 1;
+			long long numSamples = 0;
+		};
+	};
+
+	/// <summary>
+	/// Many mono instances processed together (BatchEffect.h), for rendering large numbers of
+	/// independent chains
+	/// </summary>
+	class PythonBatch {
+	public:
+		PythonBatch(int instances, double sampleRate, double stageLimit) {
+			if (instances < 1) {
+				throw std::invalid_argument("instances must be at least 1");
+			}
+			Batch.prepare(instances, sampleRate, CIRCULATE_PARAMS::getStageLimit(stageLimit));
+			Inputs.resize(instances);
+		}
+
+		void reset() {
+			Batch.reset();
+		}
+
+		/// <summary>
+		/// Set a parameter of every instance, one value for all or one per instance
+		/// </summary>
+		void set(const std::string& name, py::object Value) {
+			int id = getID(name);
+			auto Values = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(Value);
+			if (!Values) {
+				throw std::invalid_argument("parameter values must be numbers or arrays");
+			}
+
+			if (Values.ndim() == 0) {
+				for (int i = 0; i < Batch.getNumInstances(); i++) {
+					Batch.setParameter(id, i, *Values.data());
+				}
+			}
+			else if (Values.ndim() == 1 && Values.shape(0) == Batch.getNumInstances()) {
+				Batch.setParameter(id, Values.data());
+			}
+			else {
+				throw std::invalid_argument("give one value, or one per instance");
+			}
+		}
+
+		py::list get(const std::string& name) {
+			int id = getID(name);
+			py::list Values;
+			for (int i = 0; i < Batch.getNumInstances(); i++) {
+				Values.append(Batch.getParameter(id, i));
+			}
+			return Values;
+		}
+
+		int getNumInstances() {
+			return Batch.getNumInstances();
+		}
+
+		size_t getMemorySize() {
+			return Batch.getMemorySize();
+		}
+
+		/// <summary>
+		/// Process float32 audio of shape (instances, samples) in place, row i through instance i
+		/// </summary>
+		void process(py::array_t<float, py::array::c_style> Buffer) {
+			if (Buffer.ndim() != 2 || Buffer.shape(0) != Batch.getNumInstances()) {
+				throw std::invalid_argument("audio must have shape (instances, samples)");
+			}
+			if (!Buffer.writeable()) {
+				throw std::invalid_argument("audio must be writeable, it is processed in place");
+			}
+
+			long long numSamples = Buffer.shape(1);
+			float* data = Buffer.mutable_data();
+
+			py::gil_scoped_release release;
+			DenormalHandler AntiDenormal;
+
+			for (long long position = 0; position < numSamples; position += PROCESS_CHUNK_SIZE) {
+				int n = static_cast<int>(std::min<long long>(PROCESS_CHUNK_SIZE, numSamples - position));
+				for (size_t i = 0; i < Inputs.size(); i++) {
+					Inputs[i] = data + i * numSamples + position;
+				}
+				Batch.process(Inputs.data(), Inputs.data(), n);
+			}
+		}
+
+	private:
+		BatchEffect Batch;
+		std::vector<float*> Inputs;
+
+		static int getID(const std::string& name) {
+			for (const char* batchName : { "center", "focus", "depth", "feedback" }) {
+				if (name == batchName) {
+					for (const NamedParameter& P : NamedParameters) {
+						if (name == P.name) {
+							return P.id;
+						}
+					}
+				}
+			}
+			throw std::invalid_argument("batches have center, focus, depth and feedback, not '" + name + "'");
+		}
+	};
+}
+
+PYBIND11_MODULE(circulate, m) {
+	m.doc() = "Circulate allpass dispersion effect";
+
+	py::class_<PythonEffect>(m, "Effect")
+		.def(py::init<double, int>(), py::arg("sample_rate") = 48000.0, py::arg("channels") = 2)
+		.def("reset", &PythonEffect::reset, "Clear the filter memory")
+		.def("set", &PythonEffect::set, py::arg("name"), py::arg("value"), "Set a normalised parameter value, without smoothing")
+		.def("get", &PythonEffect::get, py::arg("name"))
+		.def("checkpoint", &PythonEffect::checkpoint,
+			"Snapshot of the parameters, their smoothing and the filter memory, as bytes")
+		.def("restore", &PythonEffect::restore, py::arg("state"),
+			"Continue from a checkpoint, taken by an effect with the same sample rate and channels")
+		.def_property_readonly("latency", &PythonEffect::getLatency, "Delay of the output in samples (spectral engine, band split)")
+		.def("process", &PythonEffect::process<float>, py::arg("audio").noconvert(), py::arg("sidechain") = py::none(),
+			"Process float32 audio in place. Keyword arguments set parameters, as a constant or one normalised value per sample")
+		.def("process", &PythonEffect::process<double>, py::arg("audio").noconvert(), py::arg("sidechain") = py::none(),
+			"Process float64 audio in place")
+		.def("render", &PythonEffect::render<float>, py::arg("audio").noconvert(), py::arg("sidechain") = py::none(),
+			py::arg("threads") = 0, py::arg("preroll") = -1.0, py::arg("verify") = false,
+			"Render a whole file in place from cleared memory, split in time over threads (all cores with 0). Without feedback "
+			"each chunk is warmed up on a pre-roll, in seconds, estimated from the parameters when negative. Returns the chunks "
+			"and pre-roll used, and with verify the largest difference from serial rendering")
+		.def("render", &PythonEffect::render<double>, py::arg("audio").noconvert(), py::arg("sidechain") = py::none(),
+			py::arg("threads") = 0, py::arg("preroll") = -1.0, py::arg("verify") = false,
+			"Render float64 audio in place");
+
+	py::class_<PythonBatch>(m, "Batch")
+		.def(py::init<int, double, double>(), py::arg("instances"), py::arg("sample_rate") = 48000.0, py::arg("stage_limit") = 0.0)
+		.def("reset", &PythonBatch::reset, "Clear the filter memory of every instance")
+		.def("set", &PythonBatch::set, py::arg("name"), py::arg("value"),
+			"Set center, focus, depth or feedback, one value for all instances or one per instance. Takes effect at once "
+			"before the first block and after reset, later changes are smoothed")
+		.def("get", &PythonBatch::get, py::arg("name"))
+		.def_property_readonly("instances", &PythonBatch::getNumInstances)
+		.def_property_readonly("memory", &PythonBatch::getMemorySize, "Bytes of state for all instances")
+		.def("process", &PythonBatch::process, py::arg("audio").noconvert(),
+			"Process float32 audio of shape (instances, samples) in place, each row through its own mono instance");
+
+	py::list names;
+	for (const NamedParameter& P : NamedParameters) {
+		names.append(P.name);
+	}
+	m.attr("parameters") = names;
+}
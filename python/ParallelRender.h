@@ -0,0 +1,454 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "CirculateEffect.h"
+#include "CirculateParameters.h"
+#include "DenormalProtection.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Shortest pre-roll, long enough for the parameter, note and sidechain smoothers to settle
+#define RENDER_MIN_PREROLL_SECONDS 0.25
+// Time constants of the slowest stage to pre-roll, per stage on top of its group delay, plus a fixed tail
+#define RENDER_DECAY_PER_STAGE 2.0
+#define RENDER_DECAY_TAIL 30.0
+
+/// <summary>
+/// Processing of whole buffers for the Python module, serially or split in time over threads.
+///
+/// Without feedback the cascade forgets its input: each stage's memory decays with a time
+/// constant of 1 / (R * w) (w the stage's center, R from the focus), once its input has passed
+/// through: at DC each stage delays by 4R / w, which at low focus is several time constants.
+/// So a file can be cut into chunks, each rendered by its own effects on its own thread, after
+/// warming them up on a pre-roll of the audio before the chunk. The pre-roll is sized from the slowest stage the
+/// parameters reach over the file, and the seams match serial rendering to within the decay
+/// left after it, which renderParallel can measure (verify).
+/// </summary>
+namespace RENDER {
+
+	/// <summary>
+	/// A parameter for one process call, either constant or one value per sample
+	/// </summary>
+	struct Automation {
+		CIRCULATE_PARAMS::ParamUnit* unit = nullptr;
+		const double* values = nullptr; // nullptr when constant
+		double constant = 0.0;
+	};
+
+	/// <summary>
+	/// Parameters and one effect per channel, processing whole buffers in chunks as the processor does
+	/// </summary>
+	class Instance {
+	public:
+		Instance(double sampleRate, int numChannels) :
+			Params(static_cast<int>(sampleRate)),
+			Effects(numChannels),
+			Scratch(PROCESS_CHUNK_SIZE),
+			mSampleRate(sampleRate) {
+
+			HELPERS::SetupInfo Setup;
+			Setup.blockSize = PROCESS_CHUNK_SIZE;
+			Setup.sampleRate = sampleRate;
+			for (auto& Effect : Effects) {
+				Effect.setSampleRateBlockSize(Setup);
+				Effect.getParams(&Params);
+				Effect.reset();
+			}
+		}
+
+		// The effects point at Params
+		Instance(const Instance&) = delete;
+		Instance& operator=(const Instance&) = delete;
+
+		void reset() {
+			for (auto& Effect : Effects) {
+				Effect.reset();
+			}
+		}
+
+		double getSampleRate() const {
+			return mSampleRate;
+		}
+
+		int getNumChannels() const {
+			return static_cast<int>(Effects.size());
+		}
+
+		/// <summary>
+		/// The same parameter of this instance (automations are made for one instance)
+		/// </summary>
+		CIRCULATE_PARAMS::ParamUnit* getUnit(CIRCULATE_PARAMS::ParamUnit* Other) {
+			return Params.getParameter(Other->getID());
+		}
+
+		/// <summary>
+		/// Take the parameters (with their smoothing) and processing state of another instance,
+		/// so this one continues as the other would. Doesn't allocate if the stage limits match
+		/// </summary>
+		void copyStateFrom(Instance& Other) {
+			for (size_t p = 0; p < Params.ParameterList.size(); p++) {
+				*Params.ParameterList[p] = *Other.Params.ParameterList[p];
+			}
+			for (size_t c = 0; c < Effects.size(); c++) {
+				Effects[c].setStageLimit(Other.Effects[c].getStageLimit());
+				Effects[c].copyStateFrom(Other.Effects[c]);
+			}
+		}
+
+		/// <summary>
+		/// Snapshot of the parameters (with their smoothing) and the processing state of every
+		/// channel, see Checkpoint.h. An instance at the same sample rate with the same channels
+		/// continues from it exactly as this one would
+		/// </summary>
+		std::vector<uint8_t> saveCheckpoint() const {
+			CHECKPOINT::Writer Counter;
+			saveState(Counter);
+			std::vector<uint8_t> Buffer(Counter.getSize());
+			CHECKPOINT::Writer Out(Buffer.data(), Buffer.size());
+			saveState(Out);
+			return Buffer;
+		}
+
+		/// <summary>
+		/// Continue from a snapshot. Resets the effects if it doesn't fit this instance
+		/// </summary>
+		bool restoreCheckpoint(const void* buffer, size_t size) {
+			CHECKPOINT::Reader In(buffer, size);
+			int32_t numChannels = 0;
+			bool ok = In.read(numChannels) && numChannels == getNumChannels() && Params.restoreState(In);
+			for (auto& Effect : Effects) {
+				ok = ok && Effect.restoreState(In);
+			}
+			if (ok && In.isComplete()) {
+				return true;
+			}
+			reset();
+			return false;
+		}
+
+		/// <summary>
+		/// Process samples first to last - 1 of a buffer in place. Automation values and the
+		/// sidechain are indexed by sample position, the audio of channel c starts at
+		/// data + c * channelStride, which holds sample first
+		/// </summary>
+		template <typename T>
+		void process(T* data, long long channelStride, int numChannels, long long first, long long last,
+			const float* sidechain, const std::vector<Automation>& Automations) {
+			DenormalHandler AntiDenormal;
+
+			// Not realtime, so a new stage limit is applied straight away (allocates and clears the memory)
+			int stageLimit = CIRCULATE_PARAMS::getStageLimit(Params.StageLimit.getLastValue());
+			for (auto& Effect : Effects) {
+				Effect.setStageLimit(stageLimit);
+			}
+
+			// Same chunks as the processor
+			for (long long position = first; position < last; position += PROCESS_CHUNK_SIZE) {
+				int n = static_cast<int>(std::min<long long>(PROCESS_CHUNK_SIZE, last - position));
+
+				Params.setCurrentBlockSizeAndPreFill(n);
+				for (const Automation& A : Automations) {
+					if (A.values) {
+						CIRCULATE_PARAMS::ParamUnit* Unit = getUnit(A.unit);
+						const double* values = A.values + position;
+						for (int i = 0; i < n; i++) {
+							Unit->BlockValues[i] = values[i];
+						}
+						Unit->lastExplicit = values[n - 1];
+					}
+				}
+				Params.smoothAllParameters();
+
+				const float* sidechainBlock = sidechain ? sidechain + position : nullptr;
+
+				for (int c = 0; c < numChannels; c++) {
+					T* channel = data + c * channelStride + (position - first);
+
+					if constexpr (std::is_same<T, float>::value) {
+						Effects[c].getBlock(channel, channel, n, sidechainBlock);
+					}
+					else {
+						for (int i = 0; i < n; i++) {
+							Scratch[i] = static_cast<float>(channel[i]);
+						}
+						Effects[c].getBlock(Scratch.data(), Scratch.data(), n, sidechainBlock);
+						for (int i = 0; i < n; i++) {
+							channel[i] = Scratch[i];
+						}
+					}
+				}
+			}
+		}
+
+		CIRCULATE_PARAMS::AudioEffectParameters Params;
+		std::vector<CirculateEffect> Effects;
+
+	private:
+		void saveState(CHECKPOINT::Writer& Out) const {
+			Out.write(static_cast<int32_t>(Effects.size()));
+			Params.saveState(Out);
+			for (const auto& Effect : Effects) {
+				Effect.saveState(Out);
+			}
+		}
+
+		std::vector<float> Scratch;
+		double mSampleRate = 0.0;
+	};
+
+	struct RenderOptions {
+		int numThreads = 1;
+		double prerollSeconds = -1.0; // estimated from the parameters when negative
+		bool verify = false;
+	};
+
+	struct RenderReport {
+		int numChunks = 1;
+		long long prerollSamples = 0;
+		bool feedback = false; // rendered serially, feedback keeps the memory from decaying
+		double maxSeamError = -1.0; // against serial rendering, with verify
+		long long maxSeamErrorPosition = -1;
+	};
+
+	/// <summary>
+	/// Lowest and highest value a parameter takes over a render
+	/// </summary>
+	inline void getRange(CIRCULATE_PARAMS::ParamUnit& Unit, const std::vector<Automation>& Automations, long long numSamples, double& low, double& high) {
+		low = high = Unit.getLastValue();
+		for (const Automation& A : Automations) {
+			if (A.unit->getID() != Unit.getID()) {
+				continue;
+			}
+			if (!A.values) {
+				low = high = A.constant;
+				continue;
+			}
+			low = high = A.values[0];
+			for (long long i = 1; i < numSamples; i++) {
+				low = std::min(low, A.values[i]);
+				high = std::max(high, A.values[i]);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Check if feedback is ever outside the range that snaps it off
+	/// </summary>
+	inline bool usesFeedback(Instance& Main, const std::vector<Automation>& Automations, long long numSamples) {
+		double low, high;
+		getRange(Main.Params.Feedback, Automations, numSamples, low, high);
+		return fabs(low - 0.5) >= 0.1 || fabs(high - 0.5) >= 0.1;
+	}
+
+	/// <summary>
+	/// Samples of pre-roll after which the cascade has forgotten what came before, for the
+	/// lowest stage center, highest focus and most stages reached over the render
+	/// </summary>
+	inline long long estimatePreroll(Instance& Main, const std::vector<Automation>& Automations, long long numSamples, bool hasSidechain) {
+		CIRCULATE_PARAMS::AudioEffectParameters& P = Main.Params;
+		double sampleRate = Main.getSampleRate();
+		double low, high;
+
+		double maxAllowedFreq = MAX_FREQ_HZ;
+		if (sampleRate / 2.0 < MAX_FREQ_HZ) maxAllowedFreq = sampleRate / 2.0 - 500.0;
+
+		// Lowest center, of either control the render uses
+		double lowestHz = maxAllowedFreq;
+		double typeLow, typeHigh;
+		getRange(P.CenterType, Automations, numSamples, typeLow, typeHigh);
+		if (typeLow < 0.5) {
+			getRange(P.Center, Automations, numSamples, low, high);
+			lowestHz = std::min(lowestHz, MIN_FREQ_HZ * pow(maxAllowedFreq / MIN_FREQ_HZ, std::max(low, 0.0)));
+		}
+		if (typeHigh >= 0.5) {
+			getRange(P.Note, Automations, numSamples, low, high);
+			double noteLow = low;
+			getRange(P.NoteOffset, Automations, numSamples, low, high);
+			lowestHz = std::min(lowestHz, HELPERS::noteNumToHz(static_cast<int>(noteLow * MAX_NOTE_NUM)) * pow(2.0, 2.0 * low - 1.0));
+		}
+
+		// Stages spread and modulated below the center
+		getRange(P.Spread, Automations, numSamples, low, high);
+		lowestHz /= pow(2.0, 0.5 * high * MAX_SPREAD_OCTAVES);
+		if (hasSidechain) {
+			lowestHz /= pow(2.0, MAX_SIDECHAIN_OCTAVES);
+		}
+		lowestHz = std::max(lowestHz, static_cast<double>(MIN_FREQ_HZ));
+
+		// Narrowest stage, Q as in AllpassFilter::calculateCoefficients
+		getRange(P.Focus, Automations, numSamples, low, high);
+		double focus = high * high * high;
+		double R = 1.0 / (2.0 * (0.5 + (focus * 6.0)));
+
+		getRange(P.Depth, Automations, numSamples, low, high);
+		int numStages = static_cast<int>(high * CIRCULATE_PARAMS::getStageLimit(P.StageLimit.getLastValue()) + 0.5);
+
+		// Each stage delays what it passes on by its group delay, largest at DC, then decays
+		double w = 2.0 * E_PI * lowestHz;
+		double timeConstant = 1.0 / (R * w);
+		double groupDelay = 4.0 * R / w;
+		double seconds = numStages * (groupDelay + RENDER_DECAY_PER_STAGE * timeConstant) + RENDER_DECAY_TAIL * timeConstant;
+		seconds = std::max(seconds, RENDER_MIN_PREROLL_SECONDS);
+
+		long long samples = static_cast<long long>(seconds * sampleRate);
+
+		// The spectral engine and band split delay the input, their buffers need filling as well
+		samples += 2 * Main.Effects[0].getLatency();
+		getRange(P.Engine, Automations, numSamples, low, high);
+		if (high >= 0.5) {
+			samples += 2 * SpectralDispersion::getLatency();
+		}
+		return samples;
+	}
+
+	/// <summary>
+	/// Context of a parallel render, handed to the worker jobs
+	/// </summary>
+	template <typename T>
+	struct RenderJob {
+		Instance* Main = nullptr;
+		std::vector<std::unique_ptr<Instance>>* Workers = nullptr;
+		std::vector<std::vector<T>>* Prerolls = nullptr;
+		T* data = nullptr;
+		int numChannels = 0;
+		long long numSamples = 0;
+		long long chunkLength = 0;
+		const float* sidechain = nullptr;
+		const std::vector<Automation>* Automations = nullptr;
+
+		static void runChunk(void* context, int chunk) {
+			RenderJob& J = *static_cast<RenderJob*>(context);
+
+			long long first = chunk * J.chunkLength;
+			long long last = std::min(first + J.chunkLength, J.numSamples);
+			if (chunk == static_cast<int>(J.Workers->size())) {
+				last = J.numSamples;
+			}
+
+			Instance& I = (chunk == 0) ? *J.Main : *(*J.Workers)[chunk - 1];
+
+			if (chunk > 0) {
+				// Warm up on the copy of the audio before the chunk, the output is thrown away
+				std::vector<T>& Preroll = (*J.Prerolls)[chunk - 1];
+				long long prerollLength = static_cast<long long>(Preroll.size()) / J.numChannels;
+				I.process(Preroll.data(), prerollLength, J.numChannels, first - prerollLength, first, J.sidechain, *J.Automations);
+			}
+
+			I.process(J.data + first, J.numSamples, J.numChannels, first, last, J.sidechain, *J.Automations);
+		}
+	};
+
+	/// <summary>
+	/// Render a whole buffer from cleared memory, split in time over up to numThreads chunks.
+	/// Each chunk after the first gets its own instance, set up as Main is at the start and
+	/// warmed up on the pre-roll. Main ends up in the state of the last chunk, so processing can
+	/// continue. With feedback, or a buffer too short for more than one chunk, it renders serially.
+	/// Allocates, not for realtime use.
+	/// </summary>
+	template <typename T>
+	RenderReport renderParallel(Instance& Main, WorkerPool& Pool, T* data, int numChannels, long long numSamples,
+		const float* sidechain, const std::vector<Automation>& Automations, const RenderOptions& Options) {
+		RenderReport Report;
+
+		// Start from cleared memory, with the parameters at their first value (no ramp in)
+		Main.reset();
+		for (auto* Unit : Main.Params.ParameterList) {
+			Unit->fillWith(Unit->getLastValue());
+		}
+		for (const Automation& A : Automations) {
+			A.unit->fillWith(A.values ? A.values[0] : A.constant);
+		}
+
+		Report.feedback = usesFeedback(Main, Automations, numSamples);
+		Report.prerollSamples = (Options.prerollSeconds >= 0.0)
+			? static_cast<long long>(Options.prerollSeconds * Main.getSampleRate())
+			: estimatePreroll(Main, Automations, numSamples, sidechain != nullptr);
+
+		// Chunks shorter than the pre-roll would spend most of their time warming up
+		long long minChunkLength = std::max<long long>(Report.prerollSamples, PROCESS_CHUNK_SIZE);
+		long long maxChunks = numSamples / minChunkLength;
+		Report.numChunks = static_cast<int>(std::max<long long>(1, std::min<long long>(Options.numThreads, maxChunks)));
+		if (Report.feedback) {
+			Report.numChunks = 1;
+		}
+
+		// The serial render to check against starts from the same state
+		std::unique_ptr<Instance> Serial;
+		std::vector<T> SerialData;
+		if (Options.verify) {
+			Serial = std::make_unique<Instance>(Main.getSampleRate(), numChannels);
+			Serial->copyStateFrom(Main);
+			SerialData.assign(data, data + numChannels * numSamples);
+		}
+
+		long long chunkLength = numSamples / Report.numChunks;
+
+		// Copy each chunk's pre-roll before anything is processed in place
+		std::vector<std::unique_ptr<Instance>> Workers;
+		std::vector<std::vector<T>> Prerolls;
+		for (int k = 1; k < Report.numChunks; k++) {
+			long long first = k * chunkLength;
+			long long prerollStart = std::max<long long>(0, first - Report.prerollSamples);
+			long long prerollLength = first - prerollStart;
+
+			std::vector<T> Preroll(numChannels * prerollLength);
+			for (int c = 0; c < numChannels; c++) {
+				std::copy(data + c * numSamples + prerollStart, data + c * numSamples + first, Preroll.begin() + c * prerollLength);
+			}
+			Prerolls.push_back(std::move(Preroll));
+
+			// Set up as Main, with the parameters at their value where the pre-roll starts
+			auto Worker = std::make_unique<Instance>(Main.getSampleRate(), numChannels);
+			Worker->copyStateFrom(Main);
+			for (const Automation& A : Automations) {
+				Worker->getUnit(A.unit)->fillWith(A.values ? A.values[prerollStart] : A.constant);
+			}
+			Workers.push_back(std::move(Worker));
+		}
+
+		RenderJob<T> Job;
+		Job.Main = &Main;
+		Job.Workers = &Workers;
+		Job.Prerolls = &Prerolls;
+		Job.data = data;
+		Job.numChannels = numChannels;
+		Job.numSamples = numSamples;
+		Job.chunkLength = chunkLength;
+		Job.sidechain = sidechain;
+		Job.Automations = &Automations;
+
+		if (Pool.getNumWorkers() < Report.numChunks - 1) {
+			Pool.start(Report.numChunks - 1);
+		}
+		Pool.run(&RenderJob<T>::runChunk, &Job, Report.numChunks);
+
+		// Continue from the end of the file
+		if (!Workers.empty()) {
+			Main.copyStateFrom(*Workers.back());
+		}
+
+		if (Serial) {
+			Serial->process(SerialData.data(), numSamples, numChannels, 0, numSamples, sidechain, Automations);
+
+			Report.maxSeamError = 0.0;
+			for (int c = 0; c < numChannels; c++) {
+				for (long long i = 0; i < numSamples; i++) {
+					double error = fabs(static_cast<double>(data[c * numSamples + i]) - SerialData[c * numSamples + i]);
+					if (error > Report.maxSeamError) {
+						Report.maxSeamError = error;
+						Report.maxSeamErrorPosition = i;
+					}
+				}
+			}
+		}
+
+		return Report;
+	}
+}
@@ -94,6 +94,33 @@ public:
 
 	}
 
+	/// <summary>
+	/// As calculateCoefficients, but with g supplied by the caller (already warped). g is applied
+	/// without smoothing, k is smoothed as usual.
+	/// Used when the center is modulated at audio rate, where the caller interpolates g itself
+	/// </summary>
+	/// <param name="g"> Warped frequency coefficient, tan(pi * f / fs)</param>
+	/// <param name="q"> Normalised 0 to 1</param>
+	inline static void calculateCoefficientsWithG(double g, double q, AllpassInfo& State) {
+
+		double q_actual = 0.5 + (q * 6.0);
+
+		State.g_target = g;
+		State.g = g;
+		State.k_target = 1.0 / (2.0 * q_actual);
+
+		if (State.force_snap) {
+			State.force_snap = false;
+			State.k = State.k_target;
+			return;
+		}
+
+		double diff_k = State.k_target - State.k;
+		State.k += diff_k * State.smoothFactor;
+
+		if (abs(diff_k) < 1e-10) State.k = State.k_target;
+	}
+
 	/// <summary>
 	/// Update Filter's member pointer to coefficients
 	/// </summary>
@@ -144,4 +171,277 @@ private:
 	int sampleRate = 0;
 
 	AllpassInfo* State = nullptr;
-};
\ No newline at end of file
+};
+
+/// <summary>
+/// Memory for a bank of allpass filters that share one AllpassInfo, stored as contiguous
+/// aligned arrays (s1 for every stage, then s2 for every stage) rather than an array of
+/// AllpassFilter objects. Stage i uses s1[i] and s2[i], the same update as AllpassFilter::getNext.
+///
+/// Keeping only the two memory values per stage halves the footprint of the bank, and the 
+/// arrays can be loaded straight into vector registers by the cascade kernels.
+///
+/// The arrays are slices of the effect's arena, sized for numStages (the stage limit) by attach.
+/// Banks don't own their memory, so copy the memory with copyFrom rather than by assignment.
+/// </summary>
+struct AllpassBankState {
+	using SampleType = double;
+
+	double* s1 = nullptr;
+	double* s2 = nullptr;
+	int numStages = 0;
+
+	AllpassBankState() = default;
+	AllpassBankState(const AllpassBankState&) = delete;
+	AllpassBankState& operator=(const AllpassBankState&) = delete;
+
+	static size_t getArenaBytes(int stages) {
+		return 2 * HELPERS::AlignedArena::getAlignedBytes(stages * sizeof(double));
+	}
+
+	void attach(HELPERS::AlignedArena& Arena, int stages) {
+		s1 = Arena.take<double>(stages);
+		s2 = Arena.take<double>(stages);
+		numStages = stages;
+		resetState();
+	}
+
+	void resetState() {
+		resetState(0, numStages);
+	}
+
+	/// <summary>
+	/// Clear the memory of stages first to last - 1
+	/// </summary>
+	void resetState(int first, int last) {
+		for (int i = first; i < last; i++) {
+			s1[i] = 0;
+			s2[i] = 0;
+		}
+	}
+
+	/// <summary>
+	/// Copy the memory of a bank with the same number of stages
+	/// </summary>
+	void copyFrom(const AllpassBankState& Bank) {
+		memcpy(s1, Bank.s1, sizeof(double) * numStages);
+		memcpy(s2, Bank.s2, sizeof(double) * numStages);
+	}
+};
+
+/// <summary>
+/// Memory for BANK_LANES parallel banks of allpass filters (chord mode), each bank with its own
+/// coefficients. Lanes are the innermost dimension, so one stage of every bank is a contiguous
+/// aligned group (s1[stage][0..BANK_LANES-1]) that fits a vector register.
+/// </summary>
+struct AllpassLaneState {
+	using SampleType = double;
+
+	double (*s1)[BANK_LANES] = nullptr;
+	double (*s2)[BANK_LANES] = nullptr;
+	int numStages = 0;
+
+	AllpassLaneState() = default;
+	AllpassLaneState(const AllpassLaneState&) = delete;
+	AllpassLaneState& operator=(const AllpassLaneState&) = delete;
+
+	static size_t getArenaBytes(int stages) {
+		return 2 * HELPERS::AlignedArena::getAlignedBytes(stages * sizeof(double[BANK_LANES]));
+	}
+
+	void attach(HELPERS::AlignedArena& Arena, int stages) {
+		s1 = Arena.take<double[BANK_LANES]>(stages);
+		s2 = Arena.take<double[BANK_LANES]>(stages);
+		numStages = stages;
+		resetState();
+	}
+
+	void resetState() {
+		resetState(0, numStages);
+	}
+
+	/// <summary>
+	/// Clear the memory of stages first to last - 1, in every lane
+	/// </summary>
+	void resetState(int first, int last) {
+		for (int i = first; i < last; i++) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				s1[i][l] = 0;
+				s2[i][l] = 0;
+			}
+		}
+	}
+
+	void copyFrom(const AllpassLaneState& Bank) {
+		memcpy(s1, Bank.s1, sizeof(double[BANK_LANES]) * numStages);
+		memcpy(s2, Bank.s2, sizeof(double[BANK_LANES]) * numStages);
+	}
+
+	/// <summary>
+	/// Set every lane to the memory of a single bank
+	/// </summary>
+	void copyFromBank(const AllpassBankState& Bank) {
+		for (int i = 0; i < numStages; i++) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				s1[i][l] = Bank.s1[i];
+				s2[i][l] = Bank.s2[i];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Copy one lane into a single bank
+	/// </summary>
+	void copyToBank(AllpassBankState& Bank, int lane) const {
+		for (int i = 0; i < numStages; i++) {
+			Bank.s1[i] = s1[i][lane];
+			Bank.s2[i] = s2[i][lane];
+		}
+	}
+};
+
+/// <summary>
+/// Single precision AllpassBankState, for the 32 bit precision setting
+/// </summary>
+struct AllpassBankStateFloat {
+	using SampleType = float;
+
+	float* s1 = nullptr;
+	float* s2 = nullptr;
+	int numStages = 0;
+
+	AllpassBankStateFloat() = default;
+	AllpassBankStateFloat(const AllpassBankStateFloat&) = delete;
+	AllpassBankStateFloat& operator=(const AllpassBankStateFloat&) = delete;
+
+	static size_t getArenaBytes(int stages) {
+		return 2 * HELPERS::AlignedArena::getAlignedBytes(stages * sizeof(float));
+	}
+
+	void attach(HELPERS::AlignedArena& Arena, int stages) {
+		s1 = Arena.take<float>(stages);
+		s2 = Arena.take<float>(stages);
+		numStages = stages;
+		resetState();
+	}
+
+	void resetState() {
+		resetState(0, numStages);
+	}
+
+	void resetState(int first, int last) {
+		for (int i = first; i < last; i++) {
+			s1[i] = 0;
+			s2[i] = 0;
+		}
+	}
+
+	void copyFrom(const AllpassBankStateFloat& Bank) {
+		memcpy(s1, Bank.s1, sizeof(float) * numStages);
+		memcpy(s2, Bank.s2, sizeof(float) * numStages);
+	}
+
+	/// <summary>
+	/// Take over the memory of a double precision bank
+	/// </summary>
+	void copyFrom(const AllpassBankState& Bank) {
+		for (int i = 0; i < numStages; i++) {
+			s1[i] = static_cast<float>(Bank.s1[i]);
+			s2[i] = static_cast<float>(Bank.s2[i]);
+		}
+	}
+
+	/// <summary>
+	/// Hand the memory over to a double precision bank
+	/// </summary>
+	void copyTo(AllpassBankState& Bank) const {
+		for (int i = 0; i < numStages; i++) {
+			Bank.s1[i] = s1[i];
+			Bank.s2[i] = s2[i];
+		}
+	}
+};
+
+/// <summary>
+/// Single precision AllpassLaneState, for the 32 bit precision setting
+/// </summary>
+struct AllpassLaneStateFloat {
+	using SampleType = float;
+
+	float (*s1)[BANK_LANES] = nullptr;
+	float (*s2)[BANK_LANES] = nullptr;
+	int numStages = 0;
+
+	AllpassLaneStateFloat() = default;
+	AllpassLaneStateFloat(const AllpassLaneStateFloat&) = delete;
+	AllpassLaneStateFloat& operator=(const AllpassLaneStateFloat&) = delete;
+
+	static size_t getArenaBytes(int stages) {
+		return 2 * HELPERS::AlignedArena::getAlignedBytes(stages * sizeof(float[BANK_LANES]));
+	}
+
+	void attach(HELPERS::AlignedArena& Arena, int stages) {
+		s1 = Arena.take<float[BANK_LANES]>(stages);
+		s2 = Arena.take<float[BANK_LANES]>(stages);
+		numStages = stages;
+		resetState();
+	}
+
+	void resetState() {
+		resetState(0, numStages);
+	}
+
+	void resetState(int first, int last) {
+		for (int i = first; i < last; i++) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				s1[i][l] = 0;
+				s2[i][l] = 0;
+			}
+		}
+	}
+
+	void copyFrom(const AllpassLaneStateFloat& Bank) {
+		memcpy(s1, Bank.s1, sizeof(float[BANK_LANES]) * numStages);
+		memcpy(s2, Bank.s2, sizeof(float[BANK_LANES]) * numStages);
+	}
+
+	void copyFrom(const AllpassLaneState& Bank) {
+		for (int i = 0; i < numStages; i++) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				s1[i][l] = static_cast<float>(Bank.s1[i][l]);
+				s2[i][l] = static_cast<float>(Bank.s2[i][l]);
+			}
+		}
+	}
+
+	void copyTo(AllpassLaneState& Bank) const {
+		for (int i = 0; i < numStages; i++) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				Bank.s1[i][l] = s1[i][l];
+				Bank.s2[i][l] = s2[i][l];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Set every lane to the memory of a single bank
+	/// </summary>
+	void copyFromBank(const AllpassBankStateFloat& Bank) {
+		for (int i = 0; i < numStages; i++) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				s1[i][l] = Bank.s1[i];
+				s2[i][l] = Bank.s2[i];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Copy one lane into a single bank
+	/// </summary>
+	void copyToBank(AllpassBankStateFloat& Bank, int lane) const {
+		for (int i = 0; i < numStages; i++) {
+			Bank.s1[i] = s1[i][lane];
+			Bank.s2[i] = s2[i][lane];
+		}
+	}
+};
@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "pluginterfaces/vst/ivstparameterchanges.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define CAPTURE_GET_PID _getpid
+#else
+#include <unistd.h>
+#define CAPTURE_GET_PID getpid
+#endif
+
+// Environment variable holding the capture file path, capture is off when it isn't set
+#define CAPTURE_ENV_VARIABLE "CIRCULATE_CAPTURE"
+#define CAPTURE_MAGIC 0x43524943u // "CIRC"
+#define CAPTURE_VERSION 2u
+// In place of a block's numSamples, marks the trailer
+#define CAPTURE_END_MARKER -1
+// Ring buffer between the audio thread and the writer, enough for a few seconds of every sample automation
+#define CAPTURE_BUFFER_BYTES (1 << 22)
+#define CAPTURE_FLUSH_INTERVAL_MS 20
+
+/// <summary>
+/// Capture of the host's process() calls (block sizes, parameter queue points and a summary of
+/// the input), so CPU spikes seen in a user's session can be replayed deterministically by
+/// tools/replay.
+///
+/// File layout, little endian: FileHeader, then for each process() call a BlockHeader followed
+/// by numPoints PointRecords, in queue order, then a FileTrailer when the capture was stopped.
+/// </summary>
+namespace CAPTURE {
+
+	struct FileHeader {
+		uint32_t magic = CAPTURE_MAGIC;
+		uint32_t version = CAPTURE_VERSION;
+		double sampleRate = 0.0;
+		int32_t maxBlockSize = 0;
+		int32_t processMode = 0;
+	};
+
+	enum BlockFlags {
+		kChannelsIdentical = 1 << 0 // left and right input were the same (dual mono)
+	};
+
+	struct BlockHeader {
+		int32_t numSamples = 0;
+		int32_t numChannels = 0;
+		uint32_t numPoints = 0;
+		uint32_t flags = 0;
+		// FNV-1a of the input samples, to check a replay against the session
+		uint64_t inputHash = 0;
+		float inputPeak = 0.0f;
+		uint32_t reserved = 0; // keeps the struct free of padding
+	};
+
+	struct PointRecord {
+		uint32_t paramID = 0;
+		int32_t sampleOffset = 0;
+		double value = 0.0;
+	};
+
+	/// <summary>
+	/// Written on stop. A capture with dropped blocks has gaps, so it doesn't replay the session
+	/// </summary>
+	struct FileTrailer {
+		int32_t marker = CAPTURE_END_MARKER; // where a block has numSamples
+		uint32_t droppedBlocks = 0;
+		uint64_t recordedBlocks = 0;
+	};
+
+	/// <summary>
+	/// Single producer, single consumer byte ring. The audio thread writes whole records or
+	/// nothing, the writer thread reads whatever is available.
+	/// </summary>
+	class ByteRing {
+	public:
+		void allocate(size_t capacity) {
+			Buffer.assign(capacity, 0);
+			readPos.store(0);
+			writePos.store(0);
+		}
+
+		size_t getFreeSpace() const {
+			size_t used = writePos.load(std::memory_order_relaxed) - readPos.load(std::memory_order_acquire);
+			return Buffer.size() - used;
+		}
+
+		/// <summary>
+		/// Copy bytes in, call only after checking getFreeSpace. Not visible to the reader until commit
+		/// </summary>
+		void write(const void* data, size_t numBytes, size_t& position) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			size_t offset = position % Buffer.size();
+			size_t first = numBytes < Buffer.size() - offset ? numBytes : Buffer.size() - offset;
+
+			memcpy(Buffer.data() + offset, bytes, first);
+			memcpy(Buffer.data(), bytes + first, numBytes - first);
+			position += numBytes;
+		}
+
+		size_t getWritePosition() const {
+			return writePos.load(std::memory_order_relaxed);
+		}
+
+		void commit(size_t position) {
+			writePos.store(position, std::memory_order_release);
+		}
+
+		/// <summary>
+		/// Write everything available to file (reader thread)
+		/// </summary>
+		void drainTo(FILE* file) {
+			size_t start = readPos.load(std::memory_order_relaxed);
+			size_t end = writePos.load(std::memory_order_acquire);
+
+			while (start != end) {
+				size_t offset = start % Buffer.size();
+				size_t chunk = end - start;
+				if (chunk > Buffer.size() - offset) {
+					chunk = Buffer.size() - offset;
+				}
+				fwrite(Buffer.data() + offset, 1, chunk, file);
+				start += chunk;
+			}
+			readPos.store(end, std::memory_order_release);
+		}
+
+	private:
+		std::vector<uint8_t> Buffer;
+		std::atomic<size_t> readPos { 0 };
+		std::atomic<size_t> writePos { 0 };
+	};
+
+	/// <summary>
+	/// Records process() calls into a file. start and stop are called from setupProcessing /
+	/// terminate, recordBlock from process. recordBlock doesn't allocate, lock or touch the file,
+	/// a block that doesn't fit in the ring is dropped and counted.
+	/// </summary>
+	class AutomationRecorder {
+	public:
+		~AutomationRecorder() {
+			stop();
+		}
+
+		/// <summary>
+		/// Start capturing, if CAPTURE_ENV_VARIABLE is set. Every capture in the process gets its
+		/// own file, <path>.<pid>.<n>, so instances of a session don't write over each other
+		/// </summary>
+		void startFromEnvironment(const Steinberg::Vst::ProcessSetup& Setup) {
+			const char* path = getenv(CAPTURE_ENV_VARIABLE);
+			if (path && path[0] != 0) {
+				static std::atomic<unsigned> numCaptures { 0 };
+				std::string uniquePath = std::string(path) + "." + std::to_string(CAPTURE_GET_PID()) + "." + std::to_string(numCaptures.fetch_add(1));
+				start(uniquePath, Setup);
+			}
+			else {
+				stop();
+			}
+		}
+
+		bool start(const std::string& path, const Steinberg::Vst::ProcessSetup& Setup) {
+			stop();
+
+			File = fopen(path.c_str(), "wb");
+			if (!File) {
+				return false;
+			}
+
+			FileHeader Header;
+			Header.sampleRate = Setup.sampleRate;
+			Header.maxBlockSize = Setup.maxSamplesPerBlock;
+			Header.processMode = Setup.processMode;
+			fwrite(&Header, sizeof(Header), 1, File);
+
+			Ring.allocate(CAPTURE_BUFFER_BYTES);
+			droppedBlocks.store(0);
+			recordedBlocks.store(0);
+			running.store(true);
+			Writer = std::thread(&AutomationRecorder::writerLoop, this);
+			return true;
+		}
+
+		void stop() {
+			if (Writer.joinable()) {
+				running.store(false);
+				Writer.join();
+			}
+			if (File) {
+				Ring.drainTo(File);
+
+				FileTrailer Trailer;
+				Trailer.droppedBlocks = droppedBlocks.load();
+				Trailer.recordedBlocks = recordedBlocks.load();
+				fwrite(&Trailer, sizeof(Trailer), 1, File);
+				fclose(File);
+				File = nullptr;
+			}
+		}
+
+		bool isActive() const {
+			return running.load(std::memory_order_relaxed);
+		}
+
+		unsigned getDroppedBlocks() const {
+			return droppedBlocks.load();
+		}
+
+		/// <summary>
+		/// Record the block size, every parameter queue point and the input summary of one process() call
+		/// </summary>
+		void recordBlock(Steinberg::Vst::ProcessData& data) {
+			BlockHeader Block;
+			Block.numSamples = data.numSamples;
+
+			Steinberg::Vst::IParameterChanges* changes = data.inputParameterChanges;
+			int32_t numQueues = changes ? changes->getParameterCount() : 0;
+			for (int32_t q = 0; q < numQueues; q++) {
+				if (auto* queue = changes->getParameterData(q)) {
+					Block.numPoints += queue->getPointCount();
+				}
+			}
+
+			summariseInput(data, Block);
+
+			size_t numBytes = sizeof(BlockHeader) + Block.numPoints * sizeof(PointRecord);
+			if (numBytes > Ring.getFreeSpace()) {
+				droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			size_t position = Ring.getWritePosition();
+			Ring.write(&Block, sizeof(Block), position);
+
+			for (int32_t q = 0; q < numQueues; q++) {
+				auto* queue = changes->getParameterData(q);
+				if (!queue) continue;
+
+				PointRecord Point;
+				Point.paramID = queue->getParameterId();
+				for (int32_t p = 0; p < queue->getPointCount(); p++) {
+					Steinberg::int32 offset = 0;
+					Steinberg::Vst::ParamValue value = 0.0;
+					queue->getPoint(p, offset, value);
+					Point.sampleOffset = offset;
+					Point.value = value;
+					Ring.write(&Point, sizeof(Point), position);
+				}
+			}
+
+			Ring.commit(position);
+			recordedBlocks.fetch_add(1, std::memory_order_relaxed);
+		}
+
+	private:
+		ByteRing Ring;
+		FILE* File = nullptr;
+		std::thread Writer;
+		std::atomic<bool> running { false };
+		std::atomic<unsigned> droppedBlocks { 0 };
+		std::atomic<uint64_t> recordedBlocks { 0 };
+
+		void writerLoop() {
+			while (running.load()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(CAPTURE_FLUSH_INTERVAL_MS));
+				Ring.drainTo(File);
+			}
+		}
+
+		static void summariseInput(Steinberg::Vst::ProcessData& data, BlockHeader& Block) {
+			uint64_t hash = 14695981039346656037ull;
+			float peak = 0.0f;
+
+			if (data.numInputs > 0 && data.inputs[0].channelBuffers32) {
+				Block.numChannels = data.inputs[0].numChannels;
+
+				for (int c = 0; c < Block.numChannels; c++) {
+					const float* buffer = data.inputs[0].channelBuffers32[c];
+					const uint8_t* bytes = reinterpret_cast<const uint8_t*>(buffer);
+
+					for (size_t i = 0; i < data.numSamples * sizeof(float); i++) {
+						hash = (hash ^ bytes[i]) * 1099511628211ull;
+					}
+					for (int s = 0; s < data.numSamples; s++) {
+						float level = fabsf(buffer[s]);
+						if (level > peak) peak = level;
+					}
+				}
+
+				if (Block.numChannels > 1 &&
+					memcmp(data.inputs[0].channelBuffers32[0], data.inputs[0].channelBuffers32[1], data.numSamples * sizeof(float)) == 0) {
+					Block.flags |= kChannelsIdentical;
+				}
+			}
+
+			Block.inputHash = hash;
+			Block.inputPeak = peak;
+		}
+	};
+
+	/// <summary>
+	/// Reads a capture file back, one block at a time
+	/// </summary>
+	class CaptureReader {
+	public:
+		~CaptureReader() {
+			if (File) fclose(File);
+		}
+
+		bool open(const std::string& path) {
+			File = fopen(path.c_str(), "rb");
+			if (!File) return false;
+
+			if (fread(&Header, sizeof(Header), 1, File) != 1) return false;
+			if (Header.magic != CAPTURE_MAGIC || Header.version != CAPTURE_VERSION) return false;
+
+			// The trailer is missing when the host didn't stop the plug-in (a crash)
+			hasTrailer = fseek(File, -static_cast<long>(sizeof(FileTrailer)), SEEK_END) == 0 &&
+				fread(&Trailer, sizeof(Trailer), 1, File) == 1 && Trailer.marker == CAPTURE_END_MARKER;
+			rewind();
+			return true;
+		}
+
+		const FileHeader& getHeader() const {
+			return Header;
+		}
+
+		/// <summary>
+		/// Whether the capture was stopped cleanly, the trailer's counts are only valid then
+		/// </summary>
+		bool isComplete() const {
+			return hasTrailer;
+		}
+
+		const FileTrailer& getTrailer() const {
+			return Trailer;
+		}
+
+		/// <summary>
+		/// Read the next block, false at the trailer, the end of the file or a truncated block
+		/// </summary>
+		bool readBlock(BlockHeader& Block, std::vector<PointRecord>& Points) {
+			if (fread(&Block.numSamples, sizeof(Block.numSamples), 1, File) != 1 || Block.numSamples == CAPTURE_END_MARKER) return false;
+			if (fread(reinterpret_cast<uint8_t*>(&Block) + sizeof(Block.numSamples), sizeof(Block) - sizeof(Block.numSamples), 1, File) != 1) return false;
+
+			Points.resize(Block.numPoints);
+			if (Block.numPoints > 0 && fread(Points.data(), sizeof(PointRecord), Block.numPoints, File) != Block.numPoints) {
+				return false;
+			}
+			return true;
+		}
+
+		void rewind() {
+			fseek(File, sizeof(FileHeader), SEEK_SET);
+		}
+
+	private:
+		FILE* File = nullptr;
+		FileHeader Header;
+		FileTrailer Trailer;
+		bool hasTrailer = false;
+	};
+}
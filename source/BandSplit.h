@@ -0,0 +1,258 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "Checkpoint.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// Lowest rate the low band runs at, the decimation factor is the largest power of 2 that keeps it
+#define BAND_SPLIT_MIN_RATE 24000
+#define BAND_SPLIT_MAX_FACTOR 8
+// Taps of the crossover per unit of decimation factor, sets the transition width and the latency
+#define BAND_SPLIT_TAPS_PER_FACTOR 48
+
+/// <summary>
+/// Band split for running the cascade at a fraction of the sample rate.
+///
+/// The input is lowpassed and decimated (split), the low band v is processed at the low rate by
+/// the caller, and the output is x + Up(processed - v), with x delayed to line up (merge). Only
+/// what processing changed goes through the interpolator, so where the cascade leaves the low
+/// band alone the output is exactly the delayed input, whatever the crossover does. The two
+/// bands are complementary to a pure delay, the latency of the split.
+///
+/// The crossover is a linear phase (windowed sinc) lowpass at 0.8 of the low band's Nyquist,
+/// used polyphase for both decimation and interpolation. Buffers are allocated by prepare.
+/// </summary>
+class BandSplitter {
+public:
+	/// <summary>
+	/// Decimation factor for a sample rate, 1 when the rate is too low to split
+	/// </summary>
+	static int getFactorForRate(int sampleRate) {
+		int factor = 1;
+		while (factor < BAND_SPLIT_MAX_FACTOR && sampleRate / (factor * 2) >= BAND_SPLIT_MIN_RATE) {
+			factor *= 2;
+		}
+		return factor;
+	}
+
+	/// <summary>
+	/// Build the crossover for a decimation factor. Allocates, clears the memory
+	/// </summary>
+	/// <param name="maxBlockSize"> most samples split and merge are called with</param>
+	void prepare(int decimationFactor, int maxBlockSize) {
+		M = decimationFactor;
+		numTaps = BAND_SPLIT_TAPS_PER_FACTOR * M + 1;
+		numPhaseTaps = (numTaps + M - 1) / M;
+
+		// Blackman windowed sinc, cutoff at 0.4 / M of the sample rate (0.8 of the low Nyquist)
+		Taps.assign(numTaps, 0.0f);
+		double cutoff = 0.4 / M;
+		double centerTap = (numTaps - 1) / 2.0;
+		double sum = 0.0;
+		std::vector<double> Design(numTaps);
+		for (int k = 0; k < numTaps; k++) {
+			double t = k - centerTap;
+			double sinc = (t == 0.0) ? 2.0 * cutoff : sin(2.0 * 3.14159265358979323846 * cutoff * t) / (3.14159265358979323846 * t);
+			double phase = 2.0 * 3.14159265358979323846 * k / (numTaps - 1);
+			double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+			Design[k] = sinc * window;
+			sum += Design[k];
+		}
+		for (int k = 0; k < numTaps; k++) {
+			Taps[k] = static_cast<float>(Design[k] / sum);
+		}
+
+		// Interpolator phases, gain M for the zeros between low band samples. Stored oldest
+		// first so each phase is a dot product with the history as it lies in memory
+		PhaseTaps.assign(M * numPhaseTaps, 0.0f);
+		for (int p = 0; p < M; p++) {
+			for (int j = 0; j < numPhaseTaps; j++) {
+				int k = p + j * M;
+				PhaseTaps[p * numPhaseTaps + (numPhaseTaps - 1 - j)] = (k < numTaps) ? M * Taps[k] : 0.0f;
+			}
+		}
+
+		// Histories are stored twice, back to back, so the newest numTaps values are always contiguous
+		InputHistory.assign(2 * numTaps, 0.0f);
+		LowHistory.assign(2 * numPhaseTaps, 0.0f);
+		// The whole block is split before it is merged, so the delay line holds a block more than the latency
+		Dry.assign(getLatency() + maxBlockSize, 0.0f);
+
+		reset();
+	}
+
+	void reset() {
+		std::fill(InputHistory.begin(), InputHistory.end(), 0.0f);
+		std::fill(LowHistory.begin(), LowHistory.end(), 0.0f);
+		std::fill(Dry.begin(), Dry.end(), 0.0f);
+		inputPosition = 0;
+		lowPosition = 0;
+		dryPosition = 0;
+		phase = 0;
+		mergePhase = 0;
+		sidechainPeak = 0.0f;
+	}
+
+	int getFactor() const {
+		return M;
+	}
+
+	/// <summary>
+	/// Write the filter histories and the delay line to a checkpoint
+	/// </summary>
+	void saveState(CHECKPOINT::Writer& Out) const {
+		Out.write(static_cast<int32_t>(M));
+		Out.write(InputHistory.data(), InputHistory.size());
+		Out.write(LowHistory.data(), LowHistory.size());
+		Out.write(Dry.data(), Dry.size());
+		int32_t positions[5] = { inputPosition, lowPosition, dryPosition, phase, mergePhase };
+		Out.write(positions, 5);
+		Out.write(sidechainPeak);
+	}
+
+	/// <summary>
+	/// Read a checkpoint written by a splitter prepared the same way
+	/// </summary>
+	bool restoreState(CHECKPOINT::Reader& In) {
+		int32_t factor = 0;
+		int32_t positions[5] = {};
+		bool ok = In.read(factor) && factor == M && In.read(InputHistory.data(), InputHistory.size()) &&
+			In.read(LowHistory.data(), LowHistory.size()) && In.read(Dry.data(), Dry.size()) &&
+			In.read(positions, 5) && In.read(sidechainPeak);
+
+		ok = ok && positions[0] >= 0 && positions[0] < numTaps && positions[1] >= 0 && positions[1] < numPhaseTaps &&
+			positions[2] >= 0 && positions[2] < static_cast<int>(Dry.size()) && positions[3] >= 0 && positions[3] < M &&
+			positions[4] >= 0 && positions[4] < M;
+		if (!ok) {
+			reset();
+			return false;
+		}
+
+		inputPosition = positions[0];
+		lowPosition = positions[1];
+		dryPosition = positions[2];
+		phase = positions[3];
+		mergePhase = positions[4];
+		return true;
+	}
+
+	/// <summary>
+	/// Delay of the output, in samples at the full rate
+	/// </summary>
+	int getLatency() const {
+		return numTaps - 1;
+	}
+
+	/// <summary>
+	/// Most low band samples a number of input samples can produce
+	/// </summary>
+	int getMaxLowSamples(int numSamples) const {
+		return numSamples / M + 1;
+	}
+
+	/// <summary>
+	/// Decimate numSamples (at most maxBlockSize) of input into the low band. Keeps the input
+	/// for merge, so the output may be the same buffer
+	/// </summary>
+	/// <param name="low"> low band, at least getMaxLowSamples</param>
+	/// <param name="lowIndex"> index in the input each low band sample was taken at</param>
+	/// <param name="sidechain"> optional, the peak over each decimation period is taken into lowSidechain</param>
+	/// <returns> number of low band samples</returns>
+	int split(const float* in, int numSamples, float* low, int* lowIndex, const float* sidechain = nullptr, float* lowSidechain = nullptr) {
+		int numLow = 0;
+		for (int i = 0; i < numSamples; i++) {
+			float x = in[i];
+			InputHistory[inputPosition] = x;
+			InputHistory[inputPosition + numTaps] = x;
+			inputPosition = (inputPosition + 1 == numTaps) ? 0 : inputPosition + 1;
+
+			Dry[dryPosition] = x;
+			dryPosition = (dryPosition + 1 == static_cast<int>(Dry.size())) ? 0 : dryPosition + 1;
+
+			if (sidechain) {
+				sidechainPeak = std::max(sidechainPeak, fabsf(sidechain[i]));
+			}
+
+			if (++phase == M) {
+				phase = 0;
+
+				// Newest numTaps inputs, oldest first (the taps are symmetric)
+				const float* history = InputHistory.data() + inputPosition;
+				float y = 0.0f;
+				for (int k = 0; k < numTaps; k++) {
+					y += Taps[k] * history[k];
+				}
+
+				low[numLow] = y;
+				lowIndex[numLow] = i;
+				if (lowSidechain) {
+					lowSidechain[numLow] = sidechainPeak;
+				}
+				sidechainPeak = 0.0f;
+				numLow++;
+			}
+		}
+		return numLow;
+	}
+
+	/// <summary>
+	/// Write the output for the same samples as the last split: the delayed input plus the
+	/// interpolated difference the processing made to the low band
+	/// </summary>
+	void merge(const float* low, const float* processed, const int* lowIndex, int numLow, float* out, int numSamples) {
+		// Same samples as split, the input getLatency samples before the first of them
+		int readPosition = dryPosition - numSamples - getLatency();
+		while (readPosition < 0) {
+			readPosition += static_cast<int>(Dry.size());
+		}
+
+		int next = 0;
+		for (int i = 0; i < numSamples; i++) {
+			if (next < numLow && lowIndex[next] == i) {
+				float difference = processed[next] - low[next];
+				LowHistory[lowPosition] = difference;
+				LowHistory[lowPosition + numPhaseTaps] = difference;
+				lowPosition = (lowPosition + 1 == numPhaseTaps) ? 0 : lowPosition + 1;
+				mergePhase = 0;
+				next++;
+			}
+
+			const float* history = LowHistory.data() + lowPosition;
+			const float* taps = PhaseTaps.data() + mergePhase * numPhaseTaps;
+			float interpolated = 0.0f;
+			for (int j = 0; j < numPhaseTaps; j++) {
+				interpolated += taps[j] * history[j];
+			}
+			if (mergePhase < M - 1) {
+				mergePhase++;
+			}
+
+			if (readPosition >= static_cast<int>(Dry.size())) {
+				readPosition -= static_cast<int>(Dry.size());
+			}
+			out[i] = Dry[readPosition] + interpolated;
+			readPosition++;
+		}
+	}
+
+private:
+	int M = 1;
+	int numTaps = 1;
+	int numPhaseTaps = 1;
+
+	std::vector<float> Taps;
+	std::vector<float> PhaseTaps;
+	std::vector<float> InputHistory;
+	std::vector<float> LowHistory;
+	std::vector<float> Dry;
+
+	int inputPosition = 0;
+	int lowPosition = 0;
+	int dryPosition = 0;
+	int phase = 0;
+	int mergePhase = 0;
+	float sidechainPeak = 0.0f;
+};
@@ -0,0 +1,562 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "CirculateHelpers.h"
+#include "CirculateParameters.h"
+#include "AllpassFilter.h"
+#include "Limiter.h"
+#include <algorithm>
+#include <cmath>
+
+// Instances processed together, one per lane. Enough independent cascades to hide the latency of
+// a stage, which the rounding to float after every stage makes long
+#define BATCH_LANES 16
+
+/// <summary>
+/// Many independent instances of the cascade, processed together for offline and server
+/// rendering.
+///
+/// Each instance is mono and has the Center, Focus, Depth and Feedback parameters
+/// (normalised, smoothed as in the plugin), its own filter memory and feedback loop.
+/// Instances are grouped BATCH_LANES at a time and each group runs through its stages with
+/// the instances in lanes, so the stage loop runs over contiguous memory with a fixed trip
+/// count and maps onto SIMD lanes. A lone cascade is a chain of dependent operations, a
+/// group runs BATCH_LANES of them side by side for little more than the cost of one.
+///
+/// A group runs as many stages as its deepest instance, the others skip the extra stages.
+/// So instances are grouped by stage count: whenever a Depth changes, instances are moved
+/// between lanes (with their state) to put the deepest together.
+///
+/// Everything lives in flat per lane arrays (structure of arrays) in one arena, about a
+/// hundred bytes per instance plus the memory of its stages, against a whole CirculateEffect
+/// with its AudioEffectParameters. An instance renders the same samples as a CirculateEffect
+/// in Hz mode with the same parameters: the maths and the order of operations are the same.
+/// </summary>
+class BatchEffect {
+public:
+	/// <summary>
+	/// Size for a number of instances. Allocates, every instance starts cleared at the defaults
+	/// </summary>
+	/// <param name="stageLimit"> most stages of any instance (Depth 1), see CIRCULATE_PARAMS::getStageLimit</param>
+	void prepare(int numInstances, double sampleRate, int stageLimit) {
+		mNumInstances = std::max(numInstances, 0);
+		mNumGroups = (mNumInstances + BATCH_LANES - 1) / BATCH_LANES;
+		mNumLanes = mNumGroups * BATCH_LANES;
+		mStageLimit = std::clamp(stageLimit, 1, MAX_NUM_STAGES);
+		mSampleRate = static_cast<int>(sampleRate);
+
+		double nyQuist = (sampleRate / 2.0f);
+		maxAllowedFreq = MAX_FREQ_HZ;
+		if (nyQuist < MAX_FREQ_HZ) maxAllowedFreq = nyQuist - 500.0f;
+
+		// Same smoothing as the plugin's parameters and coefficients
+		mSmoothFactor[kBatchCenter] = getParamSmoothFactor(20, mSampleRate);
+		mSmoothFactor[kBatchFocus] = getParamSmoothFactor(20, mSampleRate);
+		mSmoothFactor[kBatchDepth] = 1.0;
+		mSmoothFactor[kBatchFeedback] = getParamSmoothFactor(10, mSampleRate);
+		AllpassFilter::AllpassInfo Info;
+		Info.setSmoothTime(5, mSampleRate);
+		mCoefficientSmoothFactor = Info.smoothFactor;
+
+		// One spare group, lane mNumLanes holds an instance while the others move
+		size_t numSlots = static_cast<size_t>(mNumLanes) + BATCH_LANES;
+		size_t slotBytes = HELPERS::AlignedArena::getAlignedBytes(numSlots * sizeof(double));
+		size_t bankBytes = HELPERS::AlignedArena::getAlignedBytes((mNumGroups + 1) * static_cast<size_t>(mStageLimit) * sizeof(double[BATCH_LANES]));
+		Arena.allocate((2 * kNumBatchParams + 11) * slotBytes + 2 * bankBytes);
+
+		for (int p = 0; p < kNumBatchParams; p++) {
+			Target[p] = Arena.take<double>(numSlots);
+			Smoothed[p] = Arena.take<double>(numSlots);
+		}
+		K = Arena.take<double>(numSlots);
+		G = Arena.take<double>(numSlots);
+		KTarget = Arena.take<double>(numSlots);
+		GTarget = Arena.take<double>(numSlots);
+		CoefficientCenter = Arena.take<double>(numSlots);
+		CoefficientFocus = Arena.take<double>(numSlots);
+		LastSample = Arena.take<float>(numSlots);
+		NumStages = Arena.take<int>(numSlots);
+		Flags = Arena.take<int>(numSlots);
+		LaneInstance = Arena.take<int>(numSlots);
+		InstanceLane = Arena.take<int>(numSlots);
+
+		S1 = Arena.take<double[BATCH_LANES]>((mNumGroups + 1) * static_cast<size_t>(mStageLimit));
+		S2 = Arena.take<double[BATCH_LANES]>((mNumGroups + 1) * static_cast<size_t>(mStageLimit));
+
+		for (int lane = 0; lane < mNumLanes; lane++) {
+			Target[kBatchCenter][lane] = DEFAULT_CENTER;
+			Target[kBatchFocus][lane] = DEFAULT_FOCUS;
+			Target[kBatchDepth][lane] = DEFAULT_DEPTH;
+			Target[kBatchFeedback][lane] = DEFAULT_FEED;
+			LaneInstance[lane] = (lane < mNumInstances) ? lane : -1;
+			InstanceLane[lane] = lane;
+			resetLane(lane);
+		}
+		mRegroup = true;
+	}
+
+	int getNumInstances() const {
+		return mNumInstances;
+	}
+
+	int getStageLimit() const {
+		return mStageLimit;
+	}
+
+	/// <summary>
+	/// Bytes of state for all instances
+	/// </summary>
+	size_t getMemorySize() const {
+		return Arena.getSize();
+	}
+
+	/// <summary>
+	/// Clear the memory of an instance. Its parameters jump to their values on the next block
+	/// </summary>
+	void reset(int instance) {
+		if (instance >= 0 && instance < mNumInstances) {
+			resetLane(InstanceLane[instance]);
+		}
+	}
+
+	void reset() {
+		for (int lane = 0; lane < mNumLanes; lane++) {
+			resetLane(lane);
+		}
+	}
+
+	/// <summary>
+	/// Set a normalised parameter of an instance, by CIRCULATE_PARAMS id (kCenter, kFocus,
+	/// kDepth or kFeed). It is smoothed from the previous value, as a host change is
+	/// </summary>
+	/// <returns> false for other parameters</returns>
+	bool setParameter(int id, int instance, double value) {
+		int p = getBatchParam(id);
+		if (p < 0 || instance < 0 || instance >= mNumInstances) {
+			return false;
+		}
+		int lane = InstanceLane[instance];
+		if (p == kBatchDepth && getStageCount(value) != getStageCount(Target[p][lane])) {
+			mRegroup = true;
+		}
+		Target[p][lane] = value;
+		return true;
+	}
+
+	/// <summary>
+	/// Set a parameter of every instance, values holds one per instance
+	/// </summary>
+	bool setParameter(int id, const double* values) {
+		if (getBatchParam(id) < 0) {
+			return false;
+		}
+		for (int i = 0; i < mNumInstances; i++) {
+			setParameter(id, i, values[i]);
+		}
+		return true;
+	}
+
+	double getParameter(int id, int instance) const {
+		int p = getBatchParam(id);
+		if (p < 0 || instance < 0 || instance >= mNumInstances) {
+			return 0.0;
+		}
+		return Target[p][InstanceLane[instance]];
+	}
+
+	/// <summary>
+	/// Process every instance, inputs[i] and outputs[i] are the samples of instance i
+	/// (may be the same buffer)
+	/// </summary>
+	void process(const float* const* inputs, float* const* outputs, int numSamples) {
+		alignas(64) static const float Silence[CONTROL_BLOCK_SIZE] = {};
+		alignas(64) float Discard[CONTROL_BLOCK_SIZE];
+
+		if (mRegroup) {
+			regroup();
+		}
+
+		for (int group = 0; group < mNumGroups; group++) {
+			updateStages(group);
+
+			for (int s = 0; s < numSamples; s += CONTROL_BLOCK_SIZE) {
+				int n = std::min(CONTROL_BLOCK_SIZE, numSamples - s);
+
+				// Lanes without an instance run on silence
+				const float* in[BATCH_LANES];
+				float* out[BATCH_LANES];
+				for (int l = 0; l < BATCH_LANES; l++) {
+					int instance = LaneInstance[group * BATCH_LANES + l];
+					in[l] = (instance >= 0) ? inputs[instance] + s : Silence;
+					out[l] = (instance >= 0) ? outputs[instance] + s : Discard;
+				}
+
+				BatchControl Control;
+				fillControl(Control, group, n);
+				runGroup(in, out, n, group, Control);
+			}
+		}
+	}
+
+private:
+	enum BatchParams {
+		kBatchCenter,
+		kBatchFocus,
+		kBatchDepth,
+		kBatchFeedback,
+		kNumBatchParams
+	};
+
+	enum LaneFlags {
+		kSnapParams = 1 << 0, // parameters jump to their targets (reset)
+		kSnapCoefficients = 1 << 1 // the same as AllpassInfo::force_snap
+	};
+
+	/// <summary>
+	/// Per sample values for a block of one group, lanes innermost
+	/// </summary>
+	struct BatchControl {
+		alignas(64) double g[CONTROL_BLOCK_SIZE][BATCH_LANES];
+		alignas(64) double R4[CONTROL_BLOCK_SIZE][BATCH_LANES];
+		alignas(64) double d[CONTROL_BLOCK_SIZE][BATCH_LANES];
+		alignas(64) double feedback[CONTROL_BLOCK_SIZE][BATCH_LANES];
+		alignas(64) float gain[CONTROL_BLOCK_SIZE][BATCH_LANES];
+	};
+
+	static int getBatchParam(int id) {
+		switch (id) {
+		case CIRCULATE_PARAMS::kCenter: return kBatchCenter;
+		case CIRCULATE_PARAMS::kFocus: return kBatchFocus;
+		case CIRCULATE_PARAMS::kDepth: return kBatchDepth;
+		case CIRCULATE_PARAMS::kFeed: return kBatchFeedback;
+		default: return -1;
+		}
+	}
+
+	/// <summary>
+	/// As ParamUnit::setSmoothTime
+	/// </summary>
+	static double getParamSmoothFactor(double timeInMs, int sampleRate) {
+		return 1.0f - expf(-2.0 * 3.141592653589 / (timeInMs * 0.001 * sampleRate));
+	}
+
+	int getStageCount(double depth) const {
+		return std::clamp(static_cast<int>(depth * mStageLimit + 0.5), 0, mStageLimit);
+	}
+
+	double& getMemory(double (*S)[BATCH_LANES], int lane, int stage) {
+		return S[(lane / BATCH_LANES) * mStageLimit + stage][lane % BATCH_LANES];
+	}
+
+	void resetLane(int lane) {
+		for (int i = 0; i < mStageLimit; i++) {
+			getMemory(S1, lane, i) = 0.0;
+			getMemory(S2, lane, i) = 0.0;
+		}
+		LastSample[lane] = 0.0f;
+		NumStages[lane] = 0;
+		Flags[lane] = kSnapParams | kSnapCoefficients;
+	}
+
+	/// <summary>
+	/// Copy everything of the instance in one lane to another
+	/// </summary>
+	void copyLane(int from, int to) {
+		for (int p = 0; p < kNumBatchParams; p++) {
+			Target[p][to] = Target[p][from];
+			Smoothed[p][to] = Smoothed[p][from];
+		}
+		K[to] = K[from];
+		G[to] = G[from];
+		KTarget[to] = KTarget[from];
+		GTarget[to] = GTarget[from];
+		CoefficientCenter[to] = CoefficientCenter[from];
+		CoefficientFocus[to] = CoefficientFocus[from];
+		LastSample[to] = LastSample[from];
+		NumStages[to] = NumStages[from];
+		Flags[to] = Flags[from];
+		LaneInstance[to] = LaneInstance[from];
+
+		for (int i = 0; i < mStageLimit; i++) {
+			getMemory(S1, to, i) = getMemory(S1, from, i);
+			getMemory(S2, to, i) = getMemory(S2, from, i);
+		}
+	}
+
+	/// <summary>
+	/// Put the instances in lanes by stage count, most first, so each group's instances run
+	/// about the same number of stages. Only moves the instances that change lanes
+	/// </summary>
+	void regroup() {
+		mRegroup = false;
+
+		// Source[lane] is the lane the instance that belongs in lane is in now. Ties keep their
+		// order, empty lanes go last. InstanceLane is rebuilt afterwards, so it holds Source
+		int* Source = InstanceLane;
+		for (int lane = 0; lane < mNumLanes; lane++) {
+			Source[lane] = lane;
+		}
+		std::sort(Source, Source + mNumLanes, [this](int a, int b) {
+			int stagesA = (LaneInstance[a] >= 0) ? getStageCount(Target[kBatchDepth][a]) : -1;
+			int stagesB = (LaneInstance[b] >= 0) ? getStageCount(Target[kBatchDepth][b]) : -1;
+			if (stagesA != stagesB) {
+				return stagesA > stagesB;
+			}
+			return a < b;
+		});
+
+		// Follow each cycle of the permutation, through the spare lane
+		const int spare = mNumLanes;
+		for (int start = 0; start < mNumLanes; start++) {
+			if (Source[start] == start) {
+				continue;
+			}
+			copyLane(start, spare);
+			int lane = start;
+			while (true) {
+				int from = Source[lane];
+				Source[lane] = lane;
+				if (from == start) {
+					copyLane(spare, lane);
+					break;
+				}
+				copyLane(from, lane);
+				lane = from;
+			}
+		}
+
+		for (int lane = 0; lane < mNumLanes; lane++) {
+			if (LaneInstance[lane] >= 0) {
+				InstanceLane[LaneInstance[lane]] = lane;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Stage count of each lane from Depth, clearing the memory of stages it gains
+	/// </summary>
+	void updateStages(int group) {
+		for (int l = 0; l < BATCH_LANES; l++) {
+			int lane = group * BATCH_LANES + l;
+			int numStages = (LaneInstance[lane] >= 0) ? getStageCount(Target[kBatchDepth][lane]) : 0;
+
+			for (int i = NumStages[lane]; i < numStages; i++) {
+				getMemory(S1, lane, i) = 0.0;
+				getMemory(S2, lane, i) = 0.0;
+			}
+			NumStages[lane] = numStages;
+		}
+	}
+
+	/// <summary>
+	/// Smooth the parameters and calculate the coefficients of each lane for n samples, as
+	/// CirculateEffect::fillControlBlock does in Hz mode. A lane whose parameters and
+	/// coefficients have settled keeps its coefficients, skipping the pow and tan
+	/// </summary>
+	void fillControl(BatchControl& Control, int group, int n) {
+		for (int l = 0; l < BATCH_LANES; l++) {
+			int lane = group * BATCH_LANES + l;
+
+			if (LaneInstance[lane] < 0) {
+				for (int i = 0; i < n; i++) {
+					Control.g[i][l] = 0.0;
+					Control.R4[i][l] = 0.0;
+					Control.d[i][l] = 1.0;
+					Control.feedback[i][l] = 0.0;
+					Control.gain[i][l] = 1.0f;
+				}
+				continue;
+			}
+
+			if (Flags[lane] & kSnapParams) {
+				for (int p = 0; p < kNumBatchParams; p++) {
+					Smoothed[p][lane] = Target[p][lane];
+				}
+				Flags[lane] &= ~kSnapParams;
+			}
+
+			AllpassFilter::AllpassInfo Info;
+			Info.smoothFactor = mCoefficientSmoothFactor;
+			Info.k = K[lane];
+			Info.g = G[lane];
+			Info.k_target = KTarget[lane];
+			Info.g_target = GTarget[lane];
+			Info.force_snap = (Flags[lane] & kSnapCoefficients) != 0;
+
+			// Nothing left to smooth, every sample of the block is the same as the first
+			bool steady = !Info.force_snap && Info.k == Info.k_target && Info.g == Info.g_target &&
+				Smoothed[kBatchCenter][lane] == Target[kBatchCenter][lane] && Smoothed[kBatchCenter][lane] == CoefficientCenter[lane] &&
+				Smoothed[kBatchFocus][lane] == Target[kBatchFocus][lane] && Smoothed[kBatchFocus][lane] == CoefficientFocus[lane] &&
+				Smoothed[kBatchFeedback][lane] == Target[kBatchFeedback][lane];
+			int numCalculated = steady ? std::min(n, 1) : n;
+
+			for (int i = 0; i < numCalculated; i++) {
+				double center = smoothParam(kBatchCenter, lane);
+				double focus = smoothParam(kBatchFocus, lane);
+				double feedback = smoothParam(kBatchFeedback, lane);
+
+				// Same inputs and nothing left to smooth, calculating would give the same values
+				bool settled = !Info.force_snap && Info.k == Info.k_target && Info.g == Info.g_target &&
+					center == CoefficientCenter[lane] && focus == CoefficientFocus[lane];
+
+				if (!settled) {
+					double freqHz = std::clamp(center, 0.0, 1.0);
+					freqHz = MIN_FREQ_HZ * std::pow(maxAllowedFreq / MIN_FREQ_HZ, freqHz);
+					AllpassFilter::calculateCoefficients(freqHz, focus * focus * focus, mSampleRate, Info);
+					CoefficientCenter[lane] = center;
+					CoefficientFocus[lane] = focus;
+				}
+
+				double g = Info.g;
+				double R = Info.k;
+				Control.g[i][l] = g;
+				Control.R4[i][l] = 4.0 * R;
+				Control.d[i][l] = 1.0 / (1.0 + 2 * R * g + (g * g));
+
+				if (std::abs(feedback - 0.5) < 0.1) {
+					feedback = 0.5;
+				}
+				feedback = (feedback - 0.5) * 1.98f;
+				if (NumStages[lane] == 0) {
+					feedback = 0;
+				}
+				Control.feedback[i][l] = feedback;
+				Control.gain[i][l] = sqrtf(1.0f - (std::abs(feedback) / 1.5f));
+			}
+			for (int i = numCalculated; i < n; i++) {
+				Control.g[i][l] = Control.g[0][l];
+				Control.R4[i][l] = Control.R4[0][l];
+				Control.d[i][l] = Control.d[0][l];
+				Control.feedback[i][l] = Control.feedback[0][l];
+				Control.gain[i][l] = Control.gain[0][l];
+			}
+
+			K[lane] = Info.k;
+			G[lane] = Info.g;
+			KTarget[lane] = Info.k_target;
+			GTarget[lane] = Info.g_target;
+			Flags[lane] = Info.force_snap ? (Flags[lane] | kSnapCoefficients) : (Flags[lane] & ~kSnapCoefficients);
+		}
+	}
+
+	/// <summary>
+	/// One sample of ParamUnit::smoothBlockValues, towards the target
+	/// </summary>
+	double smoothParam(int p, int lane) {
+		double target = Target[p][lane];
+		double smoothed = Smoothed[p][lane];
+
+		double diff = target - smoothed;
+		if (std::abs(diff) < 1e-3) {
+			smoothed = target;
+			diff = 0;
+		}
+		smoothed += diff * mSmoothFactor[p];
+
+		Smoothed[p][lane] = smoothed;
+		return smoothed;
+	}
+
+	/// <summary>
+	/// One stage of every lane, CASCADE::tick across the lanes. Nothing aliases (restrict), so the
+	/// lane loop is vectorised
+	/// </summary>
+	static inline void runStage(double* __restrict s1, double* __restrict s2, const double* __restrict g,
+		const double* __restrict R4, const double* __restrict d, double* __restrict x) {
+		for (int l = 0; l < BATCH_LANES; l++) {
+			double BP = (g[l] * (x[l] - s2[l]) + s1[l]) * d[l];
+			double BP2 = BP + BP;
+			s1[l] = BP2 - s1[l];
+			s2[l] = s2[l] + g[l] * BP2;
+			x[l] = static_cast<double>(static_cast<float>(x[l] - R4[l] * BP));
+		}
+	}
+
+	/// <summary>
+	/// Run n samples of a group through its stages, with feedback and the safety limiter per
+	/// lane, as CASCADE::Kernel does for one. Stages past a lane's count are masked with a zero
+	/// denominator: the sample and s2 go through unchanged, but s1 flips sign every sample. That
+	/// memory is never heard, updateStages clears the stages a lane gains before it runs them
+	/// </summary>
+	void runGroup(const float* const* in, float* const* out, int n, int group, const BatchControl& Control) {
+		double (*s1)[BATCH_LANES] = S1 + group * mStageLimit;
+		double (*s2)[BATCH_LANES] = S2 + group * mStageLimit;
+		float* lastSample = LastSample + group * BATCH_LANES;
+		const int* laneStages = NumStages + group * BATCH_LANES;
+
+		int minStages = mStageLimit;
+		int maxStages = 0;
+		for (int l = 0; l < BATCH_LANES; l++) {
+			minStages = std::min(minStages, laneStages[l]);
+			maxStages = std::max(maxStages, laneStages[l]);
+		}
+
+		for (int s = 0; s < n; s++) {
+			// Locals, so the stage loops don't have to allow for them aliasing the memory. The
+			// sample is rounded to float after every stage as in CASCADE::tick, but held in a
+			// double so the loops only work on doubles
+			alignas(64) double x[BATCH_LANES];
+			alignas(64) double g[BATCH_LANES];
+			alignas(64) double R4[BATCH_LANES];
+			alignas(64) double d[BATCH_LANES];
+
+			for (int l = 0; l < BATCH_LANES; l++) {
+				float currentSample = getLimitedSample(lastSample[l]);
+				currentSample = in[l][s] + (Control.feedback[s][l] * currentSample);
+				x[l] = currentSample * Control.gain[s][l];
+				g[l] = Control.g[s][l];
+				R4[l] = Control.R4[s][l];
+				d[l] = Control.d[s][l];
+			}
+
+			for (int i = 0; i < minStages; i++) {
+				runStage(s1[i], s2[i], g, R4, d, x);
+			}
+			for (int i = minStages; i < maxStages; i++) {
+				alignas(64) double masked[BATCH_LANES];
+				for (int l = 0; l < BATCH_LANES; l++) {
+					masked[l] = (i < laneStages[l]) ? d[l] : 0.0;
+				}
+				runStage(s1[i], s2[i], g, R4, masked, x);
+			}
+
+			for (int l = 0; l < BATCH_LANES; l++) {
+				lastSample[l] = getLimitedSample(static_cast<float>(x[l]));
+				out[l][s] = lastSample[l];
+			}
+		}
+	}
+
+	HELPERS::AlignedArena Arena;
+	int mNumInstances = 0;
+	int mNumGroups = 0;
+	int mNumLanes = 0;
+	int mStageLimit = UNROLLED_STAGES;
+	int mSampleRate = 48000;
+	double maxAllowedFreq = MAX_FREQ_HZ;
+	double mSmoothFactor[kNumBatchParams] = {};
+	double mCoefficientSmoothFactor = 0.0;
+	bool mRegroup = false;
+
+	// Per lane values, for mNumLanes lanes and a spare group
+	double* Target[kNumBatchParams] = {};
+	double* Smoothed[kNumBatchParams] = {};
+	double* K = nullptr;
+	double* G = nullptr;
+	double* KTarget = nullptr;
+	double* GTarget = nullptr;
+	// Center and Focus the coefficient targets were last calculated from
+	double* CoefficientCenter = nullptr;
+	double* CoefficientFocus = nullptr;
+	float* LastSample = nullptr;
+	int* NumStages = nullptr;
+	int* Flags = nullptr;
+	// Instance in each lane (-1 for none) and lane of each instance
+	int* LaneInstance = nullptr;
+	int* InstanceLane = nullptr;
+
+	// Memory of every stage, [group * mStageLimit + stage][lane]
+	double (*S1)[BATCH_LANES] = nullptr;
+	double (*S2)[BATCH_LANES] = nullptr;
+};
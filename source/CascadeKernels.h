@@ -0,0 +1,712 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <array>
+#include <cstring>
+#include <utility>
+#include "CirculateHelpers.h"
+#include "AllpassFilter.h"
+#include "Limiter.h"
+
+// Most values a topology precomputes per stage, for spread stages (StageCoefficients::values)
+#define TOPOLOGY_VALUES 4
+
+/// <summary>
+/// Compile time specialised kernels for the allpass cascade.
+///
+/// One kernel is instantiated for every stage count (0 to UNROLLED_STAGES), so the stage loop
+/// has a fixed trip count and is fully unrolled. Filter memory is copied from the AllpassBankState
+/// arrays to locals for the duration of a run, which lets the compiler keep it in registers
+/// between samples. Larger stage counts (up to MAX_NUM_STAGES) use LargeKernel, which runs the
+/// stages in unrolled blocks of UNROLLED_STAGES on the bank's memory.
+///
+/// The effect picks a kernel from KernelTable whenever the number of active stages changes.
+/// Kernels are also instantiated for single precision memory, chosen by the precision setting,
+/// and for each stage topology (Topologies), chosen by the effect's setTopology.
+/// </summary>
+namespace CASCADE {
+
+	/// <summary>
+	/// Per sample values for a run of the cascade. Filled once per sample by the effect,
+	/// so the kernels only have to read them.
+	/// </summary>
+	struct ControlBlock {
+		alignas(64) double g[CONTROL_BLOCK_SIZE];
+		double R[CONTROL_BLOCK_SIZE];
+		// Shared SVF denominator 1/(1 + 2Rg + g^2), the same for every stage
+		double d[CONTROL_BLOCK_SIZE];
+		double feedback[CONTROL_BLOCK_SIZE];
+		float gain[CONTROL_BLOCK_SIZE];
+		// Stages in the run, the same for every sample
+		int numStages = 0;
+	};
+
+	/// <summary>
+	/// Process one sample through a single stage, the same maths as AllpassFilter::getNext
+	/// but with the coefficients and state passed in.
+	/// </summary>
+	inline float tick(float x, double g, double R, double d, double& s1, double& s2) {
+		double BP = (g * (x - s2) + s1) * d;
+
+		double BP2 = BP + BP;
+		s1 = BP2 - s1;
+		s2 = s2 + g * BP2;
+
+		return x - 4.0 * R * BP;
+	}
+
+	/// <summary>
+	/// Single precision stage. Coefficients are still calculated in double and rounded once per sample, 
+	/// which is where most of the difference to the double stage comes from (a tiny shift of the center)
+	/// </summary>
+	inline float tick(float x, float g, float R, float d, float& s1, float& s2) {
+		float BP = (g * (x - s2) + s1) * d;
+
+		float BP2 = BP + BP;
+		s1 = BP2 - s1;
+		s2 = s2 + g * BP2;
+
+		return x - 4.0f * R * BP;
+	}
+
+	/// <summary>
+	/// Coefficients of each stage, when the stage centers are spread. Held for a run (at most
+	/// SPREAD_CONTROL_INTERVAL samples), R is shared by every stage.
+	/// The arrays are slices of the effect's arena, sized for the stage limit by attach
+	/// </summary>
+	struct StageCoefficients {
+		double* g = nullptr;
+		// SVF denominator 1/(1 + 2Rg + g^2) of each stage
+		double* d = nullptr;
+		// The same coefficients in the topology in use, TOPOLOGY_VALUES per stage (convertStages).
+		// Unused by the SVF, which runs from g, d and R
+		double* values = nullptr;
+		double R = 0.0;
+		int numStages = 0;
+
+		StageCoefficients() = default;
+		StageCoefficients(const StageCoefficients&) = delete;
+		StageCoefficients& operator=(const StageCoefficients&) = delete;
+
+		static size_t getArenaBytes(int stages) {
+			return 2 * HELPERS::AlignedArena::getAlignedBytes(stages * sizeof(double)) +
+				HELPERS::AlignedArena::getAlignedBytes(stages * TOPOLOGY_VALUES * sizeof(double));
+		}
+
+		void attach(HELPERS::AlignedArena& Arena, int stages) {
+			g = Arena.take<double>(stages);
+			d = Arena.take<double>(stages);
+			values = Arena.take<double>(stages * TOPOLOGY_VALUES);
+			numStages = stages;
+		}
+
+		void copyFrom(const StageCoefficients& Other) {
+			memcpy(g, Other.g, sizeof(double) * numStages);
+			memcpy(d, Other.d, sizeof(double) * numStages);
+			memcpy(values, Other.values, sizeof(double) * numStages * TOPOLOGY_VALUES);
+			R = Other.R;
+		}
+	};
+
+	/// <summary>
+	/// Ways of running one allpass stage. All three have the response of the SVF allpass for the
+	/// same g and R, the bilinear transform (a2 + a1 z^-1 + z^-2) / (1 + a1 z^-1 + a2 z^-2) with
+	/// a1 = 2(g^2 - 1)d and a2 = (1 - 2Rg + g^2)d, and two memory values per stage, so they share
+	/// the banks. The memory means something different in each, so it is cleared on a change.
+	/// Each topology turns the shared g, R and d into its own coefficients once per sample (make),
+	/// or once per spread run. They differ in cost and in how they take moving coefficients:
+	///
+	/// SVF, Zavalishin's TPT state variable filter (AllpassFilter, ReferenceEffect). The memory
+	/// is the state of two integrators, which doesn't jump when g or R do, so sweeps and audio
+	/// rate modulation stay smooth. 4 dependent operations from a stage's input to its output,
+	/// 7 in all.
+	///
+	/// Lattice, normalized lattice of two plane rotations. Every section is orthogonal whatever
+	/// the coefficients, so the energy in the memory can't grow however they move: stable under
+	/// any modulation. 1 operation from input to output, 8 multiplies per stage. The inner
+	/// rotation only depends on g, so Focus moves only the outer one.
+	///
+	/// TDF2, transposed direct form II. The cheapest stage, 1 operation from input to output and
+	/// 4 in all, but the memory holds partial sums weighted by the coefficients, so moving them
+	/// makes transients, and fast or wide sweeps can pump energy in until the limiter catches
+	/// it, worst with the poles near the unit circle (low center, high Focus). a1 and a2 approach -2 and 1 at low
+	/// centers, so 32 bit memory drifts further from the response than with the others. Meant for
+	/// held or slowly moving coefficients, CirculateConformance only checks it held.
+	/// </summary>
+	enum Topologies {
+		kTopologySVF,
+		kTopologyLattice,
+		kTopologyTDF2,
+		kNumTopologies
+	};
+
+	/// <summary>
+	/// TPT SVF stages, the kernels as they were before the other topologies. tick is the stage
+	/// above, so results don't depend on the topology plumbing
+	/// </summary>
+	struct SVFTopology {
+		template <typename T>
+		struct Coefficients {
+			T g;
+			T R;
+			T d;
+		};
+
+		template <typename T>
+		static Coefficients<T> make(double g, double R, double d) {
+			return { static_cast<T>(g), static_cast<T>(R), static_cast<T>(d) };
+		}
+
+		template <typename T>
+		static float tick(float x, const Coefficients<T>& C, T& s1, T& s2) {
+			return CASCADE::tick(x, C.g, C.R, C.d, s1, s2);
+		}
+
+		/// <summary>
+		/// Coefficients of a spread stage, straight from g, d and R
+		/// </summary>
+		template <typename T>
+		static Coefficients<T> getStage(const StageCoefficients& Stages, int i) {
+			return make<T>(Stages.g[i], Stages.R, Stages.d[i]);
+		}
+
+		static void convertStages(StageCoefficients&, int) {}
+
+		/// Per lane coefficients of one sample, for runLanes
+		template <typename T>
+		struct LaneValues {
+			alignas(32) T g[BANK_LANES];
+			alignas(32) T d[BANK_LANES];
+			T R4;
+		};
+
+		template <typename T>
+		static void makeLanes(LaneValues<T>& V, const double* g, double R, const double* d) {
+			V.R4 = static_cast<T>(4.0 * R);
+			for (int l = 0; l < BANK_LANES; l++) {
+				V.g[l] = static_cast<T>(g[l]);
+				V.d[l] = static_cast<T>(d[l]);
+			}
+		}
+
+		/// <summary>
+		/// One stage of every lane, the lane loop maps onto SIMD lanes
+		/// </summary>
+		template <typename T>
+		static void tickLanes(T* x, const LaneValues<T>& V, T* s1, T* s2) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				T BP = (V.g[l] * (x[l] - s2[l]) + s1[l]) * V.d[l];
+				T BP2 = BP + BP;
+				s1[l] = BP2 - s1[l];
+				s2[l] = s2[l] + V.g[l] * BP2;
+				x[l] = x[l] - V.R4 * BP;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Normalized lattice stages. The outer rotation (k2 = a2, c2 = sqrt(1 - k2^2)) takes the
+	/// input and the inner section's delayed output, the inner one (k1 = a1 / (1 + a2), which
+	/// is (g^2 - 1) / (g^2 + 1), c1 = 2g / (g^2 + 1)) closes on its own delayed output.
+	/// s1 holds the inner output, s2 the inner section's output to the outer one
+	/// </summary>
+	struct LatticeTopology {
+		template <typename T>
+		struct Coefficients {
+			T k1;
+			T c1;
+			T k2;
+			T c2;
+		};
+
+		template <typename T>
+		static Coefficients<T> make(double g, double R, double d) {
+			double gg = g * g;
+			double norm = 1.0 / (1.0 + gg);
+			double k2 = (1.0 - 2.0 * R * g + gg) * d;
+			// sqrt(1 - k2^2) without the cancellation near k2 = 1 (low centers)
+			double c2 = 2.0 * sqrt(2.0 * R * g * (1.0 + gg)) * d;
+			return { static_cast<T>((gg - 1.0) * norm), static_cast<T>(2.0 * g * norm), static_cast<T>(k2), static_cast<T>(c2) };
+		}
+
+		template <typename T>
+		static float tick(float x, const Coefficients<T>& C, T& s1, T& s2) {
+			T in = x;
+			T y = C.k2 * in + C.c2 * s2;
+			T f1 = C.c2 * in - C.k2 * s2;
+
+			T f0 = C.c1 * f1 - C.k1 * s1;
+			s2 = C.k1 * f1 + C.c1 * s1;
+			s1 = f0;
+
+			return static_cast<float>(y);
+		}
+
+		template <typename T>
+		static Coefficients<T> getStage(const StageCoefficients& Stages, int i) {
+			const double* v = Stages.values + i * TOPOLOGY_VALUES;
+			return { static_cast<T>(v[0]), static_cast<T>(v[1]), static_cast<T>(v[2]), static_cast<T>(v[3]) };
+		}
+
+		static void convertStages(StageCoefficients& Stages, int numStages) {
+			for (int i = 0; i < numStages; i++) {
+				Coefficients<double> C = make<double>(Stages.g[i], Stages.R, Stages.d[i]);
+				double* v = Stages.values + i * TOPOLOGY_VALUES;
+				v[0] = C.k1;
+				v[1] = C.c1;
+				v[2] = C.k2;
+				v[3] = C.c2;
+			}
+		}
+
+		template <typename T>
+		struct LaneValues {
+			alignas(32) T k1[BANK_LANES];
+			alignas(32) T c1[BANK_LANES];
+			alignas(32) T k2[BANK_LANES];
+			alignas(32) T c2[BANK_LANES];
+		};
+
+		template <typename T>
+		static void makeLanes(LaneValues<T>& V, const double* g, double R, const double* d) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				Coefficients<T> C = make<T>(g[l], R, d[l]);
+				V.k1[l] = C.k1;
+				V.c1[l] = C.c1;
+				V.k2[l] = C.k2;
+				V.c2[l] = C.c2;
+			}
+		}
+
+		template <typename T>
+		static void tickLanes(T* x, const LaneValues<T>& V, T* s1, T* s2) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				T in = x[l];
+				T f1 = V.c2[l] * in - V.k2[l] * s2[l];
+				x[l] = V.k2[l] * in + V.c2[l] * s2[l];
+
+				T f0 = V.c1[l] * f1 - V.k1[l] * s1[l];
+				s2[l] = V.k1[l] * f1 + V.c1[l] * s1[l];
+				s1[l] = f0;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Transposed direct form II stages, y = a2 x + s1, s1 = a1 (x - y) + s2, s2 = x - a2 y.
+	/// The numerator is the denominator reversed, so two coefficients cover both
+	/// </summary>
+	struct TDF2Topology {
+		template <typename T>
+		struct Coefficients {
+			T a1;
+			T a2;
+		};
+
+		template <typename T>
+		static Coefficients<T> make(double g, double R, double d) {
+			double gg = g * g;
+			return { static_cast<T>(2.0 * (gg - 1.0) * d), static_cast<T>((1.0 - 2.0 * R * g + gg) * d) };
+		}
+
+		template <typename T>
+		static float tick(float x, const Coefficients<T>& C, T& s1, T& s2) {
+			T in = x;
+			T y = C.a2 * in + s1;
+			s1 = C.a1 * (in - y) + s2;
+			s2 = in - C.a2 * y;
+
+			return static_cast<float>(y);
+		}
+
+		template <typename T>
+		static Coefficients<T> getStage(const StageCoefficients& Stages, int i) {
+			const double* v = Stages.values + i * TOPOLOGY_VALUES;
+			return { static_cast<T>(v[0]), static_cast<T>(v[1]) };
+		}
+
+		static void convertStages(StageCoefficients& Stages, int numStages) {
+			for (int i = 0; i < numStages; i++) {
+				Coefficients<double> C = make<double>(Stages.g[i], Stages.R, Stages.d[i]);
+				double* v = Stages.values + i * TOPOLOGY_VALUES;
+				v[0] = C.a1;
+				v[1] = C.a2;
+			}
+		}
+
+		template <typename T>
+		struct LaneValues {
+			alignas(32) T a1[BANK_LANES];
+			alignas(32) T a2[BANK_LANES];
+		};
+
+		template <typename T>
+		static void makeLanes(LaneValues<T>& V, const double* g, double R, const double* d) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				Coefficients<T> C = make<T>(g[l], R, d[l]);
+				V.a1[l] = C.a1;
+				V.a2[l] = C.a2;
+			}
+		}
+
+		template <typename T>
+		static void tickLanes(T* x, const LaneValues<T>& V, T* s1, T* s2) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				T in = x[l];
+				T y = V.a2[l] * in + s1[l];
+				s1[l] = V.a1[l] * (in - y) + s2[l];
+				s2[l] = in - V.a2[l] * y;
+				x[l] = y;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Fill the values of the first numStages spread stages for a topology, after g and d change
+	/// </summary>
+	inline void convertStages(StageCoefficients& Stages, int numStages, int topology) {
+		switch (topology) {
+		case kTopologyLattice:
+			LatticeTopology::convertStages(Stages, numStages);
+			break;
+		case kTopologyTDF2:
+			TDF2Topology::convertStages(Stages, numStages);
+			break;
+		default:
+			SVFTopology::convertStages(Stages, numStages);
+			break;
+		}
+	}
+
+	/// <summary>
+	/// Run x through the stages of I, unrolled. An empty I (N = 0) passes x through, leaving the
+	/// other parameters unused
+	/// </summary>
+	template <typename Topology, typename T, std::size_t... I>
+	inline float cascadeSample(float x, [[maybe_unused]] const typename Topology::template Coefficients<T>& C,
+		[[maybe_unused]] T* s1, [[maybe_unused]] T* s2, std::index_sequence<I...>) {
+		((x = Topology::tick(x, C, s1[I], s2[I])), ...);
+		return x;
+	}
+
+	/// <summary>
+	/// Cascade of N stages, with memory in Bank (AllpassBankState for double precision,
+	/// AllpassBankStateFloat for single precision), in one of the topologies
+	/// </summary>
+	template <int N, typename Bank, typename Topology = SVFTopology>
+	struct Kernel {
+		using SampleType = typename Bank::SampleType;
+
+		/// <summary>
+		/// Run numSamples through N stages, including feedback and the safety limiter.
+		/// </summary>
+		/// <param name="lastSample"> Output of the previous sample, used for feedback</param>
+		/// <returns> The last output sample, to carry feedback into the next run</returns>
+		static float run(const float* inBuffer, float* outBuffer, int numSamples, const ControlBlock& Control, float lastSample, Bank& State) {
+			// Local copies of the filter memory (at least one element so N = 0 is legal)
+			SampleType s1[N > 0 ? N : 1];
+			SampleType s2[N > 0 ? N : 1];
+
+			for (int i = 0; i < N; i++) {
+				s1[i] = State.s1[i];
+				s2[i] = State.s2[i];
+			}
+
+			float currentSample = lastSample;
+
+			for (int s = 0; s < numSamples; s++) {
+				// Safety limit feedback
+				currentSample = getLimitedSample(currentSample);
+				// Add feedback
+				currentSample = inBuffer[s] + (Control.feedback[s] * currentSample);
+				// Gain compensation
+				currentSample *= Control.gain[s];
+
+				// Coefficients of this sample, shared by every stage
+				const auto C = Topology::template make<SampleType>(Control.g[s], Control.R[s], Control.d[s]);
+				currentSample = cascadeSample<Topology>(currentSample, C, s1, s2, std::make_index_sequence<N>());
+
+				currentSample = getLimitedSample(currentSample);
+				outBuffer[s] = currentSample;
+			}
+
+			for (int i = 0; i < N; i++) {
+				State.s1[i] = s1[i];
+				State.s2[i] = s2[i];
+			}
+
+			return currentSample;
+		}
+	};
+
+	/// <summary>
+	/// Cascade of more than UNROLLED_STAGES stages (Control.numStages). Each sample runs through
+	/// unrolled blocks of UNROLLED_STAGES then the remaining stages, with the memory left in the
+	/// bank, as there are too many stages to hold it in registers.
+	/// </summary>
+	template <typename Bank, typename Topology = SVFTopology>
+	struct LargeKernel {
+		using SampleType = typename Bank::SampleType;
+
+		static float run(const float* inBuffer, float* outBuffer, int numSamples, const ControlBlock& Control, float lastSample, Bank& State) {
+			const int numBlocks = Control.numStages / UNROLLED_STAGES;
+			SampleType* s1 = State.s1;
+			SampleType* s2 = State.s2;
+
+			float currentSample = lastSample;
+
+			for (int s = 0; s < numSamples; s++) {
+				currentSample = getLimitedSample(currentSample);
+				currentSample = inBuffer[s] + (Control.feedback[s] * currentSample);
+				currentSample *= Control.gain[s];
+
+				const auto C = Topology::template make<SampleType>(Control.g[s], Control.R[s], Control.d[s]);
+
+				for (int b = 0; b < numBlocks; b++) {
+					currentSample = cascadeSample<Topology>(currentSample, C, s1 + b * UNROLLED_STAGES, s2 + b * UNROLLED_STAGES,
+						std::make_index_sequence<UNROLLED_STAGES>());
+				}
+				for (int i = numBlocks * UNROLLED_STAGES; i < Control.numStages; i++) {
+					currentSample = Topology::tick(currentSample, C, s1[i], s2[i]);
+				}
+
+				currentSample = getLimitedSample(currentSample);
+				outBuffer[s] = currentSample;
+			}
+
+			return currentSample;
+		}
+	};
+
+	/// <summary>
+	/// As cascadeSample, with coefficients per stage
+	/// </summary>
+	template <typename Topology, typename T, std::size_t... I>
+	inline float spreadCascadeSample(float x, [[maybe_unused]] const typename Topology::template Coefficients<T>* C,
+		[[maybe_unused]] T* s1, [[maybe_unused]] T* s2, std::index_sequence<I...>) {
+		((x = Topology::tick(x, C[I], s1[I], s2[I])), ...);
+		return x;
+	}
+
+	/// <summary>
+	/// As spreadCascadeSample, with the coefficients read from Stages as they are used
+	/// </summary>
+	template <typename Topology, typename T, std::size_t... I>
+	inline float stagesCascadeSample(float x, [[maybe_unused]] const StageCoefficients& Stages, [[maybe_unused]] int first,
+		[[maybe_unused]] T* s1, [[maybe_unused]] T* s2, std::index_sequence<I...>) {
+		((x = Topology::tick(x, Topology::template getStage<T>(Stages, first + static_cast<int>(I)), s1[I], s2[I])), ...);
+		return x;
+	}
+
+	/// <summary>
+	/// Cascade of N stages, each with its own center (from Stages). Otherwise the same as Kernel,
+	/// the coefficients are copied to locals for the run alongside the filter memory, so the
+	/// stage loop costs the same as with shared coefficients
+	/// </summary>
+	template <int N, typename Bank, typename Topology = SVFTopology>
+	struct SpreadKernel {
+		using SampleType = typename Bank::SampleType;
+
+		static float run(const float* inBuffer, float* outBuffer, int numSamples, const ControlBlock& Control,
+			const StageCoefficients& Stages, float lastSample, Bank& State) {
+			SampleType s1[N > 0 ? N : 1];
+			SampleType s2[N > 0 ? N : 1];
+			typename Topology::template Coefficients<SampleType> C[N > 0 ? N : 1];
+
+			for (int i = 0; i < N; i++) {
+				s1[i] = State.s1[i];
+				s2[i] = State.s2[i];
+				C[i] = Topology::template getStage<SampleType>(Stages, i);
+			}
+
+			float currentSample = lastSample;
+
+			for (int s = 0; s < numSamples; s++) {
+				currentSample = getLimitedSample(currentSample);
+				currentSample = inBuffer[s] + (Control.feedback[s] * currentSample);
+				currentSample *= Control.gain[s];
+
+				currentSample = spreadCascadeSample<Topology>(currentSample, C, s1, s2, std::make_index_sequence<N>());
+
+				currentSample = getLimitedSample(currentSample);
+				outBuffer[s] = currentSample;
+			}
+
+			for (int i = 0; i < N; i++) {
+				State.s1[i] = s1[i];
+				State.s2[i] = s2[i];
+			}
+
+			return currentSample;
+		}
+	};
+
+	/// <summary>
+	/// Spread cascade of more than UNROLLED_STAGES stages, the same blocks as LargeKernel with the
+	/// coefficients read from Stages
+	/// </summary>
+	template <typename Bank, typename Topology = SVFTopology>
+	struct LargeSpreadKernel {
+		using SampleType = typename Bank::SampleType;
+
+		static float run(const float* inBuffer, float* outBuffer, int numSamples, const ControlBlock& Control,
+			const StageCoefficients& Stages, float lastSample, Bank& State) {
+			const int numBlocks = Control.numStages / UNROLLED_STAGES;
+			SampleType* s1 = State.s1;
+			SampleType* s2 = State.s2;
+
+			float currentSample = lastSample;
+
+			for (int s = 0; s < numSamples; s++) {
+				currentSample = getLimitedSample(currentSample);
+				currentSample = inBuffer[s] + (Control.feedback[s] * currentSample);
+				currentSample *= Control.gain[s];
+
+				for (int b = 0; b < numBlocks; b++) {
+					int first = b * UNROLLED_STAGES;
+					currentSample = stagesCascadeSample<Topology>(currentSample, Stages, first, s1 + first, s2 + first,
+						std::make_index_sequence<UNROLLED_STAGES>());
+				}
+				for (int i = numBlocks * UNROLLED_STAGES; i < Control.numStages; i++) {
+					currentSample = Topology::tick(currentSample, Topology::template getStage<SampleType>(Stages, i), s1[i], s2[i]);
+				}
+
+				currentSample = getLimitedSample(currentSample);
+				outBuffer[s] = currentSample;
+			}
+
+			return currentSample;
+		}
+	};
+
+	/// <summary>
+	/// Per sample coefficients of each lane, for the parallel banks in chord mode.
+	/// R, feedback and gain are shared and come from the ControlBlock
+	/// </summary>
+	struct LaneCoefficients {
+		alignas(64) double g[CONTROL_BLOCK_SIZE][BANK_LANES];
+		alignas(64) double d[CONTROL_BLOCK_SIZE][BANK_LANES];
+		// Output weight of each lane, 1 / number of banks, 0 for unused lanes
+		double weight[BANK_LANES];
+	};
+
+	/// <summary>
+	/// Run numSamples through BANK_LANES parallel cascades of numStages each, all fed from the 
+	/// same input, each with its own feedback loop and limiter, summed by lane weight.
+	/// The lane loops have a fixed trip count over contiguous, aligned memory so they map
+	/// onto SIMD lanes, which makes all lanes cost about the same as one.
+	/// LaneBank is AllpassLaneState (double) or AllpassLaneStateFloat (single precision, twice the
+	/// lanes per vector register)
+	/// </summary>
+	/// <param name="lastSamples"> Output of the previous sample for each lane, used for feedback</param>
+	template <typename Topology, typename LaneBank>
+	inline void runLanes(const float* inBuffer, float* outBuffer, int numSamples, int numStages, const ControlBlock& Control,
+		const LaneCoefficients& Lanes, float* lastSamples, LaneBank& Bank) {
+
+		using T = typename LaneBank::SampleType;
+
+		for (int s = 0; s < numSamples; s++) {
+			alignas(32) T x[BANK_LANES];
+			typename Topology::template LaneValues<T> V;
+			Topology::makeLanes(V, Lanes.g[s], Control.R[s], Lanes.d[s]);
+
+			for (int l = 0; l < BANK_LANES; l++) {
+				// Safety limit feedback, add feedback and compensate gain
+				float fedBack = getLimitedSample(lastSamples[l]);
+				x[l] = static_cast<float>(inBuffer[s] + (Control.feedback[s] * fedBack)) * Control.gain[s];
+			}
+
+			for (int i = 0; i < numStages; i++) {
+				Topology::tickLanes(x, V, Bank.s1[i], Bank.s2[i]);
+			}
+
+			float out = 0.0f;
+			for (int l = 0; l < BANK_LANES; l++) {
+				lastSamples[l] = getLimitedSample(static_cast<float>(x[l]));
+				out += static_cast<float>(Lanes.weight[l]) * lastSamples[l];
+			}
+			outBuffer[s] = out;
+		}
+	}
+
+	template <typename Bank>
+	using KernelFunction = float (*)(const float*, float*, int, const ControlBlock&, float, Bank&);
+
+	template <typename Bank, typename Topology, std::size_t... N>
+	constexpr std::array<KernelFunction<Bank>, sizeof...(N)> makeKernelTable(std::index_sequence<N...>) {
+		return { &Kernel<static_cast<int>(N), Bank, Topology>::run... };
+	}
+
+	/// Kernel for each stage count up to UNROLLED_STAGES, index with the number of active stages
+	template <typename Bank, typename Topology>
+	inline const std::array<KernelFunction<Bank>, UNROLLED_STAGES + 1> KernelTable = makeKernelTable<Bank, Topology>(std::make_index_sequence<UNROLLED_STAGES + 1>());
+
+	template <typename Bank, typename Topology>
+	inline KernelFunction<Bank> getTopologyKernel(int numStages) {
+		if (numStages < 0) numStages = 0;
+		if (numStages > UNROLLED_STAGES) return &LargeKernel<Bank, Topology>::run;
+		return KernelTable<Bank, Topology>[numStages];
+	}
+
+	template <typename Bank>
+	inline KernelFunction<Bank> getKernel(int numStages, int topology = kTopologySVF) {
+		switch (topology) {
+		case kTopologyLattice:
+			return getTopologyKernel<Bank, LatticeTopology>(numStages);
+		case kTopologyTDF2:
+			return getTopologyKernel<Bank, TDF2Topology>(numStages);
+		default:
+			return getTopologyKernel<Bank, SVFTopology>(numStages);
+		}
+	}
+
+	template <typename Bank>
+	using SpreadKernelFunction = float (*)(const float*, float*, int, const ControlBlock&, const StageCoefficients&, float, Bank&);
+
+	template <typename Bank, typename Topology, std::size_t... N>
+	constexpr std::array<SpreadKernelFunction<Bank>, sizeof...(N)> makeSpreadKernelTable(std::index_sequence<N...>) {
+		return { &SpreadKernel<static_cast<int>(N), Bank, Topology>::run... };
+	}
+
+	/// Spread kernel for each stage count
+	template <typename Bank, typename Topology>
+	inline const std::array<SpreadKernelFunction<Bank>, UNROLLED_STAGES + 1> SpreadKernelTable = makeSpreadKernelTable<Bank, Topology>(std::make_index_sequence<UNROLLED_STAGES + 1>());
+
+	template <typename Bank, typename Topology>
+	inline SpreadKernelFunction<Bank> getTopologySpreadKernel(int numStages) {
+		if (numStages < 0) numStages = 0;
+		if (numStages > UNROLLED_STAGES) return &LargeSpreadKernel<Bank, Topology>::run;
+		return SpreadKernelTable<Bank, Topology>[numStages];
+	}
+
+	template <typename Bank>
+	inline SpreadKernelFunction<Bank> getSpreadKernel(int numStages, int topology = kTopologySVF) {
+		switch (topology) {
+		case kTopologyLattice:
+			return getTopologySpreadKernel<Bank, LatticeTopology>(numStages);
+		case kTopologyTDF2:
+			return getTopologySpreadKernel<Bank, TDF2Topology>(numStages);
+		default:
+			return getTopologySpreadKernel<Bank, SVFTopology>(numStages);
+		}
+	}
+
+	template <typename LaneBank>
+	using LaneKernelFunction = void (*)(const float*, float*, int, int, const ControlBlock&, const LaneCoefficients&, float*, LaneBank&);
+
+	/// <summary>
+	/// runLanes in a topology, any number of stages
+	/// </summary>
+	template <typename LaneBank>
+	inline LaneKernelFunction<LaneBank> getLaneKernel(int topology = kTopologySVF) {
+		switch (topology) {
+		case kTopologyLattice:
+			return &runLanes<LatticeTopology, LaneBank>;
+		case kTopologyTDF2:
+			return &runLanes<TDF2Topology, LaneBank>;
+		default:
+			return &runLanes<SVFTopology, LaneBank>;
+		}
+	}
+}
@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "CirculateHelpers.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#define CHECKPOINT_MAGIC 0x50434943u // "CICP"
+// Bump when EffectState changes, including through BANK_LANES
+#define CHECKPOINT_VERSION 1u
+
+/// <summary>
+/// Snapshots of the processing state of CirculateEffect, for resuming a render from a cached
+/// point, comparing kernels from identical state, or freezing and continuing.
+///
+/// A checkpoint is plain bytes in native byte order: an EffectState, then the memory of the
+/// engine that is running (the active stages of the single bank or of every lane, in the
+/// precision in use, the spectral engine's buffers, or the band split and its low band effect).
+/// Values derived from the parameters or cached between runs aren't stored, they are rebuilt.
+/// Restoring needs an effect set up at the same sample rate.
+/// </summary>
+namespace CHECKPOINT {
+
+	enum StateFlags {
+		kUseFloat = 1 << 0,
+		kUseSpectral = 1 << 1,
+		kUseBandSplit = 1 << 2,
+		kChordActive = 1 << 3,
+		kModActive = 1 << 4,
+		kForceSnap = 1 << 5 // the coefficients jump to their next targets
+	};
+
+	struct EffectState {
+		uint32_t magic = CHECKPOINT_MAGIC;
+		uint32_t version = CHECKPOINT_VERSION;
+		double sampleRate = 0.0;
+		int32_t stageLimit = 0;
+		int32_t numActiveStages = 0;
+		int32_t previousActiveStages = 0;
+		uint32_t flags = 0;
+
+		// Coefficient smoothing (AllpassInfo)
+		double k = 0.0;
+		double g = 0.0;
+		double kTarget = 0.0;
+		double gTarget = 0.0;
+
+		double noteSmoother = 0.0;
+		double sidechainEnvelope = 0.0;
+
+		// Control rate g of sidechain modulation and chord lanes
+		double modG = 0.0;
+		double modGStep = 0.0;
+		double laneG[BANK_LANES] = {};
+		double laneGStep[BANK_LANES] = {};
+		int32_t modCounter = 0;
+		int32_t laneCounter = 0;
+
+		// Feedback memory
+		float currentSample = 0.0f;
+		float laneLastSamples[BANK_LANES] = {};
+		uint32_t topology = 0; // CASCADE::Topologies, also keeps the struct free of padding
+	};
+
+	// Version 1 checkpoints hold 4 lanes
+	static_assert(BANK_LANES == 4, "EffectState changed size with BANK_LANES, bump CHECKPOINT_VERSION and update this check");
+
+	/// <summary>
+	/// Appends values to a buffer. With no buffer it only counts the bytes, writing past the
+	/// capacity is counted but not written, check fits
+	/// </summary>
+	class Writer {
+	public:
+		Writer(void* buffer = nullptr, size_t capacity = 0) : Buffer(static_cast<uint8_t*>(buffer)), capacity(capacity) {}
+
+		template <typename T>
+		void write(const T* values, size_t count) {
+			static_assert(std::is_trivially_copyable<T>::value, "checkpoints hold plain values");
+			size_t bytes = sizeof(T) * count;
+			if (Buffer && position + bytes <= capacity) {
+				memcpy(Buffer + position, values, bytes);
+			}
+			position += bytes;
+		}
+
+		template <typename T>
+		void write(const T& value) {
+			write(&value, 1);
+		}
+
+		size_t getSize() const {
+			return position;
+		}
+
+		bool fits() const {
+			return Buffer && position <= capacity;
+		}
+
+	private:
+		uint8_t* Buffer = nullptr;
+		size_t capacity = 0;
+		size_t position = 0;
+	};
+
+	/// <summary>
+	/// Reads values back in the order they were written. A read past the end fails, and every
+	/// read after it
+	/// </summary>
+	class Reader {
+	public:
+		Reader(const void* buffer, size_t size) : Buffer(static_cast<const uint8_t*>(buffer)), size(size) {}
+
+		template <typename T>
+		bool read(T* values, size_t count) {
+			static_assert(std::is_trivially_copyable<T>::value, "checkpoints hold plain values");
+			size_t bytes = sizeof(T) * count;
+			if (failed || !Buffer || position + bytes > size) {
+				failed = true;
+				return false;
+			}
+			memcpy(values, Buffer + position, bytes);
+			position += bytes;
+			return true;
+		}
+
+		template <typename T>
+		bool read(T& value) {
+			return read(&value, 1);
+		}
+
+		/// <summary>
+		/// Every byte read and nothing failed
+		/// </summary>
+		bool isComplete() const {
+			return !failed && position == size;
+		}
+
+	private:
+		const uint8_t* Buffer = nullptr;
+		size_t size = 0;
+		size_t position = 0;
+		bool failed = false;
+	};
+}
@@ -6,24 +6,103 @@
 #include "CirculateParameters.h"
 #include "AllpassFilter.h"
 #include "Limiter.h"
+#include "CascadeKernels.h"
+#include "SpectralDispersion.h"
+#include "BandSplit.h"
+#include "Checkpoint.h"
+#include "Trace.h"
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 class CirculateEffect {
 public:
-	void setSampleRateBlockSize(HELPERS::SetupInfo Setup) {
-		for (int i = 0; i < MAX_NUM_STAGES; i++) {
-			AP[i].setSampleRateBlockSize(Setup);
+	CirculateEffect() {
+		setStageLimit(UNROLLED_STAGES);
+	}
+
+	// The filter memory lives in the arena, copy state with copyStateFrom
+	CirculateEffect(const CirculateEffect&) = delete;
+	CirculateEffect& operator=(const CirculateEffect&) = delete;
+
+	/// <summary>
+	/// Allocate the filter memory for up to numStages stages (Depth covers 0 to the limit). 
+	/// Allocates when the limit changes, so call it from setup rather than process. Memory is cleared.
+	/// </summary>
+	/// <param name="numStages"> 1 to MAX_NUM_STAGES</param>
+	void setStageLimit(int numStages) {
+		if (numStages < 1) numStages = 1;
+		if (numStages > MAX_NUM_STAGES) numStages = MAX_NUM_STAGES;
+
+		if (numStages == mStageLimit) {
+			return;
 		}
-	
-		this->Setup = Setup;
+		mStageLimit = numStages;
 
-		// Set pointer that is passed to filters, so they can directly read updated coefficients
-		pState = &FilterState;
-		for (int i = 0; i < MAX_NUM_STAGES; i++) {
-			// send to each allpass
-			AP[i].setStatePointer(pState);
+		Arena.allocate(AllpassBankState::getArenaBytes(numStages) + AllpassBankStateFloat::getArenaBytes(numStages) +
+			AllpassLaneState::getArenaBytes(numStages) + AllpassLaneStateFloat::getArenaBytes(numStages) +
+			CASCADE::StageCoefficients::getArenaBytes(numStages) + HELPERS::AlignedArena::getAlignedBytes(numStages * sizeof(double)));
 
+		Bank.attach(Arena, numStages);
+		BankFloat.attach(Arena, numStages);
+		LaneBank.attach(Arena, numStages);
+		LaneBankFloat.attach(Arena, numStages);
+		Stages.attach(Arena, numStages);
+		mStageRatio = Arena.take<double>(numStages);
+
+		// Start from no stages, the next run clears and adds the stages for the current depth
+		mNumActiveStages = 0;
+		mPreviousActiveStages = 0;
+		updateKernels();
+		mSpreadStages = -1;
+
+		if (LowBand) {
+			LowBand->setStageLimit(numStages);
 		}
+	}
+
+	int getStageLimit() const {
+		return mStageLimit;
+	}
+
+	/// <summary>
+	/// Run the cascade stages in another topology (CASCADE::Topologies), the same response at a
+	/// different cost and behaviour under modulation. The memory means something else in each,
+	/// so it is cleared. The spectral engine isn't affected
+	/// </summary>
+	void setTopology(int topology) {
+		if (topology < 0 || topology >= CASCADE::kNumTopologies) {
+			topology = CASCADE::kTopologySVF;
+		}
+		if (topology == mTopology) {
+			return;
+		}
+		mTopology = topology;
+		updateKernels();
+		mSpreadStages = -1;
+
+		Bank.resetState();
+		BankFloat.resetState();
+		LaneBank.resetState();
+		LaneBankFloat.resetState();
+		currentSample = 0.0f;
+		for (int l = 0; l < BANK_LANES; l++) {
+			laneLastSamples[l] = 0.0f;
+		}
+
+		if (LowBand) {
+			LowBand->setTopology(topology);
+		}
+	}
+
+	int getTopology() const {
+		return mTopology;
+	}
+
+	void setSampleRateBlockSize(HELPERS::SetupInfo Setup) {
+		this->Setup = Setup;
+
+		pState = &FilterState;
 
 		const double smoothTimeMs = 5;
 		// Set coefficient smooth time
@@ -32,6 +111,9 @@ public:
 		// This independent smoother smooths the result of the 
 		// note control after converting to Hz (not the note number)
 		NoteControlSmoother.setSmoothTime(25, Setup.sampleRate);
+
+		// Sidechain detector, fast enough to follow transients
+		SidechainEnvelope.setTimes(2, 60, Setup.sampleRate);
 		// Calculate max Hz for center frequency
 		// Defaulted to 18KHz, cut down for unusually low sample rates
 		double nyQuist = (Setup.sampleRate / 2.0f);
@@ -41,19 +123,350 @@ public:
 
 		mPreviousActiveStages = mNumActiveStages;
 
+		if (mIsLowBand) {
+			return;
+		}
+
+		// Allocates, the engine can then be switched while processing
+		Spectral.prepare();
+
+		// The low band runs in its own effect at the reduced rate, with its own parameters
+		// (filled from these for each block). Only high enough rates get one
+		int factor = BandSplitter::getFactorForRate(static_cast<int>(Setup.sampleRate));
+		if (factor > 1) {
+			HELPERS::SetupInfo LowSetup = Setup;
+			LowSetup.sampleRate = Setup.sampleRate / factor;
+			LowSetup.blockSize = PROCESS_CHUNK_SIZE / factor + 1;
+
+			LowBand = std::make_unique<CirculateEffect>();
+			LowBand->mIsLowBand = true;
+			LowBand->setStageLimit(mStageLimit);
+			LowBand->setTopology(mTopology);
+			LowBand->setSampleRateBlockSize(LowSetup);
+
+			LowParams = std::make_unique<CIRCULATE_PARAMS::AudioEffectParameters>(static_cast<int>(LowSetup.sampleRate));
+			LowBand->getParams(LowParams.get());
+
+			Splitter.prepare(factor, PROCESS_CHUNK_SIZE);
+		}
+		else {
+			LowBand.reset();
+			LowParams.reset();
+		}
+		mUseBandSplit = false;
 	}
 
 	void reset() {
-		for (int i = 0; i < MAX_NUM_STAGES; i++) {
-			// send to each allpass
-			AP[i].resetState();
-			if (pState) {
-				pState->force_snap = true;
-			}
+		Bank.resetState();
+		BankFloat.resetState();
+		if (pState) {
+			pState->force_snap = true;
 		}
 		currentSample = 0.0f;
-		
+
+		SidechainEnvelope.reset();
+		mModActive = false;
+		mModCounter = 0;
+
+		LaneBank.resetState();
+		LaneBankFloat.resetState();
+		for (int l = 0; l < BANK_LANES; l++) {
+			laneLastSamples[l] = 0.0f;
+		}
+		mLaneCounter = 0;
+
+		Spectral.reset();
+
+		if (LowBand) {
+			LowBand->reset();
+			Splitter.reset();
+		}
+	}
+	/// <summary>
+	/// Copy the processing state (filter memory, smoothers and feedback) of another effect,
+	/// so this one continues exactly as the other would. Used when one channel has been
+	/// standing in for both. Both effects must have the same stage limit and topology.
+	/// </summary>
+	/// <param name="Other"></param>
+	void copyStateFrom(const CirculateEffect& Other) {
+		mUseFloat = Other.mUseFloat;
+		if (mUseFloat) {
+			BankFloat.copyFrom(Other.BankFloat);
+		}
+		else {
+			Bank.copyFrom(Other.Bank);
+		}
+		FilterState = Other.FilterState;
+		NoteControlSmoother = Other.NoteControlSmoother;
+		SidechainEnvelope = Other.SidechainEnvelope;
+		currentSample = Other.currentSample;
+
+		mModActive = Other.mModActive;
+		mModCounter = Other.mModCounter;
+		mModG = Other.mModG;
+		mModGStep = Other.mModGStep;
+
+		mNumActiveStages = Other.mNumActiveStages;
+		mPreviousActiveStages = Other.mPreviousActiveStages;
+		pKernel = Other.pKernel;
+		pKernelFloat = Other.pKernelFloat;
+		pSpreadKernel = Other.pSpreadKernel;
+		pSpreadKernelFloat = Other.pSpreadKernelFloat;
+		pLaneKernel = Other.pLaneKernel;
+		pLaneKernelFloat = Other.pLaneKernelFloat;
+
+		Stages.copyFrom(Other.Stages);
+		for (int i = 0; i < mStageLimit; i++) {
+			mStageRatio[i] = Other.mStageRatio[i];
+		}
+		mSpreadShape = Other.mSpreadShape;
+		mSpreadStages = Other.mSpreadStages;
+		mSpreadOctaves = Other.mSpreadOctaves;
+		mSpreadCenterG = Other.mSpreadCenterG;
+
+		mChordActive = Other.mChordActive;
+		if (mChordActive) {
+			if (mUseFloat) {
+				LaneBankFloat.copyFrom(Other.LaneBankFloat);
+			}
+			else {
+				LaneBank.copyFrom(Other.LaneBank);
+			}
+			for (int l = 0; l < BANK_LANES; l++) {
+				laneLastSamples[l] = Other.laneLastSamples[l];
+				mLaneG[l] = Other.mLaneG[l];
+				mLaneGStep[l] = Other.mLaneGStep[l];
+			}
+			mLaneCounter = Other.mLaneCounter;
+		}
+
+		mUseSpectral = Other.mUseSpectral;
+		if (mUseSpectral) {
+			// Same sized buffers, so this copies without allocating
+			Spectral = Other.Spectral;
+		}
+
+		mUseBandSplit = Other.mUseBandSplit;
+		if (mUseBandSplit) {
+			LowBand->copyStateFrom(*Other.LowBand);
+			Splitter = Other.Splitter;
+		}
+	}
+
+	/// <summary>
+	/// Check if the filter memory of another effect is within tolerance of this one,
+	/// after which both produce the same output to within tolerance for the same input
+	/// </summary>
+	/// <param name="Other"></param>
+	/// <param name="tolerance"> max absolute difference of any memory value</param>
+	/// <returns></returns>
+	bool isStateCloseTo(const CirculateEffect& Other, double tolerance) const {
+		if (mNumActiveStages != Other.mNumActiveStages || mTopology != Other.mTopology) {
+			return false;
+		}
+		if (abs(currentSample - Other.currentSample) > tolerance) {
+			return false;
+		}
+		if (mChordActive != Other.mChordActive || mUseFloat != Other.mUseFloat) {
+			return false;
+		}
+		// The spectral engine's buffers aren't compared, channels that have diverged stay apart
+		if (mUseSpectral || Other.mUseSpectral) {
+			return false;
+		}
+		if (mUseBandSplit || Other.mUseBandSplit) {
+			return false;
+		}
+
+		if (mChordActive) {
+			for (int l = 0; l < BANK_LANES; l++) {
+				if (abs(laneLastSamples[l] - Other.laneLastSamples[l]) > tolerance) return false;
+			}
+		}
+
+		if (mUseFloat) {
+			return isMemoryClose(BankFloat, Other.BankFloat, LaneBankFloat, Other.LaneBankFloat, tolerance);
+		}
+		return isMemoryClose(Bank, Other.Bank, LaneBank, Other.LaneBank, tolerance);
+	}
+
+	/// <summary>
+	/// Bytes saveCheckpoint needs for the current state, which depends on the engine and the
+	/// number of active stages
+	/// </summary>
+	size_t getCheckpointSize() const {
+		CHECKPOINT::Writer Counter;
+		saveState(Counter);
+		return Counter.getSize();
+	}
+
+	/// <summary>
+	/// Save the processing state (filter memory, smoothers, feedback and modulation state) into
+	/// a buffer, see Checkpoint.h. Doesn't allocate
+	/// </summary>
+	/// <returns> bytes written, 0 if the buffer is too small</returns>
+	size_t saveCheckpoint(void* buffer, size_t capacity) const {
+		CHECKPOINT::Writer Out(buffer, capacity);
+		saveState(Out);
+		return Out.fits() ? Out.getSize() : 0;
+	}
+
+	/// <summary>
+	/// Continue from a checkpoint exactly as the effect that saved it would, given the same
+	/// parameters and input. Takes the stage limit of the checkpoint, which allocates if it
+	/// differs. Fails if the checkpoint is damaged or was saved at another sample rate, the
+	/// effect is then reset
+	/// </summary>
+	bool restoreCheckpoint(const void* buffer, size_t size) {
+		CHECKPOINT::Reader In(buffer, size);
+		if (restoreState(In) && In.isComplete()) {
+			return true;
+		}
+		reset();
+		return false;
 	}
+
+	/// <summary>
+	/// Write the state to a checkpoint: the scalars, then the memory of the engine in use
+	/// </summary>
+	void saveState(CHECKPOINT::Writer& Out) const {
+		CHECKPOINT::EffectState State;
+		State.sampleRate = Setup.sampleRate;
+		State.stageLimit = mStageLimit;
+		State.topology = mTopology;
+		State.numActiveStages = mNumActiveStages;
+		State.previousActiveStages = mPreviousActiveStages;
+		State.flags = (mUseFloat ? CHECKPOINT::kUseFloat : 0) | (mUseSpectral ? CHECKPOINT::kUseSpectral : 0) |
+			(mUseBandSplit ? CHECKPOINT::kUseBandSplit : 0) | (mChordActive ? CHECKPOINT::kChordActive : 0) |
+			(mModActive ? CHECKPOINT::kModActive : 0) | (FilterState.force_snap ? CHECKPOINT::kForceSnap : 0);
+
+		State.k = FilterState.k;
+		State.g = FilterState.g;
+		State.kTarget = FilterState.k_target;
+		State.gTarget = FilterState.g_target;
+		State.noteSmoother = NoteControlSmoother.getLastValue();
+		State.sidechainEnvelope = SidechainEnvelope.getLastValue();
+
+		State.modG = mModG;
+		State.modGStep = mModGStep;
+		State.modCounter = mModCounter;
+		for (int l = 0; l < BANK_LANES; l++) {
+			State.laneG[l] = mLaneG[l];
+			State.laneGStep[l] = mLaneGStep[l];
+			State.laneLastSamples[l] = laneLastSamples[l];
+		}
+		State.laneCounter = mLaneCounter;
+		State.currentSample = currentSample;
+
+		Out.write(State);
+
+		if (mUseSpectral) {
+			Spectral.saveState(Out);
+		}
+		else if (mUseBandSplit) {
+			Splitter.saveState(Out);
+			LowBand->saveState(Out);
+		}
+		else if (mChordActive) {
+			if (mUseFloat) {
+				Out.write(LaneBankFloat.s1, mNumActiveStages);
+				Out.write(LaneBankFloat.s2, mNumActiveStages);
+			}
+			else {
+				Out.write(LaneBank.s1, mNumActiveStages);
+				Out.write(LaneBank.s2, mNumActiveStages);
+			}
+		}
+		else {
+			if (mUseFloat) {
+				Out.write(BankFloat.s1, mNumActiveStages);
+				Out.write(BankFloat.s2, mNumActiveStages);
+			}
+			else {
+				Out.write(Bank.s1, mNumActiveStages);
+				Out.write(Bank.s2, mNumActiveStages);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Read a checkpoint written by saveState. The kernels follow the stage count, the spread
+	/// coefficients are recalculated on the next run. On failure the state is partly restored,
+	/// reset before processing
+	/// </summary>
+	bool restoreState(CHECKPOINT::Reader& In) {
+		CHECKPOINT::EffectState State;
+		if (!In.read(State)) {
+			return false;
+		}
+		if (State.magic != CHECKPOINT_MAGIC || State.version != CHECKPOINT_VERSION || State.sampleRate != Setup.sampleRate) {
+			return false;
+		}
+		if (State.stageLimit < 1 || State.stageLimit > MAX_NUM_STAGES ||
+			State.numActiveStages < 0 || State.numActiveStages > State.stageLimit ||
+			State.previousActiveStages < 0 || State.previousActiveStages > State.stageLimit ||
+			State.topology >= CASCADE::kNumTopologies) {
+			return false;
+		}
+		if ((State.flags & CHECKPOINT::kUseBandSplit) && !LowBand) {
+			return false;
+		}
+
+		setStageLimit(State.stageLimit);
+		setTopology(static_cast<int>(State.topology));
+		reset();
+
+		mUseFloat = (State.flags & CHECKPOINT::kUseFloat) != 0;
+		mUseSpectral = (State.flags & CHECKPOINT::kUseSpectral) != 0;
+		mUseBandSplit = (State.flags & CHECKPOINT::kUseBandSplit) != 0;
+		mChordActive = (State.flags & CHECKPOINT::kChordActive) != 0;
+		mModActive = (State.flags & CHECKPOINT::kModActive) != 0;
+
+		FilterState.k = State.k;
+		FilterState.g = State.g;
+		FilterState.k_target = State.kTarget;
+		FilterState.g_target = State.gTarget;
+		FilterState.force_snap = (State.flags & CHECKPOINT::kForceSnap) != 0;
+		NoteControlSmoother.setLastValue(State.noteSmoother);
+		SidechainEnvelope.setLastValue(State.sidechainEnvelope);
+
+		mModG = State.modG;
+		mModGStep = State.modGStep;
+		mModCounter = State.modCounter;
+		for (int l = 0; l < BANK_LANES; l++) {
+			mLaneG[l] = State.laneG[l];
+			mLaneGStep[l] = State.laneGStep[l];
+			laneLastSamples[l] = State.laneLastSamples[l];
+		}
+		mLaneCounter = State.laneCounter;
+		currentSample = State.currentSample;
+
+		mNumActiveStages = State.numActiveStages;
+		mPreviousActiveStages = State.previousActiveStages;
+		updateKernels();
+		mSpreadShape = -1;
+		mSpreadStages = -1;
+		mSpreadOctaves = -1.0;
+		mSpreadCenterG = -1.0;
+
+		if (mUseSpectral) {
+			return Spectral.restoreState(In);
+		}
+		if (mUseBandSplit) {
+			return Splitter.restoreState(In) && LowBand->restoreState(In);
+		}
+		if (mChordActive) {
+			if (mUseFloat) {
+				return In.read(LaneBankFloat.s1, mNumActiveStages) && In.read(LaneBankFloat.s2, mNumActiveStages);
+			}
+			return In.read(LaneBank.s1, mNumActiveStages) && In.read(LaneBank.s2, mNumActiveStages);
+		}
+		if (mUseFloat) {
+			return In.read(BankFloat.s1, mNumActiveStages) && In.read(BankFloat.s2, mNumActiveStages);
+		}
+		return In.read(Bank.s1, mNumActiveStages) && In.read(Bank.s2, mNumActiveStages);
+	}
+
 	/// <summary>
 	/// Set pointer used to access host/plugin parameters
 	/// </summary>
@@ -76,44 +489,325 @@ public:
 			mUseHzControl = true;
 		}
 
+		updatePrecision();
+		updateChordMode();
+		updateEngine();
+		updateBandSplit();
+	}
+
+	/// <summary>
+	/// Latency of the selected engine and band split, in samples. Read from the parameters, so
+	/// it is up to date before the next block is processed
+	/// </summary>
+	int getLatency() const {
+		if (!pParams) {
+			return 0;
+		}
+		if (pParams->Engine.getLastValue() >= 0.5) {
+			return SpectralDispersion::getLatency();
+		}
+		if (LowBand && pParams->BandSplit.getLastValue() >= 0.5) {
+			return Splitter.getLatency();
+		}
+		return 0;
+	}
+
+	/// <summary>
+	/// Set the MIDI notes currently held, used as bank centers in the held notes chord mode
+	/// </summary>
+	/// <param name="notes"> note numbers</param>
+	/// <param name="count"> number of notes, only the first BANK_LANES are used</param>
+	void setHeldNotes(const int* notes, int count) {
+		if (count > BANK_LANES) {
+			count = BANK_LANES;
+		}
+		for (int i = 0; i < count; i++) {
+			mHeldNoteHz[i] = HELPERS::noteNumToHz(notes[i]);
+		}
+		mNumHeldNotes = count;
+
+		if (LowBand) {
+			LowBand->setHeldNotes(notes, count);
+		}
 	}
 
-	void getBlock(float* inBuffer, float* outBuffer, int numSamples) {
+	/// <summary>
+	/// Process a block
+	/// </summary>
+	/// <param name="inBuffer"></param>
+	/// <param name="outBuffer"></param>
+	/// <param name="numSamples"></param>
+	/// <param name="sidechainBuffer"> Optional sidechain input, its envelope modulates the center frequency</param>
+	void getBlock(float* inBuffer, float* outBuffer, int numSamples, const float* sidechainBuffer = nullptr) {
 		updateParams();
 
 		if (!inBuffer) {
 			return;
 		}
 
-		// Apply each allpass stage in series
-		// Coefficients are only calculated once for all stages, and stored in FilterState
-		// Allpass filters have a member pointer to this, so read the updated values directly
-			
-		for (int s = 0; s < numSamples; s++) {
+		if (mUseSpectral) {
+			getBlockSpectral(inBuffer, outBuffer, numSamples);
+			return;
+		}
+
+		if (mUseBandSplit) {
+			getBlockBandSplit(inBuffer, outBuffer, numSamples, sidechainBuffer);
+			return;
+		}
+
+		// Split the block into runs with a constant number of stages. Per sample values are 
+		// calculated into the control block first, then the kernel specialised for the current 
+		// stage count processes the whole run. 
+		// The control block lives on the stack so it isn't part of every instance's footprint
+		CASCADE::ControlBlock Control;
+
+		if (mChordActive) {
+			// Parallel banks, one per lane
+			CASCADE::LaneCoefficients Lanes;
+			for (int l = 0; l < BANK_LANES; l++) {
+				Lanes.weight[l] = (l < mNumBanks) ? 1.0 / mNumBanks : 0.0;
+			}
+
+			int s = 0;
+			while (s < numSamples) {
+				int runLength = fillControlBlock(Control, s, numSamples - s, sidechainBuffer, &Lanes);
+
+				{
+					CIRCULATE_TRACE_SCOPE("cascade");
+					if (mUseFloat) {
+						pLaneKernelFloat(inBuffer + s, outBuffer + s, runLength, mNumActiveStages, Control, Lanes, laneLastSamples, LaneBankFloat);
+					}
+					else {
+						pLaneKernel(inBuffer + s, outBuffer + s, runLength, mNumActiveStages, Control, Lanes, laneLastSamples, LaneBank);
+					}
+				}
+
+				s += runLength;
+			}
+			return;
+		}
+
+		int s = 0;
+		while (s < numSamples) {
+			double spreadOctaves = pParams->Spread.getSampleAccurateValue(s) * MAX_SPREAD_OCTAVES;
+
+			if (spreadOctaves > 0.0) {
+				// Stage centers are spread, the per stage coefficients are held for short runs
+				int runLength = fillControlBlock(Control, s, std::min(numSamples - s, SPREAD_CONTROL_INTERVAL), sidechainBuffer);
+				updateStageCoefficients(Control, runLength - 1, spreadOctaves);
+
+				{
+					CIRCULATE_TRACE_SCOPE("cascade");
+					if (mUseFloat) {
+						currentSample = pSpreadKernelFloat(inBuffer + s, outBuffer + s, runLength, Control, Stages, currentSample, BankFloat);
+					}
+					else {
+						currentSample = pSpreadKernel(inBuffer + s, outBuffer + s, runLength, Control, Stages, currentSample, Bank);
+					}
+				}
+
+				s += runLength;
+				continue;
+			}
+
+			int runLength = fillControlBlock(Control, s, numSamples - s, sidechainBuffer);
+
+			{
+				// Feedback and the safety limiter are part of the kernel
+				CIRCULATE_TRACE_SCOPE("cascade");
+				if (mUseFloat) {
+					currentSample = pKernelFloat(inBuffer + s, outBuffer + s, runLength, Control, currentSample, BankFloat);
+				}
+				else {
+					currentSample = pKernel(inBuffer + s, outBuffer + s, runLength, Control, currentSample, Bank);
+				}
+			}
+
+			s += runLength;
+		}
+
+	}
+private:
+	/// Filter memory and per stage coefficients, sized for mStageLimit stages
+	HELPERS::AlignedArena Arena;
+	int mStageLimit = 0;
+
+	/// Memory of every stage
+	AllpassBankState Bank;
+	/// Memory of every stage at 32 bit precision, used instead of Bank when mUseFloat is set
+	AllpassBankStateFloat BankFloat;
+	bool mUseFloat = false;
+
+	/// Spectral engine, used instead of the cascade when mUseSpectral is set
+	SpectralDispersion Spectral;
+	bool mUseSpectral = false;
+
+	/// Low band effect at the decimated rate and its parameters, used when mUseBandSplit is set.
+	/// Only created at rates BandSplitter splits, never for a low band itself
+	std::unique_ptr<CirculateEffect> LowBand;
+	std::unique_ptr<CIRCULATE_PARAMS::AudioEffectParameters> LowParams;
+	BandSplitter Splitter;
+	bool mIsLowBand = false;
+	bool mUseBandSplit = false;
+
+	CIRCULATE_PARAMS::AudioEffectParameters* pParams = nullptr;
+	AllpassFilter::AllpassInfo FilterState;
+
+	/// Local pointer to access global allpass state
+	AllpassFilter::AllpassInfo* pState = nullptr;
+	HELPERS::SetupInfo Setup;
+
+	double mCenterHz = DEFAULT_CENTER;
+	double mFocus = DEFAULT_FOCUS;
+	double mNoteNumHz = 0;
+	double mNoteOffsetHz = 0;
+	int	mNumActiveStages = DEFAULT_DEPTH * UNROLLED_STAGES;
+	int mPreviousActiveStages = DEFAULT_DEPTH * UNROLLED_STAGES;
+	bool mUseHzControl = true;
+	double maxAllowedFreq = 0;
+	float currentSample = 0;
+
+	HELPERS::ValueSmoother NoteControlSmoother;
+
+	// Audio rate center modulation from the sidechain
+	HELPERS::EnvelopeFollower SidechainEnvelope;
+	bool mModActive = false;
+	int mModCounter = 0;
+	double mModG = 0;
+	double mModGStep = 0;
+
+	// Chord mode, parallel banks in lanes
+	AllpassLaneState LaneBank;
+	AllpassLaneStateFloat LaneBankFloat;
+	float laneLastSamples[BANK_LANES] = {};
+	bool mChordActive = false;
+	bool mUseHeldNotes = false;
+	int mNumBanks = 1;
+	double mLaneRatio[BANK_LANES] = { 1.0, 1.0, 1.0, 1.0 };
+	double mHeldNoteHz[BANK_LANES] = {};
+	int mNumHeldNotes = 0;
+	int mLaneCounter = 0;
+	double mLaneG[BANK_LANES] = {};
+	double mLaneGStep[BANK_LANES] = {};
+
+	/// Cascade kernels for mNumActiveStages, updated when the stage count changes
+	CASCADE::KernelFunction<AllpassBankState> pKernel = CASCADE::getKernel<AllpassBankState>(static_cast<int>(DEFAULT_DEPTH * UNROLLED_STAGES));
+	CASCADE::KernelFunction<AllpassBankStateFloat> pKernelFloat = CASCADE::getKernel<AllpassBankStateFloat>(static_cast<int>(DEFAULT_DEPTH * UNROLLED_STAGES));
+	CASCADE::SpreadKernelFunction<AllpassBankState> pSpreadKernel = CASCADE::getSpreadKernel<AllpassBankState>(static_cast<int>(DEFAULT_DEPTH * UNROLLED_STAGES));
+	CASCADE::SpreadKernelFunction<AllpassBankStateFloat> pSpreadKernelFloat = CASCADE::getSpreadKernel<AllpassBankStateFloat>(static_cast<int>(DEFAULT_DEPTH * UNROLLED_STAGES));
+	CASCADE::LaneKernelFunction<AllpassLaneState> pLaneKernel = CASCADE::getLaneKernel<AllpassLaneState>();
+	CASCADE::LaneKernelFunction<AllpassLaneStateFloat> pLaneKernelFloat = CASCADE::getLaneKernel<AllpassLaneStateFloat>();
+	/// Stage topology of every kernel (CASCADE::Topologies)
+	int mTopology = CASCADE::kTopologySVF;
+
+	// Spread stage centers. Ratios to the center depend on the shape, width and stage count,
+	// the coefficients on the center and R as well, each is recalculated only when its inputs change
+	CASCADE::StageCoefficients Stages;
+	double* mStageRatio = nullptr;
+	int mSpreadShape = -1;
+	int mSpreadStages = -1;
+	double mSpreadOctaves = -1.0;
+	double mSpreadCenterG = -1.0;
+
+	/// <summary>
+	/// Point the kernels at the current stage count and topology
+	/// </summary>
+	void updateKernels() {
+		pKernel = CASCADE::getKernel<AllpassBankState>(mNumActiveStages, mTopology);
+		pKernelFloat = CASCADE::getKernel<AllpassBankStateFloat>(mNumActiveStages, mTopology);
+		pSpreadKernel = CASCADE::getSpreadKernel<AllpassBankState>(mNumActiveStages, mTopology);
+		pSpreadKernelFloat = CASCADE::getSpreadKernel<AllpassBankStateFloat>(mNumActiveStages, mTopology);
+		pLaneKernel = CASCADE::getLaneKernel<AllpassLaneState>(mTopology);
+		pLaneKernelFloat = CASCADE::getLaneKernel<AllpassLaneStateFloat>(mTopology);
+	}
+
+	/// <summary>
+	/// Fetches the per sample parameters, from startIndex, and calculates the values used by the
+	/// cascade kernel. Stops early if the number of stages changes, so that every sample in
+	/// the run uses the same kernel.
+	/// </summary>
+	/// <param name="startIndex"> sample index of the start of the run</param>
+	/// <param name="numSamples"> samples left in the block</param>
+	/// <param name="sidechainBuffer"> optional sidechain, indexed with the block sample index</param>
+	/// <param name="Lanes"> per lane coefficients, filled instead of Control g and d in chord mode</param>
+	/// <returns> number of samples filled</returns>
+	int fillControlBlock(CASCADE::ControlBlock& Control, int startIndex, int numSamples, const float* sidechainBuffer, CASCADE::LaneCoefficients* Lanes = nullptr) {
+		CIRCULATE_TRACE_SCOPE("coefficients");
+
+		if (numSamples > CONTROL_BLOCK_SIZE) {
+			numSamples = CONTROL_BLOCK_SIZE;
+		}
+
+		for (int i = 0; i < numSamples; i++) {
+			int s = startIndex + i;
 
 			// Get num stages (+0.5 for crude rounding)
-			mPreviousActiveStages = mNumActiveStages;
-			mNumActiveStages = static_cast<int>(pParams->Depth.getSampleAccurateValue(s) * MAX_NUM_STAGES + 0.5);
-			// if we've added more stages, clear the state of those new filters.
-			if (mNumActiveStages > mPreviousActiveStages) {
-				
-				for (int f = mPreviousActiveStages; f < mNumActiveStages; f++) {
-					AP[f].resetState();
+			int numStages = static_cast<int>(pParams->Depth.getSampleAccurateValue(s) * mStageLimit + 0.5);
+
+			if (numStages != mNumActiveStages) {
+				// Finish the run here, the next run starts with the new stage count
+				if (i > 0) {
+					Control.numStages = mNumActiveStages;
+					return i;
+				}
+
+				mPreviousActiveStages = mNumActiveStages;
+				mNumActiveStages = numStages;
+				updateKernels();
+
+				// if we've added more stages, clear the state of those new filters.
+				if (mNumActiveStages > mPreviousActiveStages) {
+					Bank.resetState(mPreviousActiveStages, mNumActiveStages);
+					BankFloat.resetState(mPreviousActiveStages, mNumActiveStages);
+					LaneBank.resetState(mPreviousActiveStages, mNumActiveStages);
+					LaneBankFloat.resetState(mPreviousActiveStages, mNumActiveStages);
 				}
 			}
 
 			// Get Frequency
 			mCenterHz = updateFrequency(s);
-		
+
 			// Get Q
 			mFocus = pParams->Focus.getSampleAccurateValue(s);
 
 			// Apply curve to Q, for more precision with lower values, where there is more timbre variation
 			mFocus = mFocus * mFocus * mFocus;
-			
-			// Only need to calculate coefficients once...allpasses already have a member pointer to FilterState 
-			// (set in setSampleRateBlockSize)
-			AllpassFilter::calculateCoefficients(mCenterHz, mFocus, Setup.sampleRate, FilterState);
+
+			// Sidechain modulation, in octaves
+			double modOctaves = 0;
+			if (sidechainBuffer) {
+				double envelope = SidechainEnvelope.getNext(sidechainBuffer[s]);
+				double amount = (2.0 * pParams->Sidechain.getSampleAccurateValue(s)) - 1.0;
+				modOctaves = amount * MAX_SIDECHAIN_OCTAVES * envelope;
+			}
+
+			if (Lanes) {
+				// Lane 0 also drives FilterState, so that k is smoothed as usual and g is
+				// continuous when leaving chord mode
+				updateLaneG(s, modOctaves);
+				AllpassFilter::calculateCoefficientsWithG(mLaneG[0], mFocus, FilterState);
+
+				double R = FilterState.k;
+				for (int l = 0; l < BANK_LANES; l++) {
+					double g = mLaneG[l];
+					Lanes->g[i][l] = g;
+					Lanes->d[i][l] = 1.0 / (1.0 + 2 * R * g + (g * g));
+				}
+			}
+			// Only need to calculate coefficients once, they are shared by all stages
+			else if (modOctaves != 0.0) {
+				AllpassFilter::calculateCoefficientsWithG(getModulatedG(modOctaves), mFocus, FilterState);
+			}
+			else {
+				mModActive = false;
+				AllpassFilter::calculateCoefficients(mCenterHz, mFocus, Setup.sampleRate, FilterState);
+			}
+
+			double g = FilterState.g;
+			double R = FilterState.k;
+			Control.g[i] = g;
+			Control.R[i] = R;
+			Control.d[i] = 1.0 / (1.0 + 2 * R * g + (g * g));
 
 			// Scale feedback parameter, 
 			double feedback = pParams->Feedback.getSampleAccurateValue(s);
@@ -130,54 +824,389 @@ public:
 				feedback = 0;
 			}
 
-			// Safety limit feedback
-			currentSample = getLimitedSample(currentSample);
-			// Add feedback
-			currentSample = inBuffer[s] + (feedback * currentSample);
-
+			Control.feedback[i] = feedback;
 			// Gain compensation
-			currentSample *= sqrtf(1.0f - (abs(feedback) / 1.5f)   );
+			Control.gain[i] = sqrtf(1.0f - (abs(feedback) / 1.5f));
+		}
+
+		Control.numStages = mNumActiveStages;
+		return numSamples;
+	}
+
+	/// <summary>
+	/// g for the modulated center frequency. The target is evaluated every MOD_CONTROL_INTERVAL 
+	/// samples, with fast approximations of 2^x and tan, and g is linearly interpolated towards it 
+	/// in between. This bounds the cost of audio rate modulation to a multiply add per sample, 
+	/// plus one evaluation per interval.
+	/// </summary>
+	/// <param name="modOctaves"> offset from mCenterHz in octaves</param>
+	/// <returns></returns>
+	double getModulatedG(double modOctaves) {
+		if (!mModActive) {
+			// Start from the current (smoothed) coefficient so there is no jump
+			mModActive = true;
+			mModG = FilterState.g;
+			mModCounter = 0;
+		}
+
+		if (mModCounter == 0) {
+			double freqHz = mCenterHz * HELPERS::fastExp2(modOctaves);
+
+			if (freqHz > maxAllowedFreq) {
+				freqHz = maxAllowedFreq;
+			}
+			if (freqHz < MIN_FREQ_HZ) {
+				freqHz = MIN_FREQ_HZ;
+			}
+
+			double gTarget = HELPERS::fastTan((E_PI * freqHz) / (double)Setup.sampleRate);
+
+			if (FilterState.force_snap) {
+				mModG = gTarget;
+			}
+
+			mModGStep = (gTarget - mModG) / MOD_CONTROL_INTERVAL;
+			mModCounter = MOD_CONTROL_INTERVAL;
+		}
+
+		mModG += mModGStep;
+		mModCounter--;
+
+		return mModG;
+	}
+
+	/// <summary>
+	/// Set the coefficients of every active stage for a spread run, from the center g and R of
+	/// the given control block sample (so smoothing and sidechain modulation carry over).
+	/// Stage centers are the center times a ratio per stage:
+	/// Log, evenly spaced in octaves over the spread, centered on the center.
+	/// Linear, evenly spaced in Hz between the same two limits.
+	/// Random, a fixed random position in the spread for each stage.
+	/// </summary>
+	/// <param name="index"> sample of the control block to take the center from</param>
+	/// <param name="octaves"> width of the spread</param>
+	void updateStageCoefficients(const CASCADE::ControlBlock& Control, int index, double octaves) {
+		int shape = CIRCULATE_PARAMS::getSpreadShape(pParams->SpreadShape.getLastValue());
+
+		bool ratiosChanged = shape != mSpreadShape || octaves != mSpreadOctaves || mNumActiveStages != mSpreadStages;
+		if (ratiosChanged) {
+			mSpreadShape = shape;
+			mSpreadOctaves = octaves;
+			mSpreadStages = mNumActiveStages;
+
+			double low = HELPERS::fastExp2(-0.5 * octaves);
+			double high = HELPERS::fastExp2(0.5 * octaves);
 
-			
 			for (int i = 0; i < mNumActiveStages; i++) {
-				// Apply each allpass
+				double position = CIRCULATE_PARAMS::getSpreadPosition(shape, i, mNumActiveStages);
 
+				if (shape == CIRCULATE_PARAMS::kSpreadLinear) {
+					mStageRatio[i] = low + (high - low) * (position + 0.5);
+				}
+				else {
+					mStageRatio[i] = HELPERS::fastExp2(position * octaves);
+				}
+			}
+		}
+
+		double g = Control.g[index];
+		double R = Control.R[index];
 
-				currentSample = AP[i].getNext(currentSample);
-			
+		if (!ratiosChanged && g == mSpreadCenterG && R == Stages.R) {
+			return;
+		}
+
+		mSpreadCenterG = g;
+		Stages.R = R;
+
+		double centerHz = atan(g) * Setup.sampleRate / E_PI;
+
+		for (int i = 0; i < mNumActiveStages; i++) {
+			double freqHz = centerHz * mStageRatio[i];
+
+			if (freqHz > maxAllowedFreq) {
+				freqHz = maxAllowedFreq;
+			}
+			if (freqHz < MIN_FREQ_HZ) {
+				freqHz = MIN_FREQ_HZ;
 			}
 
-			// Safety limiter, kicks in only above threshold (abs > 0.99)
-			// We safety limit to cover edge cases in extremely fast parameter changes
-			// These can cause transient overs due to the old filter state, these overs propagate 
-			// and are amplified by multiple stages. This limiter prevents these overs.
-			currentSample = getLimitedSample(currentSample);
-			outBuffer[s] = currentSample;
+			double stageG = HELPERS::fastTan((E_PI * freqHz) / (double)Setup.sampleRate);
+			Stages.g[i] = stageG;
+			Stages.d[i] = 1.0 / (1.0 + 2 * R * stageG + (stageG * stageG));
+		}
+
+		// Once per change rather than per sample
+		CASCADE::convertStages(Stages, mNumActiveStages, mTopology);
+	}
+
+	/// <summary>
+	/// Read the engine setting (per block). The engine switched to starts from cleared memory
+	/// </summary>
+	void updateEngine() {
+		bool useSpectral = pParams->Engine.getLastValue() >= 0.5;
 
+		if (useSpectral && !mUseSpectral) {
+			Spectral.reset();
+		}
+		if (!useSpectral && mUseSpectral) {
+			Bank.resetState();
+			BankFloat.resetState();
+			LaneBank.resetState();
+			LaneBankFloat.resetState();
+			currentSample = 0.0f;
+			for (int l = 0; l < BANK_LANES; l++) {
+				laneLastSamples[l] = 0.0f;
+			}
 		}
 
+		mUseSpectral = useSpectral;
 	}
-private:
-	AllpassFilter AP[MAX_NUM_STAGES];
 
-	CIRCULATE_PARAMS::AudioEffectParameters* pParams = nullptr;
-	AllpassFilter::AllpassInfo FilterState;
+	/// <summary>
+	/// Process a block with the spectral engine. Center and focus are followed every sample, as
+	/// in the cascade, so smoothing runs at the same rate. The response takes the values at the
+	/// end of each run, which is where the next frame is processed.
+	/// Depth covers 0 to SPECTRAL_MAX_STAGES stages, without rounding.
+	/// </summary>
+	void getBlockSpectral(float* inBuffer, float* outBuffer, int numSamples) {
+		int s = 0;
+		while (s < numSamples) {
+			int runLength = numSamples - s;
+			if (runLength > Spectral.getSamplesToNextFrame()) {
+				runLength = Spectral.getSamplesToNextFrame();
+			}
 
-	/// Local pointer to access global allpass state
-	AllpassFilter::AllpassInfo* pState = nullptr;
-	HELPERS::SetupInfo Setup;
+			{
+				CIRCULATE_TRACE_SCOPE("coefficients");
+				for (int i = s; i < s + runLength; i++) {
+					mCenterHz = updateFrequency(i);
 
-	double mCenterHz = DEFAULT_CENTER;
-	double mFocus = DEFAULT_FOCUS;
-	double mNoteNumHz = 0;
-	double mNoteOffsetHz = 0;
-	int	mNumActiveStages = DEFAULT_DEPTH * MAX_NUM_STAGES;
-	int mPreviousActiveStages = DEFAULT_DEPTH * MAX_NUM_STAGES;
-	bool mUseHzControl = true;
-	double maxAllowedFreq = 0;
-	float currentSample = 0;
+					mFocus = pParams->Focus.getSampleAccurateValue(i);
+					mFocus = mFocus * mFocus * mFocus;
 
-	HELPERS::ValueSmoother NoteControlSmoother;
+					AllpassFilter::calculateCoefficients(mCenterHz, mFocus, Setup.sampleRate, FilterState);
+				}
+			}
+
+			double numStages = pParams->Depth.getSampleAccurateValue(s + runLength - 1) * SPECTRAL_MAX_STAGES;
+			Spectral.setResponse(FilterState.g, FilterState.k, numStages);
+
+			{
+				CIRCULATE_TRACE_SCOPE("spectral");
+				Spectral.process(inBuffer + s, outBuffer + s, runLength);
+			}
+
+			s += runLength;
+		}
+	}
+
+	/// <summary>
+	/// Read the band split setting (per block). Band split only applies to the cascade, the path
+	/// switched to starts from cleared memory
+	/// </summary>
+	void updateBandSplit() {
+		bool useBandSplit = LowBand && !mUseSpectral && pParams->BandSplit.getLastValue() >= 0.5;
+
+		if (useBandSplit && !mUseBandSplit) {
+			LowBand->reset();
+			Splitter.reset();
+		}
+		if (!useBandSplit && mUseBandSplit) {
+			Bank.resetState();
+			BankFloat.resetState();
+			LaneBank.resetState();
+			LaneBankFloat.resetState();
+			currentSample = 0.0f;
+			for (int l = 0; l < BANK_LANES; l++) {
+				laneLastSamples[l] = 0.0f;
+			}
+		}
+
+		mUseBandSplit = useBandSplit;
+	}
+
+	/// <summary>
+	/// Process a block with the cascade on the decimated low band. The low band effect gets the
+	/// parameter values at the samples its low band samples were taken at, with the center
+	/// converted to its own range so it is the same frequency in Hz. Above the low band (about
+	/// 0.4 of the reduced rate) the input passes through, delayed by the split
+	/// </summary>
+	void getBlockBandSplit(float* inBuffer, float* outBuffer, int numSamples, const float* sidechainBuffer) {
+		// On the stack, as the control block, so they aren't part of every instance
+		float low[PROCESS_CHUNK_SIZE + 1];
+		float processed[PROCESS_CHUNK_SIZE + 1];
+		float lowSidechain[PROCESS_CHUNK_SIZE + 1];
+		int lowIndex[PROCESS_CHUNK_SIZE + 1];
+
+		int numLow = 0;
+		{
+			CIRCULATE_TRACE_SCOPE("band split");
+			numLow = Splitter.split(inBuffer, numSamples, low, lowIndex, sidechainBuffer, sidechainBuffer ? lowSidechain : nullptr);
+		}
+
+		if (numLow > 0) {
+			// Parameters are already smoothed at the full rate, so the values are taken as they are
+			for (size_t p = 0; p < pParams->ParameterList.size(); p++) {
+				CIRCULATE_PARAMS::ParamUnit* Outer = pParams->ParameterList[p];
+				CIRCULATE_PARAMS::ParamUnit* Inner = LowParams->ParameterList[p];
+
+				Inner->setCurrentBlockSize(numLow);
+				for (int j = 0; j < numLow; j++) {
+					Inner->BlockValues[j] = Outer->BlockValues[lowIndex[j]];
+				}
+				Inner->lastExplicit = Outer->lastExplicit;
+			}
+
+			// The low band never splits again or switches engine
+			LowParams->Engine.lastExplicit = 0.0;
+			LowParams->BandSplit.lastExplicit = 0.0;
+
+			// Same center in Hz. Centers above the low band's range are held at its top
+			double range = log(maxAllowedFreq / MIN_FREQ_HZ) / log(LowBand->maxAllowedFreq / MIN_FREQ_HZ);
+			for (int j = 0; j < numLow; j++) {
+				double center = LowParams->Center.BlockValues[j] * range;
+				LowParams->Center.BlockValues[j] = std::min(center, 1.0);
+			}
+
+			LowBand->getBlock(low, processed, numLow, sidechainBuffer ? lowSidechain : nullptr);
+		}
+
+		CIRCULATE_TRACE_SCOPE("band split");
+		Splitter.merge(low, processed, lowIndex, numLow, outBuffer, numSamples);
+	}
+
+	/// <summary>
+	/// Read the precision setting (per block), and convert the filter memory when it changes
+	/// </summary>
+	void updatePrecision() {
+		bool useFloat = pParams->Precision.getLastValue() >= 0.5;
+
+		if (useFloat && !mUseFloat) {
+			BankFloat.copyFrom(Bank);
+			LaneBankFloat.copyFrom(LaneBank);
+		}
+		if (!useFloat && mUseFloat) {
+			BankFloat.copyTo(Bank);
+			LaneBankFloat.copyTo(LaneBank);
+		}
+
+		mUseFloat = useFloat;
+	}
+
+	/// <summary>
+	/// Compare the memory of the active stages, of the single bank or of every lane in chord mode
+	/// </summary>
+	template <typename BankType, typename LaneType>
+	bool isMemoryClose(const BankType& A, const BankType& B, const LaneType& LanesA, const LaneType& LanesB, double tolerance) const {
+		for (int i = 0; i < mNumActiveStages; i++) {
+			if (mChordActive) {
+				for (int l = 0; l < BANK_LANES; l++) {
+					if (abs(LanesA.s1[i][l] - LanesB.s1[i][l]) > tolerance) return false;
+					if (abs(LanesA.s2[i][l] - LanesB.s2[i][l]) > tolerance) return false;
+				}
+			}
+			else {
+				if (abs(A.s1[i] - B.s1[i]) > tolerance) return false;
+				if (abs(A.s2[i] - B.s2[i]) > tolerance) return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Read the chord mode (per block), set up the bank centers and move filter memory
+	/// between the single bank and the lanes when chord mode is switched
+	/// </summary>
+	void updateChordMode() {
+		int mode = CIRCULATE_PARAMS::getChordMode(pParams->Chord.getLastValue());
+
+		bool chord = mode != CIRCULATE_PARAMS::kChordOff;
+
+		mUseHeldNotes = (mode == CIRCULATE_PARAMS::kChordHeldNotes) && (mNumHeldNotes > 0);
+		mNumBanks = mUseHeldNotes ? mNumHeldNotes : CIRCULATE_PARAMS::chordSizes[mode];
+
+		for (int l = 0; l < BANK_LANES; l++) {
+			mLaneRatio[l] = (l < mNumBanks) ? pow(2.0, CIRCULATE_PARAMS::chordIntervals[mode][l] / 12.0) : 1.0;
+		}
+
+		if (chord && !mChordActive) {
+			// Every lane continues from the single bank
+			if (mUseFloat) {
+				LaneBankFloat.copyFromBank(BankFloat);
+			}
+			else {
+				LaneBank.copyFromBank(Bank);
+			}
+			for (int l = 0; l < BANK_LANES; l++) {
+				laneLastSamples[l] = currentSample;
+				mLaneG[l] = FilterState.g;
+			}
+			mLaneCounter = 0;
+		}
+		if (!chord && mChordActive) {
+			// Continue from the first (root) bank
+			if (mUseFloat) {
+				LaneBankFloat.copyToBank(BankFloat, 0);
+			}
+			else {
+				LaneBank.copyToBank(Bank, 0);
+			}
+			currentSample = laneLastSamples[0];
+			mModActive = false;
+		}
+
+		mChordActive = chord;
+	}
+
+	/// <summary>
+	/// Update the g of every lane for this sample. As with getModulatedG the targets are evaluated
+	/// every MOD_CONTROL_INTERVAL samples with the fast approximations and interpolated in between,
+	/// so the extra banks don't each need a tan per sample
+	/// </summary>
+	/// <param name="s"> sample index</param>
+	/// <param name="modOctaves"> sidechain modulation in octaves</param>
+	void updateLaneG(int s, double modOctaves) {
+		if (mLaneCounter == 0) {
+			double modRatio = (modOctaves != 0.0) ? HELPERS::fastExp2(modOctaves) : 1.0;
+
+			// Held notes can still be detuned with the note offset
+			double offsetRatio = 1.0;
+			if (mUseHeldNotes) {
+				offsetRatio = HELPERS::fastExp2((2.0 * pParams->NoteOffset.getSampleAccurateValue(s)) - 1.0);
+			}
+
+			for (int l = 0; l < BANK_LANES; l++) {
+				double freqHz = mCenterHz * mLaneRatio[l];
+				if (mUseHeldNotes) {
+					freqHz = mHeldNoteHz[l % mNumHeldNotes] * offsetRatio;
+				}
+				freqHz *= modRatio;
+
+				if (freqHz > maxAllowedFreq) {
+					freqHz = maxAllowedFreq;
+				}
+				if (freqHz < MIN_FREQ_HZ) {
+					freqHz = MIN_FREQ_HZ;
+				}
+
+				double gTarget = HELPERS::fastTan((E_PI * freqHz) / (double)Setup.sampleRate);
+
+				if (FilterState.force_snap) {
+					mLaneG[l] = gTarget;
+				}
+
+				mLaneGStep[l] = (gTarget - mLaneG[l]) / MOD_CONTROL_INTERVAL;
+			}
+
+			mLaneCounter = MOD_CONTROL_INTERVAL;
+		}
+
+		for (int l = 0; l < BANK_LANES; l++) {
+			mLaneG[l] += mLaneGStep[l];
+		}
+		mLaneCounter--;
+	}
 
 	/// <summary>
 	/// Fetches current frequency parameters for this sample, determines whether Hz or note is
@@ -2,12 +2,34 @@
 // Copyright(c) 2025 Anis Dadou (GullDSP)
 //------------------------------------------------------------------------
 #pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 namespace HELPERS {
 	#define MAX_NOTE_NUM 128 
 	#define MAX_FREQ_HZ 18000
 	#define MIN_FREQ_HZ 20
-	#define MAX_NUM_STAGES 64
+	// Most stages an instance can be set up for (Stage Limit), the filter memory is sized by the limit chosen
+	#define MAX_NUM_STAGES 512
+	// Stage counts up to this have a fully unrolled kernel, and it is the default stage limit
+	#define UNROLLED_STAGES 64
+	// Max number of samples the cascade kernels process per run
+	#define CONTROL_BLOCK_SIZE 64
+	// Host blocks are processed in chunks of at most this many samples, parameter and scratch
+	// buffers are sized by it rather than by the host's block size
+	#define PROCESS_CHUNK_SIZE 128
+	// Samples between coefficient evaluations when the center is modulated at audio rate
+	#define MOD_CONTROL_INTERVAL 8
+	// Range of the sidechain modulation, in octaves either way
+	#define MAX_SIDECHAIN_OCTAVES 4
+	// Max parallel filter banks in chord mode, one per SIMD lane. 4 doubles fill an AVX register,
+	// more banks would take a second register per stage and double the cost of every chord
+	#define BANK_LANES 4
+	// Max spread of the stage centers, in octaves (half either side of the center)
+	#define MAX_SPREAD_OCTAVES 4
+	// Samples between per stage coefficient updates when the stage centers are spread
+	#define SPREAD_CONTROL_INTERVAL 16
 	
 
 	/// <summary>
@@ -35,6 +57,140 @@ namespace HELPERS {
 			out[index] = (mix * A[index]) + ((1.0 - mix) * B[index]);
 		}
 	}
+	/// <summary>
+	/// tan(x) for x in [0, pi/2), using a Pade approximant on [0, pi/4] and
+	/// tan(x) = 1 / tan(pi/2 - x) above that. Relative error below 2e-8
+	/// </summary>
+	inline double fastTan(double x) {
+		const double halfPi = 1.5707963267948966;
+		const double quarterPi = 0.7853981633974483;
+
+		bool reflect = x > quarterPi;
+		if (reflect) {
+			x = halfPi - x;
+		}
+
+		double x2 = x * x;
+		double t = x * (945.0 - 105.0 * x2 + x2 * x2) / (945.0 - 420.0 * x2 + 15.0 * x2 * x2);
+
+		return reflect ? 1.0 / t : t;
+	}
+
+	/// <summary>
+	/// 2^x, splitting into integer and fractional (-0.5 to 0.5) parts, the fraction
+	/// from a polynomial. Relative error around 1e-7
+	/// </summary>
+	inline double fastExp2(double x) {
+		double whole = std::floor(x + 0.5);
+		double f = x - whole;
+
+		double p = 1.0 + f * (0.6931471805599453 + f * (0.2402265069591007 + f * (0.05550410866482158 
+			+ f * (0.009618129107628477 + f * (0.0013333558146428443 + f * 0.00015403530393381606)))));
+
+		return std::ldexp(p, static_cast<int>(whole));
+	}
+
+	/// <summary>
+	/// Peak envelope follower, with separate attack and release
+	/// </summary>
+	class EnvelopeFollower {
+	public:
+		void setTimes(double attack_ms, double release_ms, int sample_rate) {
+			attackFactor = 1.0 - exp(-1.0 / (attack_ms * 0.001 * sample_rate));
+			releaseFactor = 1.0 - exp(-1.0 / (release_ms * 0.001 * sample_rate));
+		}
+		double getNext(float x) {
+			double rectified = std::abs(x);
+			double factor = (rectified > envelope) ? attackFactor : releaseFactor;
+			envelope += (rectified - envelope) * factor;
+			return envelope;
+		}
+		double getLastValue() const {
+			return envelope;
+		}
+		void setLastValue(double value) {
+			envelope = value;
+		}
+		void reset() {
+			envelope = 0;
+		}
+
+	private:
+		double envelope = 0;
+		double attackFactor = 0.1;
+		double releaseFactor = 0.001;
+	};
+
+	/// <summary>
+	/// True if both buffers hold exactly the same samples
+	/// </summary>
+	inline bool buffersIdentical(const float* A, const float* B, int numSamples) {
+		if (A == B) {
+			return true;
+		}
+		return memcmp(A, B, sizeof(float) * numSamples) == 0;
+	}
+
+	/// <summary>
+	/// Mean of the squared samples of a buffer
+	/// </summary>
+	inline float meanSquare(const float* buffer, int numSamples) {
+		if (numSamples <= 0) {
+			return 0.0f;
+		}
+		float sum = 0.0f;
+		for (int i = 0; i < numSamples; i++) {
+			sum += buffer[i] * buffer[i];
+		}
+		return sum / numSamples;
+	}
+
+	/// <summary>
+	/// One allocation that is handed out in 64 byte aligned slices. Allocated from setup with the
+	/// total of getAlignedBytes for every slice, then take is called in the same order to get them.
+	/// Reallocating invalidates the slices already taken.
+	/// </summary>
+	class AlignedArena {
+	public:
+		/// <summary>
+		/// Bytes a slice of numBytes uses in the arena
+		/// </summary>
+		static size_t getAlignedBytes(size_t numBytes) {
+			return (numBytes + 63) & ~static_cast<size_t>(63);
+		}
+
+		void allocate(size_t numBytes) {
+			// Room to align the start
+			Memory.assign(numBytes + 64, 0);
+			uintptr_t address = reinterpret_cast<uintptr_t>(Memory.data());
+			start = static_cast<size_t>(((address + 63) & ~static_cast<uintptr_t>(63)) - address);
+			used = 0;
+		}
+
+		/// <summary>
+		/// Next slice of count values, zeroed. nullptr if the arena is too small
+		/// </summary>
+		template <typename T>
+		T* take(size_t count) {
+			size_t numBytes = getAlignedBytes(count * sizeof(T));
+			if (start + used + numBytes > Memory.size()) {
+				return nullptr;
+			}
+			T* slice = reinterpret_cast<T*>(Memory.data() + start + used);
+			used += numBytes;
+			return slice;
+		}
+
+		size_t getSize() const {
+			return Memory.size();
+		}
+
+	private:
+		std::vector<uint8_t> Memory;
+		size_t start = 0;
+		size_t used = 0;
+	};
+
 	/// <summary>
 	/// Simple smoother for general purpose smoothing
 	/// </summary>
@@ -62,6 +218,12 @@ namespace HELPERS {
 			void reset() {
 				lastValue = 0;
 			}
+			double getLastValue() const {
+				return lastValue;
+			}
+			void setLastValue(double value) {
+				lastValue = value;
+			}
 
 		private:
 			double lastValue = 0;
@@ -5,9 +5,16 @@
 #pragma once
 #include "public.sdk/source/vst/vsteditcontroller.h"
 #include "pluginterfaces/vst/ivstparameterchanges.h"
+#include "pluginterfaces/vst/ivstevents.h"
+#include "base/source/fstreamer.h"
 #include "CirculateHelpers.h"
+#include "Checkpoint.h"
 #include "LogRangeParameter.h"
+#include "DepthParameter.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 /// <summary>
 /// This file contains the parameter system. Including parameter tags, parameter classes 
@@ -23,6 +30,24 @@ namespace CIRCULATE_PARAMS {
 	#define DEFAULT_NOTE 0.5
 	#define DEFAULT_OFFSET 0.5
 	#define DEFAULT_SWITCH 0.0
+	#define DEFAULT_STEREO 0.0
+	#define DEFAULT_SIDECHAIN 0.5
+	#define DEFAULT_CHORD 0.0
+	#define DEFAULT_PRECISION 0.0
+	#define DEFAULT_ENGINE 0.0
+	#define DEFAULT_SPREAD 0.0
+	#define DEFAULT_SPREAD_SHAPE 0.0
+	#define DEFAULT_STAGE_LIMIT 0.0
+	#define DEFAULT_BAND_SPLIT 0.0
+
+	/// <summary>
+	/// Read a value appended to the state after version 2. States saved before it was added end
+	/// earlier, and readDouble writes 0.0 when nothing is left, so they get the default instead
+	/// </summary>
+	inline double readAppendedValue(Steinberg::IBStreamer& streamer, double defaultValue) {
+		double value;
+		return streamer.readDouble(value) ? value : defaultValue;
+	}
 
 
 	inline const Steinberg::tchar* noteNames[128] = {
@@ -63,10 +88,104 @@ namespace CIRCULATE_PARAMS {
 		kSpread,
 
 		kSTSelector,
-		kHzSelector
+		kHzSelector,
+
+		kSidechain,
+		kChord,
+		kPrecision,
+		kEngine,
+		kLatency, // Output only, the processor reports its latency through it
+		kSpreadShape,
+		kStageLimit,
+		kBandSplit,
+		kPlayedNote, // Output only, the note playing (MIDI over the Note parameter), for the display
+		kRestartRequest // Output only, the processor asks for a restart to size its memory for the Stage Limit
 		
 	};
 
+	// Chord mode, parallel banks centered on intervals from the center, or on held MIDI notes
+	enum ChordModes {
+		kChordOff = 0,
+		kChordOctave,
+		kChordFifth,
+		kChordMajor,
+		kChordMinor,
+		kChordSus4,
+		kChordHeldNotes,
+
+		kNumChordModes
+	};
+
+	// Semitones from the center for each bank
+	inline const double chordIntervals[kNumChordModes][BANK_LANES] = {
+		{ 0, 0, 0, 0 },
+		{ 0, 12, 0, 0 },
+		{ 0, 7, 12, 0 },
+		{ 0, 4, 7, 12 },
+		{ 0, 3, 7, 12 },
+		{ 0, 5, 7, 12 },
+		{ 0, 0, 0, 0 }
+	};
+	// Banks used by each chord mode
+	inline const int chordSizes[kNumChordModes] = { 1, 2, 3, 4, 4, 4, 1 };
+
+	/// <summary>
+	/// Chord mode for a normalised Chord value
+	/// </summary>
+	inline int getChordMode(double normalised) {
+		int mode = static_cast<int>(normalised * (kNumChordModes - 1) + 0.5);
+		if (mode < 0) mode = 0;
+		if (mode >= kNumChordModes) mode = kNumChordModes - 1;
+		return mode;
+	}
+
+	// How the stage centers are distributed over the spread range
+	enum SpreadShapes {
+		kSpreadLog = 0, // even in octaves
+		kSpreadLinear, // even in Hz
+		kSpreadRandom, // fixed random offsets per stage
+
+		kNumSpreadShapes
+	};
+
+	/// <summary>
+	/// Spread shape for a normalised Spread Shape value
+	/// </summary>
+	inline int getSpreadShape(double normalised) {
+		int shape = static_cast<int>(normalised * (kNumSpreadShapes - 1) + 0.5);
+		if (shape < 0) shape = 0;
+		if (shape >= kNumSpreadShapes) shape = kNumSpreadShapes - 1;
+		return shape;
+	}
+
+	/// <summary>
+	/// Position of a stage in the spread, -0.5 to 0.5. Evenly spaced by stage index, or for Random
+	/// a hash of the stage index, so stages keep their place when the depth changes
+	/// </summary>
+	inline double getSpreadPosition(int shape, int stage, int numStages) {
+		if (shape == kSpreadRandom) {
+			uint32_t hash = static_cast<uint32_t>(stage + 1) * 2654435761u;
+			hash ^= hash >> 16;
+			hash *= 2246822519u;
+			hash ^= hash >> 13;
+			return (hash & 0xFFFF) / 65535.0 - 0.5;
+		}
+		return (numStages > 1) ? (double)stage / (numStages - 1) - 0.5 : 0.0;
+	}
+
+	// Stage limits, UNROLLED_STAGES doubled for each entry of the Stage Limit list
+	#define NUM_STAGE_LIMITS 4
+
+	/// <summary>
+	/// Number of stages for a normalised Stage Limit value
+	/// </summary>
+	inline int getStageLimit(double normalised) {
+		int index = static_cast<int>(normalised * (NUM_STAGE_LIMITS - 1) + 0.5);
+		if (index < 0) index = 0;
+		if (index >= NUM_STAGE_LIMITS) index = NUM_STAGE_LIMITS - 1;
+		return UNROLLED_STAGES << index;
+	}
+
 	inline void registerParameters(Steinberg::Vst::ParameterContainer& parameters) {
 
 		Steinberg::Vst::StringListParameter* centerNoteParam = new Steinberg::Vst::StringListParameter(STR16("Note"), kCenterST);
@@ -116,18 +235,16 @@ namespace CIRCULATE_PARAMS {
 
 		parameters.addParameter(noteOffset);
 
-		// Depth Param
-		auto* depthParam = new Steinberg::Vst::RangeParameter(
-			STR16("Depth"),                   
-			CirculateParamIDs::kDepth,             
-			STR16("x"),                     
-			0,                            
-			MAX_NUM_STAGES,                         
-			DEFAULT_DEPTH,                           
-			0, // Zero steps, we don't need the steps internally (it is cast to Int)
+		// Depth Param, a fraction of the Stage Limit shown as a number of stages (the controller
+		// updates the limit it shows for)
+		auto* depthParam = new DepthParameter(
+			STR16("Depth"),
+			CirculateParamIDs::kDepth,
+			STR16("x"),
+			DEFAULT_DEPTH,
+			getStageLimit(DEFAULT_STAGE_LIMIT),
 			Steinberg::Vst::ParameterInfo::kNoFlags
 		);
-		depthParam->setPrecision(0);
 		depthParam->setNormalized(DEFAULT_DEPTH);
 
 		parameters.addParameter(depthParam);
@@ -138,26 +255,123 @@ namespace CIRCULATE_PARAMS {
 		parameters.addParameter(STR16("Focus"), STR16(""), 0, DEFAULT_FOCUS, flags, CirculateParamIDs::kFocus);
 		parameters.addParameter(STR16("Feedback"), STR16(""), 0, DEFAULT_FEED, flags, CirculateParamIDs::kFeed);
 
+		// Stereo mode, L/R processes each channel, M/S processes mid and side (side is skipped while silent)
+		Steinberg::Vst::StringListParameter* stereoParam = new Steinberg::Vst::StringListParameter(STR16("Stereo"), CirculateParamIDs::kStereo, 0, Steinberg::Vst::ParameterInfo::kCanAutomate | Steinberg::Vst::ParameterInfo::kIsList);
+		stereoParam->appendString(STR16("L/R"));
+		stereoParam->appendString(STR16("M/S"));
+		stereoParam->setNormalized(DEFAULT_STEREO);
+		parameters.addParameter(stereoParam);
+
+		// Sidechain modulation, octaves of center shift at full sidechain envelope
+		auto* sidechainParam = new Steinberg::Vst::RangeParameter(
+			STR16("Sidechain"),
+			CirculateParamIDs::kSidechain,
+			STR16("Oct"),
+			-MAX_SIDECHAIN_OCTAVES,
+			MAX_SIDECHAIN_OCTAVES,
+			0,
+			0,
+			Steinberg::Vst::ParameterInfo::kCanAutomate
+		);
+		sidechainParam->setPrecision(2);
+		sidechainParam->setNormalized(DEFAULT_SIDECHAIN);
+		parameters.addParameter(sidechainParam);
+
+		Steinberg::Vst::StringListParameter* chordParam = new Steinberg::Vst::StringListParameter(STR16("Chord"), CirculateParamIDs::kChord, 0, Steinberg::Vst::ParameterInfo::kCanAutomate | Steinberg::Vst::ParameterInfo::kIsList);
+		chordParam->appendString(STR16("Off"));
+		chordParam->appendString(STR16("Octave"));
+		chordParam->appendString(STR16("Fifth"));
+		chordParam->appendString(STR16("Major"));
+		chordParam->appendString(STR16("Minor"));
+		chordParam->appendString(STR16("Sus4"));
+		chordParam->appendString(STR16("Notes"));
+		chordParam->setNormalized(DEFAULT_CHORD);
+		parameters.addParameter(chordParam);
+
+		// Internal precision of the filter memory, 32 bit is cheaper and transparent in most cases
+		Steinberg::Vst::StringListParameter* precisionParam = new Steinberg::Vst::StringListParameter(STR16("Precision"), CirculateParamIDs::kPrecision, 0, Steinberg::Vst::ParameterInfo::kIsList);
+		precisionParam->appendString(STR16("64 bit"));
+		precisionParam->appendString(STR16("32 bit"));
+		precisionParam->setNormalized(DEFAULT_PRECISION);
+		parameters.addParameter(precisionParam);
+
+		// Cascade is the allpass filters, Spectral applies the phase of up to SPECTRAL_MAX_STAGES stages
+		// per FFT bin, at a fixed cost but with latency. Not automatable, the latency changes with it
+		Steinberg::Vst::StringListParameter* engineParam = new Steinberg::Vst::StringListParameter(STR16("Engine"), CirculateParamIDs::kEngine, 0, Steinberg::Vst::ParameterInfo::kIsList);
+		engineParam->appendString(STR16("Cascade"));
+		engineParam->appendString(STR16("Spectral"));
+		engineParam->setNormalized(DEFAULT_ENGINE);
+		parameters.addParameter(engineParam);
+
+		// Spread of the stage centers around the center, in octaves. 0 is every stage at the center
+		auto* spreadParam = new Steinberg::Vst::RangeParameter(
+			STR16("Spread"),
+			CirculateParamIDs::kSpread,
+			STR16("Oct"),
+			0,
+			MAX_SPREAD_OCTAVES,
+			0,
+			0,
+			Steinberg::Vst::ParameterInfo::kCanAutomate
+		);
+		spreadParam->setPrecision(2);
+		spreadParam->setNormalized(DEFAULT_SPREAD);
+		parameters.addParameter(spreadParam);
+
+		Steinberg::Vst::StringListParameter* spreadShapeParam = new Steinberg::Vst::StringListParameter(STR16("Spread Shape"), CirculateParamIDs::kSpreadShape, 0, Steinberg::Vst::ParameterInfo::kCanAutomate | Steinberg::Vst::ParameterInfo::kIsList);
+		spreadShapeParam->appendString(STR16("Log"));
+		spreadShapeParam->appendString(STR16("Linear"));
+		spreadShapeParam->appendString(STR16("Random"));
+		spreadShapeParam->setNormalized(DEFAULT_SPREAD_SHAPE);
+		parameters.addParameter(spreadShapeParam);
+
+		// Most stages Depth can reach, the filter memory is sized for it. Applied when the processor is next
+		// activated (it asks for a restart once it has the new value), not automatable. Depth keeps its
+		// value, so it reaches a different number of stages
+		Steinberg::Vst::StringListParameter* stageLimitParam = new Steinberg::Vst::StringListParameter(STR16("Stage Limit"), CirculateParamIDs::kStageLimit, 0, Steinberg::Vst::ParameterInfo::kIsList);
+		stageLimitParam->appendString(STR16("64"));
+		stageLimitParam->appendString(STR16("128"));
+		stageLimitParam->appendString(STR16("256"));
+		stageLimitParam->appendString(STR16("512"));
+		stageLimitParam->setNormalized(DEFAULT_STAGE_LIMIT);
+		parameters.addParameter(stageLimitParam);
+
+		// Run the cascade on a decimated low band at high sample rates, for low centers. Not
+		// automatable, the latency changes with it
+		Steinberg::Vst::StringListParameter* bandSplitParam = new Steinberg::Vst::StringListParameter(STR16("Band Split"), CirculateParamIDs::kBandSplit, 0, Steinberg::Vst::ParameterInfo::kIsList);
+		bandSplitParam->appendString(STR16("Off"));
+		bandSplitParam->appendString(STR16("On"));
+		bandSplitParam->setNormalized(DEFAULT_BAND_SPLIT);
+		parameters.addParameter(bandSplitParam);
+
+		parameters.addParameter(STR16("Latency"), STR16(""), 1, 0, Steinberg::Vst::ParameterInfo::kIsReadOnly | Steinberg::Vst::ParameterInfo::kIsHidden, CirculateParamIDs::kLatency);
+		parameters.addParameter(STR16("Restart"), STR16(""), 1, 0, Steinberg::Vst::ParameterInfo::kIsReadOnly | Steinberg::Vst::ParameterInfo::kIsHidden, CirculateParamIDs::kRestartRequest);
+
+		// Note display, follows incoming MIDI notes without them becoming the Note setting
+		Steinberg::Vst::StringListParameter* playedNoteParam = new Steinberg::Vst::StringListParameter(STR16("Played Note"), kPlayedNote, 0,
+			Steinberg::Vst::ParameterInfo::kIsReadOnly | Steinberg::Vst::ParameterInfo::kIsHidden);
+		for (int i = 0; i < MAX_NOTE_NUM; i++) {
+			playedNoteParam->appendString(noteNames[i]);
+		}
+		playedNoteParam->setNormalized(DEFAULT_NOTE);
+		parameters.addParameter(playedNoteParam);
+
 	}
 	/// <summary>
 	/// A single parameter, each with their own
-	/// vector to hold parameter changes for a block
+	/// array to hold parameter changes for a chunk (PROCESS_CHUNK_SIZE samples)
 	/// </summary>
 	class ParamUnit {
 	public:
-		ParamUnit(int paramID = 0, double default_value = 0, bool sampleAccurate = false, int maxBlockSize = 0) {
+		ParamUnit(int paramID = 0, double default_value = 0) {
 			value = default_value;
 			lastExplicit = default_value;
 			smoothedValue = default_value;
 			id = paramID;
 			smoothedValue = default_value;
-			this->currentBlockSize = maxBlockSize;
-
-			if (sampleAccurate) {
-				BlockValues.resize(maxBlockSize, default_value);
-
-			}
+			this->currentBlockSize = PROCESS_CHUNK_SIZE;
 
+			BlockValues.fill(default_value);
 		}
 		int getID() {
 			return id;
@@ -217,9 +431,8 @@ namespace CIRCULATE_PARAMS {
 		}
 		void setCurrentBlockSize(int newSize) {
 
-			if (newSize > currentBlockSize) {
-				BlockValues.resize(newSize, lastExplicit);
-
+			if (newSize > PROCESS_CHUNK_SIZE) {
+				newSize = PROCESS_CHUNK_SIZE;
 			}
 
 			currentBlockSize = newSize;
@@ -230,7 +443,96 @@ namespace CIRCULATE_PARAMS {
 				smoothedValue = lastValue;
 			}
 		}
-		std::vector<double> BlockValues;
+		/// <summary>
+		/// Read this chunk's changes from the queue set with setQueue into BlockValues. Points apply
+		/// from their sample offset (relative to the host block) onwards, the queue is read forward
+		/// across the chunks of a block so every point is only fetched once
+		/// </summary>
+		/// <param name="chunkStart"> Offset of the chunk in the host block</param>
+		/// <param name="numSamples"></param>
+		void readQueue(int chunkStart, int numSamples) {
+			if (!Queue || nextPoint >= numPoints) {
+				return; // No changes left, already prefilled
+			}
+
+			// Get last raw value from the previous chunk
+			Steinberg::Vst::ParamValue currentValue = lastExplicit;
+
+			Steinberg::int32 sampleOffset = 0;
+			Steinberg::Vst::ParamValue pointValue = 0;
+
+			for (int i = 0; i < numSamples; i++) {
+				// Process all changes that occur at or before this sample
+				while (nextPoint < numPoints) {
+					Queue->getPoint(nextPoint, sampleOffset, pointValue);
+
+					if (sampleOffset <= chunkStart + i) {
+						currentValue = pointValue;
+						nextPoint++;
+					}
+					else {
+						break; // Future change so stop here (if multiple changes this index, get all and keep latest)
+					}
+				}
+
+				BlockValues[i] = currentValue;
+			}
+
+			lastExplicit = currentValue;
+		}
+
+		/// <summary>
+		/// Set the queue holding this parameter's changes for the current host block
+		/// </summary>
+		void setQueue(Steinberg::Vst::IParamValueQueue* queue) {
+			Queue = queue;
+			numPoints = queue ? queue->getPointCount() : 0;
+			nextPoint = 0;
+		}
+
+		/// <summary>
+		/// Take the value of any points the chunks didn't reach (a zero length block, or
+		/// points past the end of the block) and let go of the queue
+		/// </summary>
+		void finishQueue() {
+			if (Queue && nextPoint < numPoints) {
+				Steinberg::int32 sampleOffset = 0;
+				Steinberg::Vst::ParamValue pointValue = 0;
+				Queue->getPoint(numPoints - 1, sampleOffset, pointValue);
+				lastExplicit = pointValue;
+			}
+			setQueue(nullptr);
+		}
+
+		/// <summary>
+		/// Write the value and smoothing memory to a checkpoint (between chunks)
+		/// </summary>
+		void saveState(CHECKPOINT::Writer& Out) const {
+			double state[3] = { lastExplicit, lastValue, smoothedValue };
+			Out.write(state, 3);
+		}
+
+		bool restoreState(CHECKPOINT::Reader& In) {
+			double state[3] = {};
+			if (!In.read(state, 3)) {
+				return false;
+			}
+			lastExplicit = state[0];
+			lastValue = state[1];
+			smoothedValue = state[2];
+			return true;
+		}
+
+		/// <summary>
+		/// Take another unit's values for its current chunk, what the effect reads
+		/// </summary>
+		void copyChunkFrom(const ParamUnit& Other) {
+			currentBlockSize = Other.currentBlockSize;
+			std::copy(Other.BlockValues.begin(), Other.BlockValues.begin() + currentBlockSize, BlockValues.begin());
+			lastExplicit = Other.lastExplicit;
+		}
+
+		alignas(64) std::array<double, PROCESS_CHUNK_SIZE> BlockValues;
 		bool wantsSmoothing = true;
 		double lastExplicit = 0;
 
@@ -243,26 +545,41 @@ namespace CIRCULATE_PARAMS {
 		int id = 0;
 		int currentBlockSize = 0;
 
+		Steinberg::Vst::IParamValueQueue* Queue = nullptr;
+		int numPoints = 0;
+		int nextPoint = 0;
+
 	};
 
 	/// <summary>
 	/// Container class for parameters.
 	///
+	/// Values are held for one chunk of at most PROCESS_CHUNK_SIZE samples, the processor splits
+	/// host blocks into chunks, so the size of the parameters doesn't depend on the host's block size.
+	/// Per chunk: setCurrentBlockSizeAndPreFill, readParamChanges, applyMidiNotes, smoothAllParameters
 	/// </summary>
 	class AudioEffectParameters {
 	public:
-		AudioEffectParameters(int blockSize, int sampleRate) :
-			Center(kCenter, DEFAULT_CENTER, true, blockSize),
-			Focus(kFocus, DEFAULT_FOCUS, true, blockSize),
-			Note(kCenterST, DEFAULT_NOTE, true, blockSize),
-			Depth(kDepth, DEFAULT_DEPTH, true, blockSize),
-			CenterType(kSetSwitch, DEFAULT_SWITCH, true, blockSize),
-			NoteOffset(kNoteOffset, DEFAULT_OFFSET, true, blockSize),
-
-			Feedback(kFeed, 0.5, true, blockSize)
+		AudioEffectParameters(int sampleRate) :
+			Center(kCenter, DEFAULT_CENTER),
+			Focus(kFocus, DEFAULT_FOCUS),
+			Note(kCenterST, DEFAULT_NOTE),
+			Depth(kDepth, DEFAULT_DEPTH),
+			CenterType(kSetSwitch, DEFAULT_SWITCH),
+			NoteOffset(kNoteOffset, DEFAULT_OFFSET),
+
+			Feedback(kFeed, 0.5),
+			StereoMode(kStereo, DEFAULT_STEREO),
+			Sidechain(kSidechain, DEFAULT_SIDECHAIN),
+			Chord(kChord, DEFAULT_CHORD),
+			Precision(kPrecision, DEFAULT_PRECISION),
+			Engine(kEngine, DEFAULT_ENGINE),
+			Spread(kSpread, DEFAULT_SPREAD),
+			SpreadShape(kSpreadShape, DEFAULT_SPREAD_SHAPE),
+			StageLimit(kStageLimit, DEFAULT_STAGE_LIMIT),
+			BandSplit(kBandSplit, DEFAULT_BAND_SPLIT)
 
 		{
-			blockSize = blockSize;
 			// Add parameter objects to the parameter manager's list
 			ParameterList.push_back(&Center);
 			ParameterList.push_back(&Focus);
@@ -271,6 +588,15 @@ namespace CIRCULATE_PARAMS {
 			ParameterList.push_back(&CenterType);
 			ParameterList.push_back(&NoteOffset);
 			ParameterList.push_back(&Feedback);
+			ParameterList.push_back(&StereoMode);
+			ParameterList.push_back(&Sidechain);
+			ParameterList.push_back(&Chord);
+			ParameterList.push_back(&Precision);
+			ParameterList.push_back(&Engine);
+			ParameterList.push_back(&Spread);
+			ParameterList.push_back(&SpreadShape);
+			ParameterList.push_back(&StageLimit);
+			ParameterList.push_back(&BandSplit);
 		
 			initialiseSmoothers(sampleRate);
 			setDefaults();
@@ -282,11 +608,20 @@ namespace CIRCULATE_PARAMS {
 			Focus.setSmoothTime(20, sample_rate);
 			NoteOffset.setSmoothTime(20, sample_rate);
 			Feedback.setSmoothTime(10, sample_rate);
+			Sidechain.setSmoothTime(20, sample_rate);
+			Spread.setSmoothTime(20, sample_rate);
 
 			// Disable smoothing on discrete parameters
 			Depth.setSmoothTime(0, sample_rate);
 			CenterType.setSmoothTime(0, sample_rate);
 			Note.setSmoothTime(0, sample_rate); // Note is smoothed after conversion to Hz in main loop
+			StereoMode.setSmoothTime(0, sample_rate);
+			Chord.setSmoothTime(0, sample_rate);
+			Precision.setSmoothTime(0, sample_rate);
+			Engine.setSmoothTime(0, sample_rate);
+			SpreadShape.setSmoothTime(0, sample_rate);
+			StageLimit.setSmoothTime(0, sample_rate);
+			BandSplit.setSmoothTime(0, sample_rate);
 		}
 
 		void setDefaults() {
@@ -297,6 +632,15 @@ namespace CIRCULATE_PARAMS {
 			CenterType.fillWith(DEFAULT_SWITCH);
 			NoteOffset.fillWith(DEFAULT_OFFSET);
 			Feedback.fillWith(DEFAULT_FEED);
+			StereoMode.fillWith(DEFAULT_STEREO);
+			Sidechain.fillWith(DEFAULT_SIDECHAIN);
+			Chord.fillWith(DEFAULT_CHORD);
+			Precision.fillWith(DEFAULT_PRECISION);
+			Engine.fillWith(DEFAULT_ENGINE);
+			Spread.fillWith(DEFAULT_SPREAD);
+			SpreadShape.fillWith(DEFAULT_SPREAD_SHAPE);
+			StageLimit.fillWith(DEFAULT_STAGE_LIMIT);
+			BandSplit.fillWith(DEFAULT_BAND_SPLIT);
 		}
 
 		/// <summary>
@@ -316,12 +660,11 @@ namespace CIRCULATE_PARAMS {
 			return nullptr;
 		}
 
-		void reInitialise(int block_size, int sample_rate) {
-			int blockSize = block_size;
+		void reInitialise(int sample_rate) {
 
 			for (auto& param : ParameterList) {
 
-				param->setCurrentBlockSize(block_size);
+				param->setCurrentBlockSize(PROCESS_CHUNK_SIZE);
 				param->fillWithLastKnown();
 
 			}
@@ -330,12 +673,13 @@ namespace CIRCULATE_PARAMS {
 
 		}
 		/// <summary>
-		/// Call in process block to update for variable block sizes
+		/// Call for each chunk to update for variable chunk sizes
 		/// </summary>
-		/// <param name="size"></param>
+		/// <param name="size"> Samples in the chunk, at most PROCESS_CHUNK_SIZE</param>
 		void setCurrentBlockSizeAndPreFill(int block_size) {
 			blockSize = block_size;
 			for (auto& param : ParameterList) {
+				param->setCurrentBlockSize(block_size);
 				param->fillWithLastKnown();
 
 			}
@@ -347,56 +691,138 @@ namespace CIRCULATE_PARAMS {
 		}
 
 		/// <summary>
-		/// Get all changes for a parameter and put them in its vector (BlockValues)
+		/// Write every parameter's value and smoothing memory, and the MIDI note, to a checkpoint
 		/// </summary>
-		/// <param name="queue"></param>
-		/// <param name="paramID"></param>
-		/// <param name="blockSize"></param>
-		void getParamChangesThisBlock(Steinberg::Vst::IParamValueQueue* queue, int paramID, int blockSize) {
-			if (paramID < 1) {
-				return;
+		void saveState(CHECKPOINT::Writer& Out) const {
+			Out.write(static_cast<int32_t>(ParameterList.size()));
+			for (const ParamUnit* param : ParameterList) {
+				param->saveState(Out);
 			}
+			double midi[2] = { midiNote, midiNoteBase };
+			Out.write(midi, 2);
+		}
 
-			CIRCULATE_PARAMS::ParamUnit* Param = getParameter(paramID);
-			double* ParamValues = nullptr;
-			if (Param) {
-				ParamValues = Param->BlockValues.data();
+		bool restoreState(CHECKPOINT::Reader& In) {
+			int32_t numParams = 0;
+			if (!In.read(numParams) || numParams != static_cast<int32_t>(ParameterList.size())) {
+				return false;
 			}
-			else {
-				return;
+			for (auto& param : ParameterList) {
+				if (!param->restoreState(In)) {
+					return false;
+				}
 			}
+			double midi[2] = {};
+			if (!In.read(midi, 2)) {
+				return false;
+			}
+			midiNote = midi[0];
+			midiNoteBase = midi[1];
+			return true;
+		}
 
-			int numChanges = queue->getPointCount();
+		/// <summary>
+		/// Copy the values of the current chunk from other parameters, so an effect can run the
+		/// chunk from the copy while the others move on to the next chunk
+		/// </summary>
+		void copyChunkFrom(const AudioEffectParameters& Other) {
+			for (size_t p = 0; p < ParameterList.size(); p++) {
+				ParameterList[p]->copyChunkFrom(*Other.ParameterList[p]);
+			}
+			blockSize = Other.blockSize;
+		}
 
-			if (numChanges == 0) {
-				return; // No changes, already prefilled
+		/// <summary>
+		/// Hand a parameter its queue of changes for this host block, read chunk by chunk with readParamChanges
+		/// </summary>
+		/// <param name="queue"></param>
+		void setParamQueue(Steinberg::Vst::IParamValueQueue* queue) {
+			if (ParamUnit* Param = getParameter(queue->getParameterId())) {
+				Param->setQueue(queue);
 			}
+		}
 
-			// Get last raw value from previous block
-			Steinberg::Vst::ParamValue currentValue = Param->lastExplicit;
+		/// <summary>
+		/// Get every parameter's changes for a chunk and put them in its array (BlockValues)
+		/// </summary>
+		/// <param name="chunkStart"> Offset of the chunk in the host block</param>
+		/// <param name="numSamples"></param>
+		void readParamChanges(int chunkStart, int numSamples) {
+			for (auto& param : ParameterList) {
+				param->readQueue(chunkStart, numSamples);
+			}
+		}
 
-			int changeIndex = 0;
-			int sampleOffset = 0;
-			double value = 0;
+		/// <summary>
+		/// Call at the end of the host block, after the last chunk
+		/// </summary>
+		void finishParamQueues() {
+			for (auto& param : ParameterList) {
+				param->finishQueue();
+			}
+		}
 
-			for (int i = 0; i < blockSize; i++) {
-				// Process all changes that occur at or before this sample
-				while (changeIndex < numChanges) {
-					queue->getPoint(changeIndex, sampleOffset, value);
+		/// <summary>
+		/// Note on events play over the Note parameter from their sample offset onwards, so the
+		/// center follows incoming MIDI when in note (ST) mode. The MIDI note is held here, layered
+		/// over the Note array (BlockValues) after the parameter queue, and never becomes the
+		/// parameter's value, so it isn't saved or sent back to the host. It holds until the Note
+		/// parameter itself moves, then the parameter takes over again. Call for every chunk,
+		/// events or not, so a held note carries on.
+		/// </summary>
+		/// <param name="events"> may be nullptr</param>
+		/// <param name="blockSize"> Samples in the host block</param>
+		/// <param name="chunkStart"> Offset of the chunk in the host block, only notes inside it are read</param>
+		/// <param name="numSamples"> Samples in the chunk</param>
+		void applyMidiNotes(Steinberg::Vst::IEventList* events, int blockSize, int chunkStart, int numSamples) {
+			double* NoteValues = Note.BlockValues.data();
+			int numEvents = (events && blockSize > 0) ? events->getEventCount() : 0;
+			int position = 0;
+
+			for (int e = 0; e < numEvents; e++) {
+				Steinberg::Vst::Event event;
+				if (events->getEvent(e, event) != Steinberg::kResultOk) {
+					continue;
+				}
+				if (event.type != Steinberg::Vst::Event::kNoteOnEvent || event.noteOn.velocity <= 0) {
+					continue;
+				}
 
-					if (sampleOffset <= i) {
-						currentValue = value;
-						changeIndex++;
-					}
-					else {
-						break; // Future change so stop here (if multiple changes this index, get all and keep latest)
-					}
+				int offset = event.sampleOffset;
+				if (offset < 0) offset = 0;
+				if (offset > blockSize - 1) offset = blockSize - 1;
+
+				offset -= chunkStart;
+				if (offset < 0 || offset >= numSamples) {
+					continue;
+				}
+				if (offset < position) {
+					offset = position;
 				}
 
-				ParamValues[i] = currentValue;
+				layerMidiNote(NoteValues, position, offset);
+				position = offset;
+
+				// Same normalisation as the Note list parameter (index / (count - 1))
+				midiNote = event.noteOn.pitch / (double)(MAX_NOTE_NUM - 1);
+				midiNoteBase = NoteValues[offset];
 			}
 
-			Param->lastExplicit = currentValue;
+			layerMidiNote(NoteValues, position, numSamples);
+		}
+
+		/// <summary>
+		/// Normalised note playing at the end of the last chunk, the MIDI note or the Note parameter
+		/// </summary>
+		double getPlayedNote() const {
+			return (midiNote >= 0) ? midiNote : Note.lastExplicit;
+		}
+
+		/// <summary>
+		/// Let go of the MIDI note, the Note parameter plays
+		/// </summary>
+		void clearMidiNote() {
+			midiNote = -1;
 		}
 
 		//Parameters-----
@@ -407,10 +833,35 @@ namespace CIRCULATE_PARAMS {
 		ParamUnit CenterType;
 		ParamUnit NoteOffset;
 		ParamUnit Feedback;
+		ParamUnit StereoMode;
+		ParamUnit Sidechain;
+		ParamUnit Chord;
+		ParamUnit Precision;
+		ParamUnit Engine;
+		ParamUnit Spread;
+		ParamUnit SpreadShape;
+		ParamUnit StageLimit;
+		ParamUnit BandSplit;
 		std::vector<ParamUnit*> ParameterList;
 
 		int blockSize = 0;
 
+	private:
+		// Last MIDI note on (normalised like Note), -1 when the Note parameter plays
+		double midiNote = -1;
+		// The Note parameter's own value when the MIDI note arrived, a different value means it moved
+		double midiNoteBase = 0;
+
+		void layerMidiNote(double* NoteValues, int start, int end) {
+			for (int i = start; i < end && midiNote >= 0; i++) {
+				if (NoteValues[i] != midiNoteBase) {
+					midiNote = -1;
+					break;
+				}
+				NoteValues[i] = midiNote;
+			}
+		}
+
 	};
 
 }
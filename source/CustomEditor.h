@@ -7,6 +7,67 @@
 #include "vstgui/uidescription/icontroller.h"
 #include "vstgui/uidescription/uiviewswitchcontainer.h"
 #include "vstgui/uidescription/uiattributes.h"
+/// <summary>
+/// The parsed editor description, shared by every editor in the process. Parsing the XML is
+/// most of the cost of creating an editor, so it is only done for the first one.
+/// Controllers retain it in initialize and release it in terminate, so it is freed with the
+/// last controller rather than after VSTGUI has shut down. UI thread only.
+///
+/// Every open editor reads the same UIDescription, so it must not change while shared. Live
+/// editing (VSTGUI_LIVE_EDITING, debug builds) edits the description of the editor in place, so
+/// there each editor parses its own and nothing is shared. CirculateBenchHost --editor checks
+/// editors of two instances open at once.
+/// </summary>
+class SharedUIDescription {
+public:
+	/// <summary>
+	/// Parsed description, nullptr if it couldn't be parsed or isn't shared (live editing)
+	/// </summary>
+	static VSTGUI::UIDescription* get(VSTGUI::UTF8StringPtr xml) {
+#if VSTGUI_LIVE_EDITING
+		// Editors parse their own, see above
+		static_cast<void>(xml);
+		return nullptr;
+#else
+		SharedUIDescription& Instance = getInstance();
+
+		if (!Instance.Description && !Instance.parseFailed) {
+			auto Description = VSTGUI::makeOwned<VSTGUI::UIDescription>(xml);
+			if (Description->parse()) {
+				Instance.Description = Description;
+			}
+			else {
+				Instance.parseFailed = true;
+			}
+		}
+		return Instance.Description;
+#endif
+	}
+
+	static void retain() {
+		getInstance().numUsers++;
+	}
+
+	static void release() {
+		SharedUIDescription& Instance = getInstance();
+		if (--Instance.numUsers <= 0) {
+			Instance.numUsers = 0;
+			Instance.Description = nullptr;
+			Instance.parseFailed = false;
+		}
+	}
+
+private:
+	VSTGUI::SharedPointer<VSTGUI::UIDescription> Description;
+	int numUsers = 0;
+	bool parseFailed = false;
+
+	static SharedUIDescription& getInstance() {
+		static SharedUIDescription Instance;
+		return Instance;
+	}
+};
+
 /// <summary>
 /// Custom editor, most of this is just manually switching the views for the center control
 /// as the viewswitchcontainer was buggy in ableton
@@ -17,9 +78,16 @@ public:
 	CustomEditor(Steinberg::Vst::EditController* controller, VSTGUI::UTF8StringPtr templatename,
 		VSTGUI::UTF8StringPtr xml) : VST3Editor(controller, templatename, xml) {
 
-		std::vector<double> zoomFactors = { 0.5,1,1.5,2,3,4,8, 16 };
-		VST3Editor::setAllowedZoomFactors(zoomFactors);
-	
+		setZoomFactors();
+	}
+
+	/// <summary>
+	/// Editor using an already parsed description (see SharedUIDescription)
+	/// </summary>
+	CustomEditor(VSTGUI::UIDescription* description, Steinberg::Vst::EditController* controller, VSTGUI::UTF8StringPtr templatename,
+		VSTGUI::UTF8StringPtr xml) : VST3Editor(description, controller, templatename, xml) {
+
+		setZoomFactors();
 	}
 
 	void setSwitchToHz(bool isHz) { 
@@ -83,6 +151,11 @@ public:
 
 private:
 
+	void setZoomFactors() {
+		std::vector<double> zoomFactors = { 0.5,1,1.5,2,3,4,8, 16 };
+		VST3Editor::setAllowedZoomFactors(zoomFactors);
+	}
+
 	VSTGUI::SharedPointer<VSTGUI::CViewContainer> pNoteContainer = nullptr;
 	VSTGUI::SharedPointer<VSTGUI::CViewContainer> pHzContainer = nullptr;
 	bool switchIsHz = true;
@@ -0,0 +1,74 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "public.sdk/source/vst/vsteditcontroller.h"
+#include <cstdio>
+#include <cstdlib>
+
+/// <summary>
+/// Depth, the fraction of the Stage Limit that is active. The range is fixed (0 to 1, the
+/// parameter info never changes) and the value is shown as a number of stages at the current
+/// limit, so changing Stage Limit rescales what a Depth value (and its automation) means, but
+/// never the parameter itself. The controller sets the limit it displays for.
+/// </summary>
+class DepthParameter : public Steinberg::Vst::Parameter
+{
+public:
+	DepthParameter(const Steinberg::Vst::TChar* title, Steinberg::Vst::ParamID tag, const Steinberg::Vst::TChar* units,
+		Steinberg::Vst::ParamValue defaultValue, int stageLimit, Steinberg::int32 flags)
+		: Parameter(title, tag, units, defaultValue, 0, flags, 0)
+		, mStageLimit(stageLimit)
+	{
+		setPrecision(0);
+	}
+
+	void setStageLimit(int stageLimit) {
+		mStageLimit = stageLimit;
+	}
+
+	int getStageLimit() const {
+		return mStageLimit;
+	}
+
+	/// <summary>
+	/// Stage count of a normalised Depth, rounded as the processor does
+	/// </summary>
+	int getStageCount(Steinberg::Vst::ParamValue normalizedValue) const {
+		return static_cast<int>(normalizedValue * mStageLimit + 0.5);
+	}
+
+	void toString(Steinberg::Vst::ParamValue normalizedValue, Steinberg::Vst::String128 string) const SMTG_OVERRIDE
+	{
+		char text[128];
+		snprintf(text, sizeof(text), "%d", getStageCount(normalizedValue));
+
+		for (int i = 0; i < 128; ++i) {
+			string[i] = text[i];
+			if (text[i] == '\0') break;
+		}
+	}
+
+	// A typed number of stages, at the current limit
+	bool fromString(const Steinberg::Vst::TChar* string, Steinberg::Vst::ParamValue& valueNormalized) const SMTG_OVERRIDE
+	{
+		char text[128];
+		int i = 0;
+		for (; i < 127 && string[i] != 0; ++i) {
+			text[i] = static_cast<char>(string[i]);
+		}
+		text[i] = '\0';
+
+		char* end = nullptr;
+		double stages = strtod(text, &end);
+		if (end == text || mStageLimit < 1) return false;
+
+		valueNormalized = stages / mStageLimit;
+		if (valueNormalized < 0.0) valueNormalized = 0.0;
+		if (valueNormalized > 1.0) valueNormalized = 1.0;
+		return true;
+	}
+
+private:
+	int mStageLimit = 0;
+};
@@ -0,0 +1,191 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <cmath>
+#include <vector>
+
+/// <summary>
+/// Radix 2 FFT of real signals, single precision.
+///
+/// A real signal of N samples is transformed as a complex signal of N/2 (even samples as the real
+/// part, odd samples as the imaginary part), then split into the N/2 + 1 bins of the real spectrum.
+/// Tables are built by setSize, which allocates, so call it from setup rather than process.
+///
+/// Spectra are stored interleaved, re and im of bin k at [2k] and [2k + 1], N + 2 floats.
+/// </summary>
+class RealFFT {
+public:
+	/// <summary>
+	/// Set the transform size and build the tables
+	/// </summary>
+	/// <param name="size"> Power of 2, at least 4</param>
+	void setSize(int size) {
+		N = size;
+		M = size / 2;
+
+		levels = 0;
+		while ((1 << levels) < M) {
+			levels++;
+		}
+
+		BitReverse.resize(M);
+		for (int i = 0; i < M; i++) {
+			int reversed = 0;
+			for (int b = 0; b < levels; b++) {
+				reversed |= ((i >> b) & 1) << (levels - 1 - b);
+			}
+			BitReverse[i] = reversed;
+		}
+
+		// Twiddles of the N/2 point transform, e^(-2 pi j k / M)
+		Twiddle.resize(M);
+		for (int k = 0; k < M / 2; k++) {
+			double angle = -2.0 * 3.14159265358979323846 * k / M;
+			Twiddle[2 * k] = static_cast<float>(cos(angle));
+			Twiddle[2 * k + 1] = static_cast<float>(sin(angle));
+		}
+
+		// Twiddles of the real split, e^(-2 pi j k / N)
+		SplitTwiddle.resize(M + 2);
+		for (int k = 0; k <= M / 2; k++) {
+			double angle = -2.0 * 3.14159265358979323846 * k / N;
+			SplitTwiddle[2 * k] = static_cast<float>(cos(angle));
+			SplitTwiddle[2 * k + 1] = static_cast<float>(sin(angle));
+		}
+
+		Work.assign(N, 0.0f);
+	}
+
+	int getSize() const {
+		return N;
+	}
+
+	/// <summary>
+	/// Spectrum of N real samples
+	/// </summary>
+	/// <param name="input"> N samples</param>
+	/// <param name="spectrum"> N + 2 floats, bins 0 to N/2</param>
+	void forward(const float* input, float* spectrum) {
+		float* z = Work.data();
+		for (int i = 0; i < N; i++) {
+			z[i] = input[i];
+		}
+		transform(z, false);
+
+		// X[k] = (Z[k] + conj(Z[M - k])) / 2 - j W^k (Z[k] - conj(Z[M - k])) / 2
+		for (int k = 0; k <= M / 2; k++) {
+			int m = (k == 0) ? 0 : M - k;
+			float zr = z[2 * k], zi = z[2 * k + 1];
+			float cr = z[2 * m], ci = -z[2 * m + 1];
+
+			float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+			float dr = 0.5f * (zr - cr), di = 0.5f * (zi - ci);
+			// o = -j * d
+			float or_ = di, oi = -dr;
+
+			float wr = SplitTwiddle[2 * k], wi = SplitTwiddle[2 * k + 1];
+			float tr = wr * or_ - wi * oi;
+			float ti = wr * oi + wi * or_;
+
+			spectrum[2 * k] = er + tr;
+			spectrum[2 * k + 1] = ei + ti;
+			// Mirror bin, M - k, from the same pair
+			spectrum[2 * (M - k)] = er - tr;
+			spectrum[2 * (M - k) + 1] = -(ei - ti);
+		}
+		spectrum[1] = 0.0f;
+		spectrum[2 * M + 1] = 0.0f;
+	}
+
+	/// <summary>
+	/// N real samples from a spectrum, scaled so inverse(forward(x)) = x
+	/// </summary>
+	/// <param name="spectrum"> N + 2 floats, bins 0 to N/2</param>
+	/// <param name="output"> N samples</param>
+	void inverse(const float* spectrum, float* output) {
+		float* z = Work.data();
+
+		// Z[k] = E[k] + j O[k], with E[k] = (X[k] + conj(X[M - k])) / 2, O[k] = W^-k (X[k] - conj(X[M - k])) / 2
+		for (int k = 0; k <= M / 2; k++) {
+			int m = M - k;
+			float xr = spectrum[2 * k], xi = spectrum[2 * k + 1];
+			float cr = spectrum[2 * m], ci = -spectrum[2 * m + 1];
+
+			float er = 0.5f * (xr + cr), ei = 0.5f * (xi + ci);
+			float dr = 0.5f * (xr - cr), di = 0.5f * (xi - ci);
+
+			// Conjugate twiddle
+			float wr = SplitTwiddle[2 * k], wi = -SplitTwiddle[2 * k + 1];
+			float or_ = wr * dr - wi * di;
+			float oi = wr * di + wi * dr;
+
+			// Z[k] = E + jO
+			z[2 * (k % M)] = er - oi;
+			z[2 * (k % M) + 1] = ei + or_;
+
+			if (k != 0 && k != m) {
+				// Z[M - k] = conj(E) + j conj(-W^k... ) from the mirrored pair
+				z[2 * m] = er + oi;
+				z[2 * m + 1] = -ei + or_;
+			}
+		}
+
+		transform(z, true);
+
+		float scale = 1.0f / M;
+		for (int i = 0; i < N; i++) {
+			output[i] = z[i] * scale;
+		}
+	}
+
+private:
+	int N = 0;
+	int M = 0;
+	int levels = 0;
+	std::vector<int> BitReverse;
+	std::vector<float> Twiddle;
+	std::vector<float> SplitTwiddle;
+	std::vector<float> Work;
+
+	/// <summary>
+	/// In place complex transform of M interleaved values, unscaled
+	/// </summary>
+	void transform(float* z, bool inverse) {
+		for (int i = 0; i < M; i++) {
+			int j = BitReverse[i];
+			if (j > i) {
+				float r = z[2 * i], im = z[2 * i + 1];
+				z[2 * i] = z[2 * j];
+				z[2 * i + 1] = z[2 * j + 1];
+				z[2 * j] = r;
+				z[2 * j + 1] = im;
+			}
+		}
+
+		float sign = inverse ? -1.0f : 1.0f;
+
+		for (int size = 2; size <= M; size *= 2) {
+			int half = size / 2;
+			int step = M / size;
+
+			for (int start = 0; start < M; start += size) {
+				for (int k = 0; k < half; k++) {
+					float wr = Twiddle[2 * k * step];
+					float wi = sign * Twiddle[2 * k * step + 1];
+
+					float* a = z + 2 * (start + k);
+					float* b = z + 2 * (start + k + half);
+
+					float tr = wr * b[0] - wi * b[1];
+					float ti = wr * b[1] + wi * b[0];
+
+					b[0] = a[0] - tr;
+					b[1] = a[1] - ti;
+					a[0] += tr;
+					a[1] += ti;
+				}
+			}
+		}
+	}
+};
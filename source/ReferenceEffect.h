@@ -0,0 +1,314 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "CirculateHelpers.h"
+#include "CirculateParameters.h"
+#include "AllpassFilter.h"
+#include "Limiter.h"
+#include <algorithm>
+#include <vector>
+
+/// <summary>
+/// Scalar reference for CirculateEffect, frozen from the original per sample getBlock: one
+/// AllpassFilter per stage reading its coefficients through its AllpassInfo pointer, coefficients
+/// calculated every sample with the library tan and pow. No kernels, no control rate
+/// interpolation, no lanes, always double precision.
+///
+/// Sidechain modulation, chords and spread are applied the same way, every value evaluated
+/// exactly for every sample, so each optimised path of CirculateEffect has something to be
+/// measured against (see Conformance.h), held note chords too. The spectral engine isn't covered,
+/// Conformance.h checks it against the cascade here.
+///
+/// Slow on purpose. Don't optimise it or share code with the kernels, a change here changes what
+/// "correct" means for every path.
+/// </summary>
+class ReferenceEffect {
+public:
+	/// <summary>
+	/// Set up for a sample rate and stage limit (Depth covers 0 to the limit). Allocates, clears the memory
+	/// </summary>
+	void setup(HELPERS::SetupInfo Setup, int stageLimit) {
+		this->Setup = Setup;
+		mStageLimit = stageLimit;
+
+		// One filter and one set of coefficients for each stage of each bank, so spread stages can differ
+		Info.assign(BANK_LANES * stageLimit, AllpassFilter::AllpassInfo());
+		Filters.assign(BANK_LANES * stageLimit, AllpassFilter());
+		for (int i = 0; i < BANK_LANES * stageLimit; i++) {
+			Filters[i].setSampleRateBlockSize(Setup);
+			Filters[i].setStatePointer(&Info[i]);
+		}
+
+		FilterState.setSmoothTime(5, Setup.sampleRate);
+		NoteControlSmoother.setSmoothTime(25, Setup.sampleRate);
+		SidechainEnvelope.setTimes(2, 60, Setup.sampleRate);
+
+		double nyQuist = (Setup.sampleRate / 2.0f);
+		maxAllowedFreq = MAX_FREQ_HZ;
+		if (nyQuist < MAX_FREQ_HZ) maxAllowedFreq = nyQuist - 500.0f;
+
+		reset();
+	}
+
+	void reset() {
+		for (auto& Filter : Filters) {
+			Filter.resetState();
+		}
+		FilterState.force_snap = true;
+		SidechainEnvelope.reset();
+		currentSample = 0.0f;
+		for (int l = 0; l < BANK_LANES; l++) {
+			laneLastSamples[l] = 0.0f;
+		}
+	}
+
+	void getParams(CIRCULATE_PARAMS::AudioEffectParameters* Parameters) {
+		pParams = Parameters;
+	}
+
+	/// <summary>
+	/// Set the MIDI notes currently held, the bank centers in the held notes chord mode
+	/// </summary>
+	/// <param name="notes"> note numbers</param>
+	/// <param name="count"> number of notes, only the first BANK_LANES are used</param>
+	void setHeldNotes(const int* notes, int count) {
+		mNumHeldNotes = std::min(count, BANK_LANES);
+		for (int i = 0; i < mNumHeldNotes; i++) {
+			mHeldNoteHz[i] = HELPERS::noteNumToHz(notes[i]);
+		}
+	}
+
+	/// <summary>
+	/// Process a block, with the same parameter reads as CirculateEffect::getBlock
+	/// </summary>
+	void getBlock(const float* inBuffer, float* outBuffer, int numSamples, const float* sidechainBuffer = nullptr) {
+		mUseHzControl = pParams->CenterType.getLastValue() < 0.5f;
+		updateChordMode();
+
+		int numLanes = mChordActive ? BANK_LANES : 1;
+
+		for (int s = 0; s < numSamples; s++) {
+			// Get num stages (+0.5 for crude rounding), new stages start from cleared memory
+			int numStages = static_cast<int>(pParams->Depth.getSampleAccurateValue(s) * mStageLimit + 0.5);
+			if (numStages > mNumActiveStages) {
+				for (int l = 0; l < BANK_LANES; l++) {
+					for (int i = mNumActiveStages; i < numStages; i++) {
+						getFilter(l, i).resetState();
+					}
+				}
+			}
+			mNumActiveStages = numStages;
+
+			double centerHz = updateFrequency(s);
+
+			double focus = pParams->Focus.getSampleAccurateValue(s);
+			focus = focus * focus * focus;
+
+			double modOctaves = 0;
+			if (sidechainBuffer) {
+				double envelope = SidechainEnvelope.getNext(sidechainBuffer[s]);
+				double amount = (2.0 * pParams->Sidechain.getSampleAccurateValue(s)) - 1.0;
+				modOctaves = amount * MAX_SIDECHAIN_OCTAVES * envelope;
+			}
+
+			// Center g of each bank
+			double laneG[BANK_LANES];
+			if (mChordActive) {
+				for (int l = 0; l < BANK_LANES; l++) {
+					double laneHz = centerHz * mLaneRatio[l];
+					if (mUseHeldNotes) {
+						// Held notes can still be detuned with the note offset
+						laneHz = mHeldNoteHz[l % mNumHeldNotes] * pow(2.0, (2.0 * pParams->NoteOffset.getSampleAccurateValue(s)) - 1.0);
+					}
+					laneG[l] = getG(laneHz * pow(2.0, modOctaves));
+				}
+				AllpassFilter::calculateCoefficientsWithG(laneG[0], focus, FilterState);
+			}
+			else if (modOctaves != 0.0) {
+				AllpassFilter::calculateCoefficientsWithG(getG(centerHz * pow(2.0, modOctaves)), focus, FilterState);
+				laneG[0] = FilterState.g;
+			}
+			else {
+				AllpassFilter::calculateCoefficients(centerHz, focus, Setup.sampleRate, FilterState);
+				laneG[0] = FilterState.g;
+			}
+
+			double R = FilterState.k;
+
+			// Spread applies to the single bank
+			double spreadOctaves = mChordActive ? 0.0 : pParams->Spread.getSampleAccurateValue(s) * MAX_SPREAD_OCTAVES;
+			int shape = CIRCULATE_PARAMS::getSpreadShape(pParams->SpreadShape.getLastValue());
+
+			for (int l = 0; l < numLanes; l++) {
+				for (int i = 0; i < mNumActiveStages; i++) {
+					double g = laneG[l];
+					if (spreadOctaves > 0.0) {
+						g = getSpreadG(laneG[l], shape, i, spreadOctaves);
+					}
+					AllpassFilter::AllpassInfo& StageInfo = Info[l * mStageLimit + i];
+					StageInfo.g = g;
+					StageInfo.k = R;
+				}
+			}
+
+			double feedback = pParams->Feedback.getSampleAccurateValue(s);
+			if (abs(feedback - 0.5) < 0.1) {
+				feedback = 0.5;
+			}
+			feedback = (feedback - 0.5) * 1.98f;
+			if (mNumActiveStages == 0) {
+				feedback = 0;
+			}
+			float gain = sqrtf(1.0f - (abs(feedback) / 1.5f));
+
+			if (mChordActive) {
+				float out = 0.0f;
+				for (int l = 0; l < BANK_LANES; l++) {
+					float x = static_cast<float>(inBuffer[s] + (feedback * getLimitedSample(laneLastSamples[l]))) * gain;
+					for (int i = 0; i < mNumActiveStages; i++) {
+						x = getFilter(l, i).getNext(x);
+					}
+					laneLastSamples[l] = getLimitedSample(x);
+					double weight = (l < mNumBanks) ? 1.0 / mNumBanks : 0.0;
+					out += static_cast<float>(weight) * laneLastSamples[l];
+				}
+				outBuffer[s] = out;
+			}
+			else {
+				currentSample = getLimitedSample(currentSample);
+				currentSample = inBuffer[s] + (feedback * currentSample);
+				currentSample *= gain;
+
+				for (int i = 0; i < mNumActiveStages; i++) {
+					currentSample = getFilter(0, i).getNext(currentSample);
+				}
+
+				currentSample = getLimitedSample(currentSample);
+				outBuffer[s] = currentSample;
+			}
+		}
+	}
+
+private:
+	std::vector<AllpassFilter> Filters;
+	std::vector<AllpassFilter::AllpassInfo> Info;
+	int mStageLimit = 0;
+
+	CIRCULATE_PARAMS::AudioEffectParameters* pParams = nullptr;
+	AllpassFilter::AllpassInfo FilterState;
+	HELPERS::SetupInfo Setup;
+	HELPERS::ValueSmoother NoteControlSmoother;
+	HELPERS::EnvelopeFollower SidechainEnvelope;
+
+	int mNumActiveStages = 0;
+	bool mUseHzControl = true;
+	double maxAllowedFreq = 0;
+	float currentSample = 0;
+
+	bool mChordActive = false;
+	int mNumBanks = 1;
+	double mLaneRatio[BANK_LANES] = { 1.0, 1.0, 1.0, 1.0 };
+	float laneLastSamples[BANK_LANES] = {};
+
+	bool mUseHeldNotes = false;
+	double mHeldNoteHz[BANK_LANES] = {};
+	int mNumHeldNotes = 0;
+
+	AllpassFilter& getFilter(int lane, int stage) {
+		return Filters[lane * mStageLimit + stage];
+	}
+
+	/// <summary>
+	/// Exact g for a frequency, clamped to the allowed range
+	/// </summary>
+	double getG(double freqHz) const {
+		if (freqHz > maxAllowedFreq) {
+			freqHz = maxAllowedFreq;
+		}
+		if (freqHz < MIN_FREQ_HZ) {
+			freqHz = MIN_FREQ_HZ;
+		}
+		return tan((E_PI * freqHz) / (double)Setup.sampleRate);
+	}
+
+	/// <summary>
+	/// g of a spread stage, from the center g
+	/// </summary>
+	double getSpreadG(double centerG, int shape, int stage, double octaves) const {
+		double centerHz = atan(centerG) * Setup.sampleRate / E_PI;
+		double position = CIRCULATE_PARAMS::getSpreadPosition(shape, stage, mNumActiveStages);
+
+		double ratio = pow(2.0, position * octaves);
+		if (shape == CIRCULATE_PARAMS::kSpreadLinear) {
+			double low = pow(2.0, -0.5 * octaves);
+			double high = pow(2.0, 0.5 * octaves);
+			ratio = low + (high - low) * (position + 0.5);
+		}
+		return getG(centerHz * ratio);
+	}
+
+	/// <summary>
+	/// Chord mode per block. Entering, every bank continues from the single bank, leaving, the
+	/// single bank continues from the first
+	/// </summary>
+	void updateChordMode() {
+		int mode = CIRCULATE_PARAMS::getChordMode(pParams->Chord.getLastValue());
+		bool chord = mode != CIRCULATE_PARAMS::kChordOff;
+
+		mUseHeldNotes = (mode == CIRCULATE_PARAMS::kChordHeldNotes) && (mNumHeldNotes > 0);
+		mNumBanks = mUseHeldNotes ? mNumHeldNotes : CIRCULATE_PARAMS::chordSizes[mode];
+		for (int l = 0; l < BANK_LANES; l++) {
+			mLaneRatio[l] = (l < mNumBanks) ? pow(2.0, CIRCULATE_PARAMS::chordIntervals[mode][l] / 12.0) : 1.0;
+		}
+
+		if (chord && !mChordActive) {
+			for (int l = 1; l < BANK_LANES; l++) {
+				for (int i = 0; i < mStageLimit; i++) {
+					getFilter(l, i) = getFilter(0, i);
+					getFilter(l, i).setStatePointer(&Info[l * mStageLimit + i]);
+				}
+			}
+			for (int l = 0; l < BANK_LANES; l++) {
+				laneLastSamples[l] = currentSample;
+			}
+		}
+		if (!chord && mChordActive) {
+			currentSample = laneLastSamples[0];
+		}
+
+		mChordActive = chord;
+	}
+
+	double updateFrequency(int s) {
+		double freqHz = pParams->Center.getSampleAccurateValue(s);
+		if (freqHz < 0.0) {
+			freqHz = 0.0;
+		};
+		if (freqHz > 1.0){
+			freqHz = 1.0f;
+		};
+
+		freqHz = MIN_FREQ_HZ * std::pow(maxAllowedFreq / MIN_FREQ_HZ, freqHz);
+
+		if (!mUseHzControl) {
+			freqHz = pParams->Note.getSampleAccurateValue(s);
+			freqHz = HELPERS::noteNumToHz((freqHz * MAX_NOTE_NUM));
+
+			freqHz = NoteControlSmoother.getSmoothedValue(freqHz);
+
+			double noteOffset = pParams->NoteOffset.getSampleAccurateValue(s);
+			noteOffset = (2.0f * noteOffset) - 1;
+			freqHz = freqHz * pow(2.0, noteOffset);
+
+			if (freqHz > maxAllowedFreq) {
+				freqHz = maxAllowedFreq;
+			}
+			if (freqHz < MIN_FREQ_HZ) {
+				freqHz = MIN_FREQ_HZ;
+			}
+		}
+
+		return freqHz;
+	}
+};
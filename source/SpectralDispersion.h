@@ -0,0 +1,228 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "FFT.h"
+#include "Checkpoint.h"
+
+// Transform size, everything past the window is room for the dispersed tail of a frame
+#define SPECTRAL_FFT_SIZE 32768
+// Analysis window, also the latency of the engine
+#define SPECTRAL_WINDOW_SIZE 4096
+// Hop between frames (75 % overlap), the response is updated once per hop
+#define SPECTRAL_HOP_SIZE 1024
+// Stages at full depth, fractional stage counts are allowed
+#define SPECTRAL_MAX_STAGES 1024
+
+/// <summary>
+/// Spectral alternative to the allpass cascade, at a cost independent of the number of stages.
+///
+/// The cascade is N identical TPT SVF allpasses. The bilinear transform maps each exactly onto the
+/// analog prototype (s^2 - 2Rs + 1) / (s^2 + 2Rs + 1) at W = tan(w / 2) / g, so the phase of the
+/// whole cascade at bin frequency w is N * -2 atan2(2RW, 1 - W^2), from the same g and R
+/// (k) as AllpassFilter::calculateCoefficients. That phase is applied to every bin of a zero padded,
+/// Hann windowed frame and the frames are overlap added, which is linear convolution with the
+/// cascade's response for as long as the response stays within the padding.
+///
+/// The stage count is limited so the group delay at the center fits in the padding, the rest of
+/// the response is short enough to fit. Feedback, sidechain modulation and chords are not
+/// applied, this is the dispersion only.
+///
+/// Buffers are allocated by prepare, from setup.
+/// </summary>
+class SpectralDispersion {
+public:
+	void prepare() {
+		FFT.setSize(SPECTRAL_FFT_SIZE);
+
+		// Periodic Hann, sums to 2 at 75 % overlap
+		Window.resize(SPECTRAL_WINDOW_SIZE);
+		for (int i = 0; i < SPECTRAL_WINDOW_SIZE; i++) {
+			Window[i] = static_cast<float>(0.5 - 0.5 * cos(2.0 * 3.14159265358979323846 * i / SPECTRAL_WINDOW_SIZE));
+		}
+
+		// tan(w / 2) of every bin, the Nyquist bin is left very large (tan(pi / 2))
+		BinTan.resize(SPECTRAL_FFT_SIZE / 2 + 1);
+		for (int k = 0; k < SPECTRAL_FFT_SIZE / 2; k++) {
+			BinTan[k] = tan(3.14159265358979323846 * k / SPECTRAL_FFT_SIZE);
+		}
+		BinTan[SPECTRAL_FFT_SIZE / 2] = 1e12;
+
+		Input.assign(SPECTRAL_WINDOW_SIZE, 0.0f);
+		Accumulator.assign(SPECTRAL_FFT_SIZE, 0.0f);
+		Ready.assign(SPECTRAL_HOP_SIZE, 0.0f);
+		Frame.assign(SPECTRAL_FFT_SIZE, 0.0f);
+		Spectrum.assign(SPECTRAL_FFT_SIZE + 2, 0.0f);
+		Response.assign(SPECTRAL_FFT_SIZE + 2, 0.0f);
+
+		reset();
+	}
+
+	void reset() {
+		std::fill(Input.begin(), Input.end(), 0.0f);
+		std::fill(Accumulator.begin(), Accumulator.end(), 0.0f);
+		std::fill(Ready.begin(), Ready.end(), 0.0f);
+		position = 0;
+		responseValid = false;
+	}
+
+	/// <summary>
+	/// Write the buffers and response settings to a checkpoint. The response itself is rebuilt
+	/// </summary>
+	void saveState(CHECKPOINT::Writer& Out) const {
+		Out.write(Input.data(), Input.size());
+		Out.write(Accumulator.data(), Accumulator.size());
+		Out.write(Ready.data(), Ready.size());
+		Out.write(static_cast<int32_t>(position));
+		Out.write(mG);
+		Out.write(mR);
+		Out.write(mNumStages);
+	}
+
+	bool restoreState(CHECKPOINT::Reader& In) {
+		int32_t savedPosition = 0;
+		bool ok = In.read(Input.data(), Input.size()) && In.read(Accumulator.data(), Accumulator.size()) &&
+			In.read(Ready.data(), Ready.size()) && In.read(savedPosition) && In.read(mG) && In.read(mR) && In.read(mNumStages);
+		if (!ok || savedPosition < 0 || savedPosition >= SPECTRAL_HOP_SIZE) {
+			reset();
+			return false;
+		}
+		position = savedPosition;
+		responseValid = false;
+		responseDirty = true;
+		return true;
+	}
+
+	/// <summary>
+	/// Latency in samples, the same for every setting
+	/// </summary>
+	static int getLatency() {
+		return SPECTRAL_WINDOW_SIZE;
+	}
+
+	/// <summary>
+	/// Samples that can be processed before the next frame, the response set before then is
+	/// used for that frame
+	/// </summary>
+	int getSamplesToNextFrame() const {
+		return SPECTRAL_HOP_SIZE - position;
+	}
+
+	/// <summary>
+	/// Set the response for the next frame
+	/// </summary>
+	/// <param name="g"> Warped frequency coefficient, tan(pi * f / fs)</param>
+	/// <param name="R"> Damping (k)</param>
+	/// <param name="numStages"> Number of stages, limited to what the padding can hold</param>
+	void setResponse(double g, double R, double numStages) {
+		// Group delay of one stage at the center, in samples: (1 + g^2) / (R g)
+		double centerDelay = (1.0 + g * g) / (R * g);
+		double maxStages = (SPECTRAL_FFT_SIZE - SPECTRAL_WINDOW_SIZE) / centerDelay;
+		if (numStages > maxStages) {
+			numStages = maxStages;
+		}
+		if (numStages < 0.0) {
+			numStages = 0.0;
+		}
+
+		if (responseValid && g == mG && R == mR && numStages == mNumStages) {
+			return;
+		}
+
+		mG = g;
+		mR = R;
+		mNumStages = numStages;
+		responseDirty = true;
+	}
+
+	/// <summary>
+	/// Process samples, at most getSamplesToNextFrame so a run doesn't span a frame
+	/// </summary>
+	void process(const float* inBuffer, float* outBuffer, int numSamples) {
+		for (int i = 0; i < numSamples; i++) {
+			float x = inBuffer[i];
+			outBuffer[i] = Ready[position];
+			Input[SPECTRAL_WINDOW_SIZE - SPECTRAL_HOP_SIZE + position] = x;
+			position++;
+
+			if (position == SPECTRAL_HOP_SIZE) {
+				processFrame();
+				position = 0;
+			}
+		}
+	}
+
+private:
+	RealFFT FFT;
+	std::vector<float> Window;
+	std::vector<double> BinTan;
+
+	/// Last window of input, the newest hop at the end
+	std::vector<float> Input;
+	/// Overlap added output of every frame still sounding
+	std::vector<float> Accumulator;
+	/// Finished output for the current hop
+	std::vector<float> Ready;
+	std::vector<float> Frame;
+	std::vector<float> Spectrum;
+	/// Phase of the cascade per bin, interleaved cos and sin
+	std::vector<float> Response;
+
+	int position = 0;
+	double mG = 0.0;
+	double mR = 0.0;
+	double mNumStages = 0.0;
+	bool responseValid = false;
+	bool responseDirty = true;
+
+	void updateResponse() {
+		for (int k = 0; k <= SPECTRAL_FFT_SIZE / 2; k++) {
+			double W = BinTan[k] / mG;
+			double phase = -2.0 * mNumStages * atan2(2.0 * mR * W, 1.0 - W * W);
+
+			Response[2 * k] = static_cast<float>(cos(phase));
+			Response[2 * k + 1] = static_cast<float>(sin(phase));
+		}
+
+		responseValid = true;
+		responseDirty = false;
+	}
+
+	void processFrame() {
+		if (responseDirty || !responseValid) {
+			updateResponse();
+		}
+
+		for (int i = 0; i < SPECTRAL_WINDOW_SIZE; i++) {
+			Frame[i] = Input[i] * Window[i];
+		}
+		memset(Frame.data() + SPECTRAL_WINDOW_SIZE, 0, sizeof(float) * (SPECTRAL_FFT_SIZE - SPECTRAL_WINDOW_SIZE));
+
+		FFT.forward(Frame.data(), Spectrum.data());
+
+		for (int k = 0; k <= SPECTRAL_FFT_SIZE / 2; k++) {
+			float xr = Spectrum[2 * k], xi = Spectrum[2 * k + 1];
+			float hr = Response[2 * k], hi = Response[2 * k + 1];
+			Spectrum[2 * k] = xr * hr - xi * hi;
+			Spectrum[2 * k + 1] = xr * hi + xi * hr;
+		}
+
+		FFT.inverse(Spectrum.data(), Frame.data());
+
+		// Overlap add, 0.5 undoes the window overlap gain
+		for (int i = 0; i < SPECTRAL_FFT_SIZE; i++) {
+			Accumulator[i] += 0.5f * Frame[i];
+		}
+
+		// The first hop has had every frame that overlaps it
+		memcpy(Ready.data(), Accumulator.data(), sizeof(float) * SPECTRAL_HOP_SIZE);
+		memmove(Accumulator.data(), Accumulator.data() + SPECTRAL_HOP_SIZE, sizeof(float) * (SPECTRAL_FFT_SIZE - SPECTRAL_HOP_SIZE));
+		memset(Accumulator.data() + SPECTRAL_FFT_SIZE - SPECTRAL_HOP_SIZE, 0, sizeof(float) * SPECTRAL_HOP_SIZE);
+
+		memmove(Input.data(), Input.data() + SPECTRAL_HOP_SIZE, sizeof(float) * (SPECTRAL_WINDOW_SIZE - SPECTRAL_HOP_SIZE));
+	}
+};
@@ -0,0 +1,203 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+
+/// <summary>
+/// Optional scoped trace markers, compiled in with CIRCULATE_ENABLE_TRACE (CMake option of the
+/// same name). When disabled the macros expand to nothing.
+///
+/// CIRCULATE_TRACE_SCOPE("name") records the start and duration of the enclosing scope into a
+/// per thread buffer. Buffers are single writer rings, so markers don't lock.
+/// CIRCULATE_TRACE_RESERVE(n) allocates buffers ahead, off the audio thread (setupProcessing),
+/// so at least n are free. A thread takes a free buffer on its first marker without locking or
+/// allocating; a thread that finds none drops its markers until more are reserved.
+/// CIRCULATE_TRACE_EXPORT(path) writes every buffer as Chrome trace JSON (open in Perfetto or
+/// chrome://tracing). Export while no audio is being processed.
+///
+/// Names must be string literals, only the pointer is stored.
+/// </summary>
+
+// Environment variable holding the path the processor exports to on terminate
+#define TRACE_ENV_VARIABLE "CIRCULATE_TRACE"
+
+#ifdef CIRCULATE_ENABLE_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Events kept per thread, older events are overwritten
+#define TRACE_BUFFER_EVENTS (1 << 16)
+// Most threads traced over the lifetime of the module, buffers aren't given back when a thread ends
+#define TRACE_MAX_THREADS 64
+
+namespace TRACE {
+
+	struct Event {
+		const char* name = nullptr;
+		int64_t start = 0; // ns since the trace epoch
+		int64_t duration = 0;
+	};
+
+	inline int64_t now() {
+		static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	class ThreadBuffer {
+	public:
+		explicit ThreadBuffer(int index) : threadIndex(index), Events(TRACE_BUFFER_EVENTS) {}
+
+		void add(const char* name, int64_t start, int64_t duration) {
+			uint64_t n = count.load(std::memory_order_relaxed);
+			Event& E = Events[n % TRACE_BUFFER_EVENTS];
+			E.name = name;
+			E.start = start;
+			E.duration = duration;
+			count.store(n + 1, std::memory_order_release);
+		}
+
+		void writeJson(FILE* file, bool& first) const {
+			uint64_t n = count.load(std::memory_order_acquire);
+			uint64_t begin = n > TRACE_BUFFER_EVENTS ? n - TRACE_BUFFER_EVENTS : 0;
+
+			for (uint64_t i = begin; i < n; i++) {
+				const Event& E = Events[i % TRACE_BUFFER_EVENTS];
+				fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",", E.name, threadIndex, E.start / 1000.0, E.duration / 1000.0);
+				first = false;
+			}
+		}
+
+		void clear() {
+			count.store(0, std::memory_order_release);
+		}
+
+	private:
+		int threadIndex;
+		std::vector<Event> Events;
+		std::atomic<uint64_t> count { 0 };
+	};
+
+	/// <summary>
+	/// Owns every thread's buffer, for the lifetime of the module. Buffers are allocated by
+	/// reserve and taken in order by threads, so the ones below numTaken are in use
+	/// </summary>
+	class Registry {
+	public:
+		static Registry& get() {
+			static Registry Instance;
+			return Instance;
+		}
+
+		/// <summary>
+		/// Allocate buffers until at least numThreads are free (or TRACE_MAX_THREADS exist).
+		/// Allocates, not for the audio thread
+		/// </summary>
+		void reserve(int numThreads) {
+			now(); // starts the epoch here rather than on the first marker
+			std::lock_guard<std::mutex> lock(Mutex);
+			int numAllocated = allocated.load(std::memory_order_relaxed);
+			int target = std::min(taken.load(std::memory_order_acquire) + numThreads, TRACE_MAX_THREADS);
+
+			for (; numAllocated < target; numAllocated++) {
+				Buffers[numAllocated].reset(new ThreadBuffer(numAllocated));
+				allocated.store(numAllocated + 1, std::memory_order_release);
+			}
+		}
+
+		/// <summary>
+		/// Take a free buffer for the calling thread. Lock and allocation free
+		/// </summary>
+		/// <returns> nullptr if none is free</returns>
+		ThreadBuffer* takeBuffer() {
+			int index = taken.load(std::memory_order_relaxed);
+			while (index < allocated.load(std::memory_order_acquire)) {
+				if (taken.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel)) {
+					return Buffers[index].get();
+				}
+			}
+			return nullptr;
+		}
+
+		bool exportChromeTrace(const char* path) {
+			std::lock_guard<std::mutex> lock(Mutex);
+			FILE* file = fopen(path, "w");
+			if (!file) {
+				return false;
+			}
+
+			fprintf(file, "{\"traceEvents\":[");
+			bool first = true;
+			for (int i = 0; i < getNumTaken(); i++) {
+				Buffers[i]->writeJson(file, first);
+			}
+			fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+			fclose(file);
+			return true;
+		}
+
+		void clear() {
+			std::lock_guard<std::mutex> lock(Mutex);
+			for (int i = 0; i < getNumTaken(); i++) {
+				Buffers[i]->clear();
+			}
+		}
+
+	private:
+		int getNumTaken() const {
+			return std::min(taken.load(std::memory_order_acquire), allocated.load(std::memory_order_acquire));
+		}
+
+		std::mutex Mutex; // reserve and export
+		std::unique_ptr<ThreadBuffer> Buffers[TRACE_MAX_THREADS];
+		std::atomic<int> allocated { 0 };
+		std::atomic<int> taken { 0 };
+	};
+
+	/// <summary>
+	/// The calling thread's buffer, nullptr while none has been free for it
+	/// </summary>
+	inline ThreadBuffer* getThreadBuffer() {
+		thread_local ThreadBuffer* Buffer = nullptr;
+		if (!Buffer) {
+			Buffer = Registry::get().takeBuffer();
+		}
+		return Buffer;
+	}
+
+	class Scope {
+	public:
+		explicit Scope(const char* scopeName) : name(scopeName), start(now()) {}
+
+		~Scope() {
+			if (ThreadBuffer* Buffer = getThreadBuffer()) {
+				Buffer->add(name, start, now() - start);
+			}
+		}
+
+	private:
+		const char* name;
+		int64_t start;
+	};
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define CIRCULATE_TRACE_SCOPE(name) TRACE::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define CIRCULATE_TRACE_EXPORT(path) TRACE::Registry::get().exportChromeTrace(path)
+#define CIRCULATE_TRACE_RESERVE(numThreads) TRACE::Registry::get().reserve(numThreads)
+
+#else
+
+#define CIRCULATE_TRACE_SCOPE(name)
+#define CIRCULATE_TRACE_RESERVE(numThreads) static_cast<void>(numThreads)
+#define CIRCULATE_TRACE_EXPORT(path) (static_cast<void>(path), false)
+
+#endif
@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Small persistent pool of worker threads for offline rendering.
+///
+/// Threads are created by start (call from a non realtime thread, e.g. setupProcessing) and
+/// sleep until run is called. run hands out jobs by index, with job 0 on the calling thread,
+/// and returns once every job has finished. Jobs are a plain function pointer and context,
+/// so nothing is allocated per call.
+///
+/// Not for use in realtime mode, the calling thread blocks on the workers.
+/// </summary>
+class WorkerPool {
+public:
+	using JobFunction = void (*)(void* context, int jobIndex);
+
+	~WorkerPool() {
+		stop();
+	}
+
+	/// <summary>
+	/// Create the worker threads, stopping any already running
+	/// </summary>
+	/// <param name="numWorkers"> threads in addition to the calling thread</param>
+	void start(int numWorkers) {
+		stop();
+
+		quit = false;
+		// Workers wait for the generation to move on from here, so a run straight after start isn't missed
+		for (int i = 0; i < numWorkers; i++) {
+			Workers.emplace_back(&WorkerPool::workerLoop, this, i, generation);
+		}
+	}
+
+	/// <summary>
+	/// Join and destroy the worker threads
+	/// </summary>
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			quit = true;
+		}
+		StartCondition.notify_all();
+
+		for (auto& worker : Workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+		Workers.clear();
+	}
+
+	int getNumWorkers() const {
+		return static_cast<int>(Workers.size());
+	}
+
+	/// <summary>
+	/// Run jobs 0 to numJobs - 1 in parallel and wait for all of them.
+	/// Jobs beyond the number of workers + 1 are run on the calling thread.
+	/// </summary>
+	/// <param name="function"></param>
+	/// <param name="context"> passed to every job</param>
+	/// <param name="numJobs"></param>
+	void run(JobFunction function, void* context, int numJobs) {
+		int numParallel = numJobs - 1;
+		if (numParallel > getNumWorkers()) {
+			numParallel = getNumWorkers();
+		}
+
+		if (numParallel > 0) {
+			std::lock_guard<std::mutex> lock(Mutex);
+			Job = function;
+			JobContext = context;
+			numWorkerJobs = numParallel;
+			pendingJobs = numParallel;
+			generation++;
+		}
+		StartCondition.notify_all();
+
+		// Job 0, and anything the workers can't take, on this thread
+		function(context, 0);
+		for (int j = numParallel + 1; j < numJobs; j++) {
+			function(context, j);
+		}
+
+		if (numParallel > 0) {
+			std::unique_lock<std::mutex> lock(Mutex);
+			DoneCondition.wait(lock, [this] { return pendingJobs == 0; });
+		}
+	}
+
+private:
+	std::vector<std::thread> Workers;
+	std::mutex Mutex;
+	std::condition_variable StartCondition;
+	std::condition_variable DoneCondition;
+
+	JobFunction Job = nullptr;
+	void* JobContext = nullptr;
+	int numWorkerJobs = 0;
+	int pendingJobs = 0;
+	unsigned long long generation = 0;
+	bool quit = false;
+
+	void workerLoop(int workerIndex, unsigned long long startGeneration) {
+		unsigned long long lastGeneration = startGeneration;
+
+		while (true) {
+			JobFunction function = nullptr;
+			void* context = nullptr;
+			bool hasJob = false;
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				StartCondition.wait(lock, [this, lastGeneration] { return quit || generation != lastGeneration; });
+				if (quit) {
+					return;
+				}
+				lastGeneration = generation;
+				hasJob = workerIndex < numWorkerJobs;
+				function = Job;
+				context = JobContext;
+			}
+
+			if (!hasJob) {
+				continue;
+			}
+
+			// Worker i runs job i + 1, job 0 is on the calling thread
+			function(context, workerIndex + 1);
+
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				pendingJobs--;
+			}
+			DoneCondition.notify_one();
+		}
+	}
+};
@@ -31,6 +31,8 @@ tresult PLUGIN_API CirculateController::initialize (FUnknown* context)
 
 	CIRCULATE_PARAMS::registerParameters(parameters);
 
+	SharedUIDescription::retain();
+
 	setKnobMode(Steinberg::Vst::KnobModes::kLinearMode);
 	
 	return result;
@@ -40,6 +42,7 @@ tresult PLUGIN_API CirculateController::initialize (FUnknown* context)
 tresult PLUGIN_API CirculateController::terminate ()
 {
 	// Here the Plug-in will be de-instantiated, last possibility to remove some memory!
+	SharedUIDescription::release();
 
 	//---do not forget to call parent ------
 	return EditControllerEx1::terminate ();
@@ -65,22 +68,89 @@ tresult PLUGIN_API CirculateController::setComponentState (IBStream* state)
 	if (streamer.readDouble(offset) == false) return kResultFalse;
 	if (streamer.readDouble(bypass) == false) return kResultFalse;
 	if (streamer.readDouble(feed) == false) return kResultFalse;
+	// Added after version 2, older states end before some of them
+	double stereo = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_STEREO);
+	double sidechain = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_SIDECHAIN);
+	double chord = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_CHORD);
+	double precision = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_PRECISION);
+	double engine = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_ENGINE);
+	double spread = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_SPREAD);
+	double spreadShape = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_SPREAD_SHAPE);
+	double stageLimit = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_STAGE_LIMIT);
+	double bandSplit = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_BAND_SPLIT);
 	
 	// Update the controller's parameter objects.
+	settingComponentState = true;
 	setParamNormalized(CIRCULATE_PARAMS::kDepth, depth);
 	setParamNormalized(CIRCULATE_PARAMS::kCenter, center);
 	setParamNormalized(CIRCULATE_PARAMS::kCenterST, note);
+	setParamNormalized(CIRCULATE_PARAMS::kPlayedNote, note);
 	setParamNormalized(CIRCULATE_PARAMS::kFocus, focus);
 	setParamNormalized(CIRCULATE_PARAMS::kSetSwitch, type);
 	setParamNormalized(CIRCULATE_PARAMS::kNoteOffset, offset);
 	setParamNormalized(CIRCULATE_PARAMS::kBypass, bypass);
 	setParamNormalized(CIRCULATE_PARAMS::kFeed, feed);
+	setParamNormalized(CIRCULATE_PARAMS::kStereo, stereo);
+	setParamNormalized(CIRCULATE_PARAMS::kSidechain, sidechain);
+	setParamNormalized(CIRCULATE_PARAMS::kChord, chord);
+	setParamNormalized(CIRCULATE_PARAMS::kPrecision, precision);
+	setParamNormalized(CIRCULATE_PARAMS::kEngine, engine);
+	setParamNormalized(CIRCULATE_PARAMS::kSpread, spread);
+	setParamNormalized(CIRCULATE_PARAMS::kSpreadShape, spreadShape);
+	setParamNormalized(CIRCULATE_PARAMS::kStageLimit, stageLimit);
+	setParamNormalized(CIRCULATE_PARAMS::kBandSplit, bandSplit);
+
+	settingComponentState = false;
 
 	updateSwitchState(type);
 
 	return kResultOk;
 }
 
+//------------------------------------------------------------------------
+tresult PLUGIN_API CirculateController::setParamNormalized (Vst::ParamID tag, Vst::ParamValue value)
+{
+	// The processor reports a new latency (engine or band split changed), ask the host to query it
+	bool latencyChanged = (tag == CIRCULATE_PARAMS::kLatency) && (value != getParamNormalized(tag));
+
+	// The processor has a new Stage Limit and needs reactivating to size its memory for it
+	bool restartRequested = (tag == CIRCULATE_PARAMS::kRestartRequest) && (value != getParamNormalized(tag));
+
+	bool stageLimitChanged = (tag == CIRCULATE_PARAMS::kStageLimit) && (value != getParamNormalized(tag));
+
+	tresult result = EditControllerEx1::setParamNormalized(tag, value);
+
+	// The display shows a new Note setting straight away, the processor reports MIDI notes over it
+	if (tag == CIRCULATE_PARAMS::kCenterST) {
+		EditControllerEx1::setParamNormalized(CIRCULATE_PARAMS::kPlayedNote, value);
+	}
+
+	int32 flags = 0;
+	if (latencyChanged) {
+		flags |= Vst::kLatencyChanged;
+	}
+	if (restartRequested) {
+		// Hosts reactivate the plug-in after an IO change, the processor sizes its memory in setActive
+		flags |= Vst::kIoChanged;
+	}
+	if (stageLimitChanged) {
+		// Depth's range stays the same, only the number of stages it shows follows the limit
+		if (auto* depthParam = dynamic_cast<DepthParameter*>(getParameterObject(CIRCULATE_PARAMS::kDepth))) {
+			depthParam->setStageLimit(CIRCULATE_PARAMS::getStageLimit(value));
+			depthParam->changed();
+		}
+		// Hosts showing Depth's value text read it again, they reread everything when loading a state anyway
+		if (!settingComponentState) {
+			flags |= Vst::kParamValuesChanged;
+		}
+	}
+
+	if (flags != 0 && componentHandler) {
+		componentHandler->restartComponent(flags);
+	}
+	return result;
+}
+
 //------------------------------------------------------------------------
 tresult PLUGIN_API CirculateController::setState (IBStream* state)
 {
@@ -134,7 +204,13 @@ IPlugView* PLUGIN_API CirculateController::createView (FIDString name)
 	{
 
 
-		currentEditor = new CustomEditor (this, "view", "editor.uidesc");
+		// Parsed once and shared between editors, parsed here if that failed or with live editing
+		if (auto* description = SharedUIDescription::get("editor.uidesc")) {
+			currentEditor = new CustomEditor (description, this, "view", "editor.uidesc");
+		}
+		else {
+			currentEditor = new CustomEditor (this, "view", "editor.uidesc");
+		}
 		auto* customEditor = static_cast<CustomEditor*>(currentEditor);
 		if (customEditor) {
 			// Update editor
@@ -34,6 +34,7 @@ public:
 
 	//--- from EditController --------------------------------------------
 	Steinberg::tresult PLUGIN_API setComponentState (Steinberg::IBStream* state) SMTG_OVERRIDE;
+	Steinberg::tresult PLUGIN_API setParamNormalized (Steinberg::Vst::ParamID tag, Steinberg::Vst::ParamValue value) SMTG_OVERRIDE;
 	Steinberg::IPlugView* PLUGIN_API createView (Steinberg::FIDString name) SMTG_OVERRIDE;
 	Steinberg::tresult PLUGIN_API setState (Steinberg::IBStream* state) SMTG_OVERRIDE;
 	Steinberg::tresult PLUGIN_API getState (Steinberg::IBStream* state) SMTG_OVERRIDE;
@@ -87,6 +88,7 @@ protected:
 	float currentZoomFactor = 1.0;
 	const int kZoomFactorID = 201;
 	bool switchIsHzState = true;
+	bool settingComponentState = false; // setParamNormalized called from setComponentState
 
 	VSTGUI::VST3Editor* currentEditor = nullptr;
 };
@@ -7,6 +7,13 @@
 #include "pluginterfaces/vst/ivstparameterchanges.h"
 #include "base/source/fstreamer.h"
 #include "DenormalProtection.h"
+#include "Trace.h"
+#include <cstdlib>
+
+// Mean square below which the side channel is treated as silent in M/S mode (-100 dB)
+#define SIDE_SILENCE_THRESHOLD 1e-10f
+// Max difference in filter memory for the right channel to be considered in sync with the left
+#define CHANNEL_SYNC_TOLERANCE 1e-7
 
 using namespace Steinberg;
 
@@ -47,23 +54,46 @@ tresult PLUGIN_API CirculateProcessor::initialize (FUnknown* context)
 	addAudioInput (STR16 ("Stereo In"), Steinberg::Vst::SpeakerArr::kStereo);
 	addAudioOutput (STR16 ("Stereo Out"), Steinberg::Vst::SpeakerArr::kStereo);
 
+	// Optional sidechain, its envelope modulates the center frequency
+	addAudioInput (STR16 ("Sidechain"), Steinberg::Vst::SpeakerArr::kStereo, Steinberg::Vst::kAux, 0);
+
+	// MIDI notes set the center when in note mode
+	addEventInput (STR16 ("MIDI In"), 1);
+
 	return kResultOk;
 }
 
 tresult PLUGIN_API CirculateProcessor::setBusArrangements(Steinberg::Vst::SpeakerArrangement* inputs, int32 numIns, Steinberg::Vst::SpeakerArrangement* outputs, int32 numOuts) 
 {
-	// Only allow mono or stereo, with one bus either way
-	if (numIns == 1 && numOuts == 1 && inputs[0] == outputs[0] &&
-		(inputs[0] == Steinberg::Vst::SpeakerArr::kMono || inputs[0] == Steinberg::Vst::SpeakerArr::kStereo))
+	// Only allow mono or stereo, with one main bus either way
+	if (numIns < 1 || numIns > 2 || numOuts != 1) {
+		return kResultFalse;
+	}
+	if (inputs[0] != outputs[0] ||
+		!(inputs[0] == Steinberg::Vst::SpeakerArr::kMono || inputs[0] == Steinberg::Vst::SpeakerArr::kStereo))
 	{
-		return AudioEffect::setBusArrangements(inputs, numIns, outputs, numOuts);
+		return kResultFalse;
 	}
-	return kResultFalse;
+	// Sidechain can be mono or stereo
+	if (numIns == 2 && 
+		!(inputs[1] == Steinberg::Vst::SpeakerArr::kMono || inputs[1] == Steinberg::Vst::SpeakerArr::kStereo))
+	{
+		return kResultFalse;
+	}
+	return AudioEffect::setBusArrangements(inputs, numIns, outputs, numOuts);
 }
 
 //------------------------------------------------------------------------
 tresult PLUGIN_API CirculateProcessor::terminate ()
 {
+	OfflinePool.stop();
+	Recorder.stop();
+
+	// Trace builds write the markers out when CIRCULATE_TRACE is set
+	if (const char* tracePath = getenv(TRACE_ENV_VARIABLE)) {
+		CIRCULATE_TRACE_EXPORT(tracePath);
+	}
+
 	// Here the Plug-in will be de-instantiated, last possibility to remove some memory!
 	
 	//---do not forget to call parent ------
@@ -75,7 +105,9 @@ Steinberg::tresult PLUGIN_API CirculateProcessor::setProcessing(Steinberg::TBool
 	if (state) {
 		AudioEffect[0].reset();
 		AudioEffect[1].reset();
-
+		rightFollowsLeft = true;
+		sideSkipped = false;
+		numHeldNotes = 0;
 	}
 
 	return AudioEffect::setProcessing(state);
@@ -85,8 +117,15 @@ Steinberg::tresult PLUGIN_API CirculateProcessor::setProcessing(Steinberg::TBool
 tresult PLUGIN_API CirculateProcessor::setActive (TBool state)
 {
 	if (state) {
+		applyStageLimit();
 		AudioEffect[0].reset();
 		AudioEffect[1].reset();
+		rightFollowsLeft = true;
+		sideSkipped = false;
+		if (Params) {
+			Params->clearMidiNote();
+		}
+		requestedStageLimit = 0;
 	}
 	return AudioEffect::setActive (state);
 }
@@ -96,15 +135,16 @@ tresult PLUGIN_API CirculateProcessor::process (Vst::ProcessData& data)
 {
 
 	DenormalHandler AntiDenormal;
+	CIRCULATE_TRACE_SCOPE("process");
 
-	// Pre-Fill param values with last value (to prevent previous
-	// block being re-read
-	if (Params) {
-		Params->setCurrentBlockSizeAndPreFill(data.numSamples);
+	if (Recorder.isActive()) {
+		CIRCULATE_TRACE_SCOPE("capture");
+		Recorder.recordBlock(data);
 	}
 
 	if (data.inputParameterChanges)
 	{
+		CIRCULATE_TRACE_SCOPE("queue decode");
 		int32 numParamsChanged = data.inputParameterChanges->getParameterCount();
 		for (int32 index = 0; index < numParamsChanged; index++)
 		{
@@ -129,71 +169,490 @@ tresult PLUGIN_API CirculateProcessor::process (Vst::ProcessData& data)
 					continue;
 				}
 
-				Params->getParamChangesThisBlock(paramQueue, paramQueue->getParameterId(), data.numSamples);
+				// Points are read a chunk at a time below
+				if (Params) {
+					Params->setParamQueue(paramQueue);
+				}
 			}
 			
 		}
 	}
 
-	// Smooth all parameter blocks even if no new changes received, so that smoothing crosses
-	// block boundaries
+	// Note on events, after parameter changes so they take priority
+	if (data.inputEvents) {
+		updateHeldNotes(data.inputEvents);
+	}
+	AudioEffect[0].setHeldNotes(HeldNotes, numHeldNotes);
+	AudioEffect[1].setHeldNotes(HeldNotes, numHeldNotes);
+
+	int numChan = 0;
+	int numOutChan = 0;
+
+	if (data.numInputs && data.numOutputs) {
+		numOutChan = data.outputs[0].numChannels;
+		int numInChan = data.inputs[0].numChannels;
+
+		numChan = std::min<int>(numInChan, numOutChan);
+	}
+
+	offlineRender = (data.processMode == Vst::kOffline);
+
+	if (offlineRender && canProcessOfflineBlock(data, numChan)) {
+		processOfflineBlock(data, numOutChan);
+	}
+	else {
+		// Work through the host block in fixed chunks, so the parameter values, coefficients and audio
+		// of a chunk stay in cache, and no buffer depends on the host's block size
+		for (int chunkStart = 0; chunkStart < data.numSamples; chunkStart += PROCESS_CHUNK_SIZE) {
+			int numSamples = std::min<int>(PROCESS_CHUNK_SIZE, data.numSamples - chunkStart);
+
+			updateChunkParameters(data, chunkStart, numSamples);
+
+			// Return if either in or out have zero channels
+			if (numChan == 0) {
+				continue;
+			}
+
+			processChunk(data, chunkStart, numSamples, numChan, numOutChan);
+		}
+	}
+
 	if (Params) {
-		Params->smoothAllParameters();
+		Params->finishParamQueues();
 	}
 
- 	if (!data.numInputs) {
-		return kResultOk;
+	// Let the note display follow MIDI, through its own output parameter so the Note setting is untouched
+	if (Params && Params->getPlayedNote() != reportedPlayedNote && data.outputParameterChanges) {
+		int32 queueIndex = 0;
+		if (auto* queue = data.outputParameterChanges->addParameterData(CIRCULATE_PARAMS::kPlayedNote, queueIndex)) {
+			int32 pointIndex = 0;
+			reportedPlayedNote = Params->getPlayedNote();
+			queue->addPoint(0, reportedPlayedNote, pointIndex);
+		}
 	}
-	if (!data.numOutputs) {
-		return kResultOk;
+
+	// The processor can't restart the component itself, the controller does when kLatency changes
+	int latency = getCurrentLatency();
+	if (latency != reportedLatency && data.outputParameterChanges) {
+		int32 queueIndex = 0;
+		if (auto* queue = data.outputParameterChanges->addParameterData(CIRCULATE_PARAMS::kLatency, queueIndex)) {
+			int32 pointIndex = 0;
+			// Alternates, so every change is seen, also from one non zero latency to another
+			reportedLatencyValue = 1.0 - reportedLatencyValue;
+			queue->addPoint(0, reportedLatencyValue, pointIndex);
+			reportedLatency = latency;
+		}
 	}
 
-	int numChan = 0;
-	int numBus = 1;
+	// A new Stage Limit is applied in setActive, memory can't be allocated here. Once per new limit
+	// (the processor has the value now, so the reactivation that follows sees it)
+	int stageLimit = Params ? CIRCULATE_PARAMS::getStageLimit(Params->StageLimit.getLastValue()) : 0;
+	if (Params && stageLimit != AudioEffect[0].getStageLimit() && stageLimit != requestedStageLimit && data.outputParameterChanges) {
+		int32 queueIndex = 0;
+		if (auto* queue = data.outputParameterChanges->addParameterData(CIRCULATE_PARAMS::kRestartRequest, queueIndex)) {
+			int32 pointIndex = 0;
+			reportedRestartValue = 1.0 - reportedRestartValue;
+			queue->addPoint(0, reportedRestartValue, pointIndex);
+			requestedStageLimit = stageLimit;
+		}
+	}
+
+	return kResultOk;
+}
 
-	int numOutChan = data.outputs[0].numChannels;
-	int numInChan = data.inputs[0].numChannels;
+//------------------------------------------------------------------------
+int CirculateProcessor::getCurrentLatency() const
+{
+	// Both channels use the same engine and band split
+	return AudioEffect[0].getLatency();
+}
 
-	numChan = std::min<int>(numInChan, numOutChan);
+//------------------------------------------------------------------------
+uint32 PLUGIN_API CirculateProcessor::getLatencySamples ()
+{
+	return static_cast<uint32>(getCurrentLatency());
+}
 
-	// Return if either in or out have zero channels
-	if (numChan == 0) {
-		return kResultOk;
+//------------------------------------------------------------------------
+void CirculateProcessor::updateChunkParameters(Vst::ProcessData& data, int chunkStart, int numSamples)
+{
+	if (!Params) {
+		return;
+	}
+
+	CIRCULATE_TRACE_SCOPE("parameters");
+
+	// Pre-Fill param values with last value (to prevent previous
+	// chunk being re-read
+	Params->setCurrentBlockSizeAndPreFill(numSamples);
+	Params->readParamChanges(chunkStart, numSamples);
+
+	Params->applyMidiNotes(data.inputEvents, data.numSamples, chunkStart, numSamples);
+
+	// Smooth all parameter chunks even if no new changes received, so that smoothing crosses
+	// chunk boundaries
+	Params->smoothAllParameters();
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::processChunk(Vst::ProcessData& data, int chunkStart, int numSamples, int numChan, int numOutChan)
+{
+	ChunkBuffers Chunk;
+	Chunk.numSamples = numSamples;
+
+	for (int c = 0; c < numChan && c < 2; c++) {
+		Chunk.in[c] = data.inputs[0].channelBuffers32[c] + chunkStart;
+		Chunk.out[c] = data.outputs[0].channelBuffers32[c] + chunkStart;
 	}
 
 	// If bypassed, copy in to out
 	if (isBypassed) {
+		CIRCULATE_TRACE_SCOPE("channel copy");
 		for (int c = 0; c < numChan; c++) {
-			float* in = data.inputs[0].channelBuffers32[c];
-			float* out = data.outputs[0].channelBuffers32[c];
+			float* in = data.inputs[0].channelBuffers32[c] + chunkStart;
+			float* out = data.outputs[0].channelBuffers32[c] + chunkStart;
 
 			if (in != out) {
-				memcpy(out, in, sizeof(float) * data.numSamples);
+				memcpy(out, in, sizeof(float) * numSamples);
 			}
 
 		}
-		return kResultOk;
+		return;
 	}
 
-	if (data.numSamples > 0)
-	{
+	Chunk.sidechain = getSidechain(data, chunkStart, numSamples);
 
-		for (int c = 0; c < numChan; c++) {
-			float* in = data.inputs[0].channelBuffers32[c];
-			float* out = data.outputs[0].channelBuffers32[c];
+	bool useMidSide = Params && (Params->StereoMode.getLastValue() >= 0.5);
+
+	// Switching between L/R and M/S changes what channel 1 holds, continue from 
+	// channel 0's state rather than the unrelated old one
+	if (useMidSide != lastUseMidSide) {
+		AudioEffect[1].copyStateFrom(AudioEffect[0]);
+		rightFollowsLeft = false;
+		sideSkipped = false;
+		lastUseMidSide = useMidSide;
+	}
+
+	// Number of output channels written by the effect, the rest are copied from channel 0
+	int numProcessedChan = numChan;
 
-				AudioEffect[c].getBlock(in, out, data.numSamples);
+	if (numChan == 2 && useMidSide) {
+		numProcessedChan = processMidSide(Chunk);
+	}
+	else if (numChan == 2) {
+		numProcessedChan = processLeftRight(Chunk);
+	}
+	else {
+		AudioEffect[0].getBlock(Chunk.in[0], Chunk.out[0], numSamples, Chunk.sidechain);
+	}
 
+	if (numOutChan > numProcessedChan) {
+		CIRCULATE_TRACE_SCOPE("channel copy");
+		for (int c = numProcessedChan; c < numOutChan; c++) {
+			memcpy(data.outputs[0].channelBuffers32[c] + chunkStart, Chunk.out[0], sizeof(float) * numSamples);
 		}
 	}
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::updateHeldNotes(Vst::IEventList* events)
+{
+	int32 numEvents = events->getEventCount();
+
+	for (int32 e = 0; e < numEvents; e++) {
+		Vst::Event event;
+		if (events->getEvent(e, event) != kResultOk) {
+			continue;
+		}
 
-	if (numOutChan > numInChan) {
-		for (int c = numChan; c < numOutChan; c++) {
-			memcpy(data.outputs[0].channelBuffers32[c], data.outputs[0].channelBuffers32[0], sizeof(float) * data.numSamples);
+		bool isNoteOn = (event.type == Vst::Event::kNoteOnEvent) && (event.noteOn.velocity > 0);
+		bool isNoteOff = (event.type == Vst::Event::kNoteOffEvent) || 
+			((event.type == Vst::Event::kNoteOnEvent) && (event.noteOn.velocity <= 0));
+		if (!isNoteOn && !isNoteOff) {
+			continue;
+		}
+		int pitch = (event.type == Vst::Event::kNoteOnEvent) ? event.noteOn.pitch : event.noteOff.pitch;
+
+		// Remove the note if already held, a repeated note on moves it to the end
+		for (int i = 0; i < numHeldNotes; i++) {
+			if (HeldNotes[i] == pitch) {
+				for (int j = i; j < numHeldNotes - 1; j++) {
+					HeldNotes[j] = HeldNotes[j + 1];
+				}
+				numHeldNotes--;
+				break;
+			}
+		}
+
+		if (isNoteOn) {
+			// Drop the oldest when full
+			if (numHeldNotes == BANK_LANES) {
+				for (int j = 0; j < numHeldNotes - 1; j++) {
+					HeldNotes[j] = HeldNotes[j + 1];
+				}
+				numHeldNotes--;
+			}
+			HeldNotes[numHeldNotes++] = pitch;
 		}
 	}
+}
 
-	return kResultOk;
+//------------------------------------------------------------------------
+void CirculateProcessor::processChannelPair(const ChunkBuffers& Chunk, float* in0, float* out0, float* in1, float* out1)
+{
+	ChannelJobs[0] = { &AudioEffect[0], in0, out0, Chunk.numSamples, Chunk.sidechain };
+	ChannelJobs[1] = { &AudioEffect[1], in1, out1, Chunk.numSamples, Chunk.sidechain };
+
+	// Only fan out when rendering offline, in realtime the host thread mustn't wait on other threads
+	if (offlineRender && OfflinePool.getNumWorkers() > 0) {
+		OfflinePool.run(&CirculateProcessor::runChannelJob, ChannelJobs, 2);
+		return;
+	}
+
+	runChannelJob(ChannelJobs, 0);
+	runChannelJob(ChannelJobs, 1);
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::runChannelJob(void* context, int jobIndex)
+{
+	// Workers need their own denormal flags
+	DenormalHandler AntiDenormal;
+	CIRCULATE_TRACE_SCOPE("channel");
+
+	ChannelJob& Job = static_cast<ChannelJob*>(context)[jobIndex];
+
+	// One chunk, or a run of them with their own parameters
+	for (int chunk = 0, chunkStart = 0; chunkStart < Job.numSamples; chunk++, chunkStart += PROCESS_CHUNK_SIZE) {
+		int numSamples = std::min<int>(PROCESS_CHUNK_SIZE, Job.numSamples - chunkStart);
+		if (Job.chunkParams) {
+			Job.effect->getParams(Job.chunkParams[chunk].get());
+		}
+		Job.effect->getBlock(Job.in + chunkStart, Job.out + chunkStart, numSamples, Job.sidechain ? Job.sidechain + chunkStart : nullptr);
+	}
+}
+
+//------------------------------------------------------------------------
+const float* CirculateProcessor::getSidechain(Vst::ProcessData& data, int chunkStart, int numSamples)
+{
+	if (data.numInputs < 2 || data.inputs[1].numChannels == 0 || !data.inputs[1].channelBuffers32) {
+		return nullptr;
+	}
+
+	CIRCULATE_TRACE_SCOPE("sidechain");
+
+	// Sum to mono so every channel (and mid/side) is modulated the same
+	float* scL = data.inputs[1].channelBuffers32[0] + chunkStart;
+	float* scR = (data.inputs[1].numChannels > 1) ? data.inputs[1].channelBuffers32[1] + chunkStart : scL;
+
+	for (int i = 0; i < numSamples; i++) {
+		SidechainBuffer[i] = 0.5f * (scL[i] + scR[i]);
+	}
+
+	return SidechainBuffer;
+}
+
+//------------------------------------------------------------------------
+int CirculateProcessor::processLeftRight(const ChunkBuffers& Chunk)
+{
+	float* inL = Chunk.in[0];
+	float* inR = Chunk.in[1];
+	float* outL = Chunk.out[0];
+	float* outR = Chunk.out[1];
+
+	if (HELPERS::buffersIdentical(inL, inR, Chunk.numSamples)) {
+		// Dual mono. If the right channel's state matches the left, only the left needs
+		// processing, the right output is copied from it
+		if (rightFollowsLeft) {
+			AudioEffect[0].getBlock(inL, outL, Chunk.numSamples, Chunk.sidechain);
+			return 1;
+		}
+
+		processChannelPair(Chunk, inL, outL, inR, outR);
+
+		// Once the tails of earlier, different input have died away the right channel
+		// can follow the left
+		rightFollowsLeft = AudioEffect[1].isStateCloseTo(AudioEffect[0], CHANNEL_SYNC_TOLERANCE);
+		return 2;
+	}
+
+	if (rightFollowsLeft) {
+		// The right effect was skipped, pick up from the left's state
+		AudioEffect[1].copyStateFrom(AudioEffect[0]);
+		rightFollowsLeft = false;
+	}
+
+	processChannelPair(Chunk, inL, outL, inR, outR);
+
+	return 2;
+}
+
+//------------------------------------------------------------------------
+int CirculateProcessor::processMidSide(const ChunkBuffers& Chunk)
+{
+	float* inL = Chunk.in[0];
+	float* inR = Chunk.in[1];
+	float* outL = Chunk.out[0];
+	float* outR = Chunk.out[1];
+	int numSamples = Chunk.numSamples;
+
+	// Encode to mid/side in the output buffers
+	encodeMidSide(inL, inR, outL, outR, numSamples);
+
+	float sideEnergy = HELPERS::meanSquare(outR, numSamples);
+
+	if (sideEnergy < SIDE_SILENCE_THRESHOLD && sideSkipped) {
+		// Side is silent, output the mid on both channels
+		AudioEffect[0].getBlock(outL, outL, numSamples, Chunk.sidechain);
+		return 1;
+	}
+
+	if (sideSkipped) {
+		// Side is back, it has been silent, so start from cleared memory
+		AudioEffect[1].reset();
+		sideSkipped = false;
+	}
+
+	processChannelPair(Chunk, outL, outL, outR, outR);
+
+	// Only skip once the side input and the tail of the side path have both gone quiet
+	if (sideEnergy < SIDE_SILENCE_THRESHOLD && HELPERS::meanSquare(outR, numSamples) < SIDE_SILENCE_THRESHOLD) {
+		sideSkipped = true;
+	}
+
+	decodeMidSide(outL, outR, numSamples);
+
+	return 2;
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::encodeMidSide(const float* inL, const float* inR, float* outM, float* outS, int numSamples)
+{
+	CIRCULATE_TRACE_SCOPE("mid/side");
+
+	// Read both inputs before writing as processing may be in place
+	for (int i = 0; i < numSamples; i++) {
+		float L = inL[i];
+		float R = inR[i];
+		outM[i] = 0.5f * (L + R);
+		outS[i] = 0.5f * (L - R);
+	}
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::decodeMidSide(float* M, float* S, int numSamples)
+{
+	CIRCULATE_TRACE_SCOPE("mid/side");
+
+	for (int i = 0; i < numSamples; i++) {
+		float mid = M[i];
+		float side = S[i];
+		M[i] = mid + side;
+		S[i] = mid - side;
+	}
+}
+
+//------------------------------------------------------------------------
+bool CirculateProcessor::canProcessOfflineBlock(const Vst::ProcessData& data, int numChan) const
+{
+	// Bypass and mono go through the chunks as in realtime, there is nothing to run in parallel
+	return Params && numChan == 2 && !isBypassed && OfflinePool.getNumWorkers() > 0 &&
+		data.numSamples <= static_cast<int>(OfflineChunkParams.size()) * PROCESS_CHUNK_SIZE;
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::processOfflineBlock(Vst::ProcessData& data, int numOutChan)
+{
+	int numChunks = (data.numSamples + PROCESS_CHUNK_SIZE - 1) / PROCESS_CHUNK_SIZE;
+	const float* sidechain = nullptr;
+	int firstChunk = 0;
+	bool runMidSide = false;
+
+	// The parameters of every chunk first, on this thread, as they are read from the host's queues
+	// in order. The channels then work through their chunks from the copies
+	for (int chunk = 0; chunk < numChunks; chunk++) {
+		int chunkStart = chunk * PROCESS_CHUNK_SIZE;
+		int numSamples = std::min<int>(PROCESS_CHUNK_SIZE, data.numSamples - chunkStart);
+
+		updateChunkParameters(data, chunkStart, numSamples);
+
+		// Switching stereo mode hands state between the channels, the chunks before it go first
+		bool useMidSide = Params->StereoMode.getLastValue() >= 0.5;
+		if (chunk > firstChunk && useMidSide != runMidSide) {
+			processOfflineRun(data, firstChunk, chunk, runMidSide, sidechain, numOutChan);
+			firstChunk = chunk;
+		}
+		runMidSide = useMidSide;
+
+		OfflineChunkParams[chunk]->copyChunkFrom(*Params);
+
+		if (const float* chunkSidechain = getSidechain(data, chunkStart, numSamples)) {
+			memcpy(OfflineSidechain.data() + chunkStart, chunkSidechain, sizeof(float) * numSamples);
+			sidechain = OfflineSidechain.data();
+		}
+	}
+
+	if (numChunks > firstChunk) {
+		processOfflineRun(data, firstChunk, numChunks, runMidSide, sidechain, numOutChan);
+	}
+}
+
+//------------------------------------------------------------------------
+void CirculateProcessor::processOfflineRun(Vst::ProcessData& data, int firstChunk, int endChunk, bool useMidSide, const float* sidechain, int numOutChan)
+{
+	int start = firstChunk * PROCESS_CHUNK_SIZE;
+	int numSamples = std::min<int>(endChunk * PROCESS_CHUNK_SIZE, data.numSamples) - start;
+
+	float* inL = data.inputs[0].channelBuffers32[0] + start;
+	float* inR = data.inputs[0].channelBuffers32[1] + start;
+	float* outL = data.outputs[0].channelBuffers32[0] + start;
+	float* outR = data.outputs[0].channelBuffers32[1] + start;
+
+	// As processChunk
+	if (useMidSide != lastUseMidSide) {
+		AudioEffect[1].copyStateFrom(AudioEffect[0]);
+		rightFollowsLeft = false;
+		sideSkipped = false;
+		lastUseMidSide = useMidSide;
+	}
+
+	// Both channels are always processed, skipping one (dual mono, silent side) saves no time
+	// with a thread each. Pick up from where realtime processing skipped it
+	if (useMidSide) {
+		if (sideSkipped) {
+			AudioEffect[1].reset();
+			sideSkipped = false;
+		}
+		encodeMidSide(inL, inR, outL, outR, numSamples);
+		inL = outL;
+		inR = outR;
+	}
+	else if (rightFollowsLeft) {
+		AudioEffect[1].copyStateFrom(AudioEffect[0]);
+		rightFollowsLeft = false;
+	}
+
+	const std::unique_ptr<CIRCULATE_PARAMS::AudioEffectParameters>* chunkParams = OfflineChunkParams.data() + firstChunk;
+	const float* runSidechain = sidechain ? sidechain + start : nullptr;
+	ChannelJobs[0] = { &AudioEffect[0], inL, outL, numSamples, runSidechain, chunkParams };
+	ChannelJobs[1] = { &AudioEffect[1], inR, outR, numSamples, runSidechain, chunkParams };
+
+	OfflinePool.run(&CirculateProcessor::runChannelJob, ChannelJobs, 2);
+
+	// Back on the live parameters
+	AudioEffect[0].getParams(Params);
+	AudioEffect[1].getParams(Params);
+
+	if (useMidSide) {
+		decodeMidSide(outL, outR, numSamples);
+	}
+
+	if (numOutChan > 2) {
+		CIRCULATE_TRACE_SCOPE("channel copy");
+		for (int c = 2; c < numOutChan; c++) {
+			memcpy(data.outputs[0].channelBuffers32[c] + start, outL, sizeof(float) * numSamples);
+		}
+	}
 }
 
 //------------------------------------------------------------------------
@@ -206,16 +665,31 @@ tresult PLUGIN_API CirculateProcessor::setupProcessing (Vst::ProcessSetup& newSe
 	AudioEffect[0].setSampleRateBlockSize(Setup);
 	AudioEffect[1].setSampleRateBlockSize(Setup);
 
+	// Offline rendering processes the channels on a worker thread, realtime stays on the host thread
+	if (newSetup.processMode == Vst::kOffline) {
+		if (OfflinePool.getNumWorkers() == 0) {
+			OfflinePool.start(1);
+		}
+	}
+	else {
+		OfflinePool.stop();
+	}
+
+	// Opt in capture of the host's calls, for reproducing CPU spikes
+	Recorder.startFromEnvironment(newSetup);
+
+	// Trace builds: buffers for the audio thread and the offline worker, allocated here
+	CIRCULATE_TRACE_RESERVE(2);
 
 	// Setup can be called multiple times without calling processors destructor.
 	// so need to check 
 
 	if (!Params)
 	{
-		Params = new CIRCULATE_PARAMS::AudioEffectParameters(newSetup.maxSamplesPerBlock, newSetup.sampleRate);
+		Params = new CIRCULATE_PARAMS::AudioEffectParameters(newSetup.sampleRate);
 	}
 	else {
-		Params->reInitialise(newSetup.maxSamplesPerBlock, newSetup.sampleRate);
+		Params->reInitialise(newSetup.sampleRate);
 		
 	}
 
@@ -223,9 +697,35 @@ tresult PLUGIN_API CirculateProcessor::setupProcessing (Vst::ProcessSetup& newSe
 	AudioEffect[0].getParams(Params);
 	AudioEffect[1].getParams(Params);
 
+	// Offline, the parameters and sidechain of every chunk of a block are kept for the channel jobs
+	OfflineChunkParams.clear();
+	OfflineSidechain.clear();
+	if (newSetup.processMode == Vst::kOffline) {
+		int numChunks = (newSetup.maxSamplesPerBlock + PROCESS_CHUNK_SIZE - 1) / PROCESS_CHUNK_SIZE;
+		for (int i = 0; i < numChunks; i++) {
+			OfflineChunkParams.push_back(std::make_unique<CIRCULATE_PARAMS::AudioEffectParameters>(newSetup.sampleRate));
+		}
+		OfflineSidechain.assign(static_cast<size_t>(numChunks) * PROCESS_CHUNK_SIZE, 0.0f);
+	}
+
+	applyStageLimit();
+
 	return AudioEffect::setupProcessing (newSetup);
 }
 
+//------------------------------------------------------------------------
+void CirculateProcessor::applyStageLimit()
+{
+	if (!Params) {
+		return;
+	}
+
+	// Only allocates when the limit has changed
+	int limit = CIRCULATE_PARAMS::getStageLimit(Params->StageLimit.getLastValue());
+	AudioEffect[0].setStageLimit(limit);
+	AudioEffect[1].setStageLimit(limit);
+}
+
 //------------------------------------------------------------------------
 tresult PLUGIN_API CirculateProcessor::canProcessSampleSize (int32 symbolicSampleSize)
 {
@@ -258,6 +758,16 @@ tresult PLUGIN_API CirculateProcessor::setState (IBStream* state)
 	if (streamer.readDouble(offset) == false) return kResultFalse;
 	if (streamer.readDouble(bypass) == false) return kResultFalse;
 	if (streamer.readDouble(feed) == false) return kResultFalse;
+	// Added after version 2, older states end before some of them
+	double stereo = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_STEREO);
+	double sidechain = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_SIDECHAIN);
+	double chord = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_CHORD);
+	double precision = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_PRECISION);
+	double engine = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_ENGINE);
+	double spread = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_SPREAD);
+	double spreadShape = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_SPREAD_SHAPE);
+	double stageLimit = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_STAGE_LIMIT);
+	double bandSplit = CIRCULATE_PARAMS::readAppendedValue(streamer, DEFAULT_BAND_SPLIT);
 	// Fill sample accurate parameter buffers with loaded value
 	Params->Depth.fillWith(depth);
 	Params->Center.fillWith(center);
@@ -266,6 +776,16 @@ tresult PLUGIN_API CirculateProcessor::setState (IBStream* state)
 	Params->CenterType.fillWith(type);
 	Params->NoteOffset.fillWith(offset);
 	Params->Feedback.fillWith(feed);
+	Params->StereoMode.fillWith(stereo);
+	Params->Sidechain.fillWith(sidechain);
+	Params->Chord.fillWith(chord);
+	Params->Precision.fillWith(precision);
+	Params->Engine.fillWith(engine);
+	Params->Spread.fillWith(spread);
+	Params->SpreadShape.fillWith(spreadShape);
+	// Applied when processing is next set up
+	Params->StageLimit.fillWith(stageLimit);
+	Params->BandSplit.fillWith(bandSplit);
 
 	if (bypass > 0.5) {
 		isBypassed = true;
@@ -296,6 +816,15 @@ tresult PLUGIN_API CirculateProcessor::getState (IBStream* state)
 	streamer.writeDouble(Params->NoteOffset.getLastValue());
 	streamer.writeDouble(isBypassed);
 	streamer.writeDouble(Params->Feedback.getLastValue());
+	streamer.writeDouble(Params->StereoMode.getLastValue());
+	streamer.writeDouble(Params->Sidechain.getLastValue());
+	streamer.writeDouble(Params->Chord.getLastValue());
+	streamer.writeDouble(Params->Precision.getLastValue());
+	streamer.writeDouble(Params->Engine.getLastValue());
+	streamer.writeDouble(Params->Spread.getLastValue());
+	streamer.writeDouble(Params->SpreadShape.getLastValue());
+	streamer.writeDouble(Params->StageLimit.getLastValue());
+	streamer.writeDouble(Params->BandSplit.getLastValue());
 	return kResultOk;
 }
 
@@ -9,6 +9,10 @@
 #include "CirculateHelpers.h"
 #include "CirculateEffect.h"
 #include "CirculateParameters.h"
+#include "WorkerPool.h"
+#include "AutomationCapture.h"
+#include <memory>
+#include <vector>
 namespace CirculateVST {
 
 //------------------------------------------------------------------------
@@ -41,6 +45,9 @@ public:
 	/** Will be called before any process call */
 	Steinberg::tresult PLUGIN_API setupProcessing (Steinberg::Vst::ProcessSetup& newSetup) SMTG_OVERRIDE;
 	
+	/** Latency of the selected engine */
+	Steinberg::uint32 PLUGIN_API getLatencySamples () SMTG_OVERRIDE;
+
 	/** Asks if a given sample size is supported see SymbolicSampleSizes. */
 	Steinberg::tresult PLUGIN_API canProcessSampleSize (Steinberg::int32 symbolicSampleSize) SMTG_OVERRIDE;
 
@@ -52,7 +59,7 @@ public:
 	Steinberg::tresult PLUGIN_API getState (Steinberg::IBStream* state) SMTG_OVERRIDE;
 
 	Steinberg::tresult PLUGIN_API setBusArrangements(Steinberg::Vst::SpeakerArrangement* inputs, Steinberg::int32 numIns, Steinberg::Vst::SpeakerArrangement* outputs, Steinberg::int32 numOuts) SMTG_OVERRIDE;
-	Steinberg::tresult PLUGIN_API CirculateProcessor::setProcessing(Steinberg::TBool state);
+	Steinberg::tresult PLUGIN_API setProcessing(Steinberg::TBool state) SMTG_OVERRIDE;
 
 //------------------------------------------------------------------------
 protected:
@@ -61,6 +68,94 @@ protected:
 
 	bool isBypassed = false;
 	int lastBlockSize = 0;
+
+	// Dual mono / mid side state
+	bool rightFollowsLeft = true; // right effect state is a copy of the left, only the left is processed
+	bool sideSkipped = false; // M/S side path skipped while silent
+	bool lastUseMidSide = false;
+
+	/// One chunk (at most PROCESS_CHUNK_SIZE samples) of the host's block, the channel pointers
+	/// start at the chunk's first sample
+	struct ChunkBuffers {
+		float* in[2] = {};
+		float* out[2] = {};
+		int numSamples = 0;
+		const float* sidechain = nullptr;
+	};
+
+	/// Parameters of one chunk of the host's block, read from the queues and MIDI then smoothed
+	void updateChunkParameters(Steinberg::Vst::ProcessData& data, int chunkStart, int numSamples);
+	/// Process one chunk of the host's block, all channels
+	void processChunk(Steinberg::Vst::ProcessData& data, int chunkStart, int numSamples, int numChan, int numOutChan);
+	/// Process a stereo chunk as left and right, processing once and copying if both inputs are identical.
+	/// Returns the number of output channels written
+	int processLeftRight(const ChunkBuffers& Chunk);
+	/// Process a stereo chunk as mid and side, skipping the side path while it is silent.
+	/// Returns the number of output channels written
+	int processMidSide(const ChunkBuffers& Chunk);
+	/// Left/right to mid/side in out, inputs may be the outputs
+	static void encodeMidSide(const float* inL, const float* inR, float* outM, float* outS, int numSamples);
+	/// Mid/side back to left/right, in place
+	static void decodeMidSide(float* M, float* S, int numSamples);
+
+	/// Offline rendering, the two channel effects run in parallel. A job is one chunk, or a run
+	/// of chunks with the parameters of each in chunkParams
+	struct ChannelJob {
+		CirculateEffect* effect = nullptr;
+		float* in = nullptr;
+		float* out = nullptr;
+		int numSamples = 0;
+		const float* sidechain = nullptr;
+		const std::unique_ptr<CIRCULATE_PARAMS::AudioEffectParameters>* chunkParams = nullptr;
+	};
+	ChannelJob ChannelJobs[2];
+	WorkerPool OfflinePool;
+	bool offlineRender = false;
+
+	/// Process both channel effects, on the worker pool when rendering offline
+	void processChannelPair(const ChunkBuffers& Chunk, float* in0, float* out0, float* in1, float* out1);
+	static void runChannelJob(void* context, int jobIndex);
+
+	/// Offline stereo blocks, a copy of the parameters and the sidechain of every chunk, so the
+	/// channels can each work through the whole block after one hand over to the pool. Sized
+	/// for the largest block in setupProcessing
+	std::vector<std::unique_ptr<CIRCULATE_PARAMS::AudioEffectParameters>> OfflineChunkParams;
+	std::vector<float> OfflineSidechain;
+
+	/// Whether the block can be processed with processOfflineBlock
+	bool canProcessOfflineBlock(const Steinberg::Vst::ProcessData& data, int numChan) const;
+	/// Process a stereo block offline, fanning out to the pool once per run of chunks in the same stereo mode
+	void processOfflineBlock(Steinberg::Vst::ProcessData& data, int numOutChan);
+	/// Process chunks firstChunk to endChunk - 1 of the block, both channels in parallel
+	/// <param name="sidechain"> mono sidechain of the whole block, nullptr if not connected</param>
+	void processOfflineRun(Steinberg::Vst::ProcessData& data, int firstChunk, int endChunk, bool useMidSide, const float* sidechain, int numOutChan);
+
+	/// MIDI notes currently held, oldest first, for the held notes chord mode
+	int HeldNotes[BANK_LANES] = {};
+	int numHeldNotes = 0;
+	void updateHeldNotes(Steinberg::Vst::IEventList* events);
+
+	/// Mono sum of the sidechain bus for a chunk, nullptr if it isn't connected
+	alignas(64) float SidechainBuffer[PROCESS_CHUNK_SIZE] = {};
+	const float* getSidechain(Steinberg::Vst::ProcessData& data, int chunkStart, int numSamples);
+
+	/// Size the effects' filter memory for the Stage Limit parameter, from setup (allocates)
+	void applyStageLimit();
+
+	/// Stage Limit last asked to be applied (kRestartRequest, alternating), the controller restarts the component
+	int requestedStageLimit = 0;
+	double reportedRestartValue = 0.0;
+
+	/// Latency last sent to the controller (kLatency), which asks the host to query it again
+	int reportedLatency = 0;
+	double reportedLatencyValue = 0.0;
+	int getCurrentLatency() const;
+
+	/// Note last sent to the controller's note display (kPlayedNote)
+	double reportedPlayedNote = -1.0;
+
+	/// Records process() calls for tools/replay, when CIRCULATE_CAPTURE is set
+	CAPTURE::AutomationRecorder Recorder;
 	
 };
 
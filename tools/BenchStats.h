@@ -0,0 +1,98 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/// <summary>
+/// Timing helpers shared by the benchmark tools. Times are collected per call (one process()
+/// or getBlock()) and reported as a distribution, since the tail is what causes dropouts.
+/// </summary>
+namespace BENCH {
+
+	using Clock = std::chrono::steady_clock;
+
+	inline double elapsedNs(Clock::time_point start, Clock::time_point end) {
+		return std::chrono::duration<double, std::nano>(end - start).count();
+	}
+
+	class TimingStats {
+	public:
+		void reserve(size_t numCalls) {
+			Times.reserve(numCalls);
+		}
+
+		void add(double ns, int numSamples) {
+			Times.push_back(ns);
+			totalSamples += numSamples;
+		}
+
+		void clear() {
+			Times.clear();
+			totalSamples = 0;
+		}
+
+		size_t getNumCalls() const {
+			return Times.size();
+		}
+
+		long long getTotalSamples() const {
+			return totalSamples;
+		}
+
+		/// <summary>
+		/// Nearest rank percentile
+		/// </summary>
+		/// <param name="p"> 0 to 100</param>
+		double getPercentile(double p) const {
+			if (Times.empty()) return 0.0;
+			std::vector<double> Sorted(Times);
+			std::sort(Sorted.begin(), Sorted.end());
+			size_t rank = static_cast<size_t>(p / 100.0 * (Sorted.size() - 1) + 0.5);
+			return Sorted[std::min(rank, Sorted.size() - 1)];
+		}
+
+		double getTotal() const {
+			double total = 0.0;
+			for (double t : Times) total += t;
+			return total;
+		}
+
+		/// <summary>
+		/// Number of calls that took longer than deadlineNs
+		/// </summary>
+		size_t countOver(double deadlineNs) const {
+			size_t count = 0;
+			for (double t : Times) {
+				if (t > deadlineNs) count++;
+			}
+			return count;
+		}
+
+		/// <summary>
+		/// Print one line: mean, p50, p99, p99.9 and max per call in microseconds, ns per sample, 
+		/// and the calls over the deadline (0 to skip)
+		/// </summary>
+		void print(FILE* out, const char* label, double deadlineNs) const {
+			if (Times.empty()) {
+				fprintf(out, "%-28s no calls\n", label);
+				return;
+			}
+			double total = getTotal();
+			fprintf(out, "%-28s mean %8.2f  p50 %8.2f  p99 %8.2f  p99.9 %8.2f  max %8.2f us | %7.1f ns/sample",
+				label, total / Times.size() / 1000.0, getPercentile(50) / 1000.0, getPercentile(99) / 1000.0,
+				getPercentile(99.9) / 1000.0, getPercentile(100) / 1000.0, total / (totalSamples > 0 ? totalSamples : 1));
+			if (deadlineNs > 0.0) {
+				fprintf(out, " | over deadline %zu/%zu", countOver(deadlineNs), Times.size());
+			}
+			fprintf(out, "\n");
+		}
+
+	private:
+		std::vector<double> Times;
+		long long totalSamples = 0;
+	};
+}
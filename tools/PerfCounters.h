@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+/// <summary>
+/// Hardware performance counters of the calling thread (Linux perf_event_open), for telling
+/// whether a kernel is bound by compute, latency or memory. Counters are user space only, so
+/// they open with perf_event_paranoid up to 2. Ones the CPU or the VM doesn't have are left out
+/// and reported as n/a. Elsewhere than Linux nothing opens.
+///
+/// The counters are one group, started and stopped together around the measured calls (outside
+/// the timed region), and accumulate until clear. Values are scaled when the kernel had to
+/// multiplex the group.
+/// </summary>
+namespace BENCH {
+
+	enum CounterIDs {
+		kCycles,
+		kInstructions,
+		kBranches,
+		kBranchMisses,
+		kL1DMisses,   // L1 data cache read misses
+		kLLCMisses,   // last level cache read misses, perf has no generic L2 event
+		kNumCounters
+	};
+
+	class PerfCounters {
+	public:
+		PerfCounters() {
+			for (int i = 0; i < kNumCounters; i++) {
+				Descriptors[i] = -1;
+			}
+		}
+
+		~PerfCounters() {
+			close();
+		}
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		static const char* getName(int id) {
+			static const char* Names[kNumCounters] = { "cycles", "instructions", "branches", "branch-misses", "L1D-misses", "LLC-misses" };
+			return Names[id];
+		}
+
+		/// <summary>
+		/// Open every counter the system allows
+		/// </summary>
+		/// <returns> false when none opened, with the reason on stderr</returns>
+		bool open() {
+			close();
+#ifdef __linux__
+			const uint32_t cacheRead = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			const struct { uint32_t type; uint64_t config; } Events[kNumCounters] = {
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheRead },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheRead },
+			};
+
+			int firstError = 0;
+			for (int i = 0; i < kNumCounters; i++) {
+				perf_event_attr Attributes;
+				memset(&Attributes, 0, sizeof(Attributes));
+				Attributes.size = sizeof(Attributes);
+				Attributes.type = Events[i].type;
+				Attributes.config = Events[i].config;
+				Attributes.disabled = 1;
+				Attributes.exclude_kernel = 1;
+				Attributes.exclude_hv = 1;
+				Attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				Descriptors[i] = static_cast<int>(syscall(SYS_perf_event_open, &Attributes, 0, -1, leader, 0));
+				if (Descriptors[i] < 0) {
+					if (firstError == 0) firstError = errno;
+					continue;
+				}
+				if (leader < 0) {
+					leader = Descriptors[i];
+				}
+			}
+
+			if (leader < 0) {
+				fprintf(stderr, "No performance counters: %s%s\n", strerror(firstError),
+					(firstError == EACCES || firstError == EPERM) ? " (see /proc/sys/kernel/perf_event_paranoid)" : "");
+				return false;
+			}
+			clear();
+			return true;
+#else
+			fprintf(stderr, "Performance counters need Linux\n");
+			return false;
+#endif
+		}
+
+		void close() {
+#ifdef __linux__
+			for (int i = 0; i < kNumCounters; i++) {
+				if (Descriptors[i] >= 0) {
+					::close(Descriptors[i]);
+				}
+				Descriptors[i] = -1;
+			}
+#endif
+			leader = -1;
+		}
+
+		bool isOpen() const {
+			return leader >= 0;
+		}
+
+		void start() {
+#ifdef __linux__
+			if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+		}
+
+		void stop() {
+#ifdef __linux__
+			if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+		}
+
+		/// <summary>
+		/// Zero every counter
+		/// </summary>
+		void clear() {
+#ifdef __linux__
+			if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+#endif
+		}
+
+		/// <summary>
+		/// Count since the last clear, scaled for multiplexing
+		/// </summary>
+		/// <returns> false when the counter isn't open or never got to run</returns>
+		bool read(int id, double& value) const {
+			value = 0.0;
+#ifdef __linux__
+			uint64_t Values[3] = {}; // value, time enabled, time running
+			if (Descriptors[id] < 0 || ::read(Descriptors[id], Values, sizeof(Values)) != sizeof(Values) || Values[2] == 0) {
+				return false;
+			}
+			value = static_cast<double>(Values[0]) * (static_cast<double>(Values[1]) / Values[2]);
+			return true;
+#else
+			(void)id;
+			return false;
+#endif
+		}
+
+		/// <summary>
+		/// Print one line: cycles, instructions and misses per sample, then IPC and the branch miss rate
+		/// </summary>
+		void print(FILE* out, const char* label, long long numSamples) const {
+			double perSample = 1.0 / (numSamples > 0 ? numSamples : 1);
+			fprintf(out, "%-28s", label);
+			const int Listed[] = { kCycles, kInstructions, kL1DMisses, kLLCMisses, kBranchMisses };
+			for (int id : Listed) {
+				double value = 0.0;
+				if (read(id, value)) {
+					fprintf(out, " %s %.3g", getName(id), value * perSample);
+				}
+				else {
+					fprintf(out, " %s n/a", getName(id));
+				}
+			}
+			fprintf(out, " per sample");
+
+			double cycles = 0.0, instructions = 0.0, branches = 0.0, branchMisses = 0.0;
+			if (read(kCycles, cycles) && read(kInstructions, instructions) && cycles > 0.0) {
+				fprintf(out, " | IPC %.2f", instructions / cycles);
+			}
+			if (read(kBranches, branches) && read(kBranchMisses, branchMisses) && branches > 0.0) {
+				fprintf(out, " | branch miss %.2f %%", 100.0 * branchMisses / branches);
+			}
+			fprintf(out, "\n");
+		}
+
+	private:
+		int Descriptors[kNumCounters];
+		int leader = -1;
+	};
+}
@@ -0,0 +1,125 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// Differential conformance harness. Runs every processing path of CirculateEffect against the
+// scalar ReferenceEffect over randomized automation and signals, and checks each against its
+// error budgets, median window then whole run (see Conformance.h). Exits with 1 if any path is over budget, so it can gate
+// changes to the kernels.
+//
+// Usage: CirculateConformance [--seed 1] [--seeds 4] [--seconds 2] [--rate 48000] [--path name]
+
+#include "Conformance.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+	struct ConformanceOptions {
+		unsigned seed = 1;
+		int numSeeds = 4;
+		double seconds = 2.0;
+		double sampleRate = 48000.0;
+		std::string path;
+	};
+
+	void printUsage() {
+		printf("Usage: CirculateConformance [--seed 1] [--seeds 4] [--seconds 2] [--rate 48000] [--path name]\n\nPaths:\n");
+		for (const CONFORMANCE::Path& P : CONFORMANCE::Paths) {
+			if (P.bitExact) {
+				printf("  %-12s %s (bit exact)\n", P.name, P.description);
+			}
+			else if (P.stability) {
+				printf("  %-12s %s (gain %+.0f dB window, %+.0f dB run)\n", P.name, P.description, P.budgetDb, P.runBudgetDb);
+			}
+			else {
+				printf("  %-12s %s (median %.0f dB, run %.0f dB)\n", P.name, P.description, P.budgetDb, P.runBudgetDb);
+			}
+		}
+	}
+
+	bool parseOptions(int argc, char* argv[], ConformanceOptions& Options) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--seed" && hasValue) {
+				Options.seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+			}
+			else if (arg == "--seeds" && hasValue) {
+				Options.numSeeds = atoi(argv[++i]);
+			}
+			else if (arg == "--seconds" && hasValue) {
+				Options.seconds = atof(argv[++i]);
+			}
+			else if (arg == "--rate" && hasValue) {
+				Options.sampleRate = atof(argv[++i]);
+			}
+			else if (arg == "--path" && hasValue) {
+				Options.path = argv[++i];
+			}
+			else {
+				return false;
+			}
+		}
+		return Options.numSeeds > 0 && Options.seconds > 0.0 && Options.sampleRate > 0.0;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	ConformanceOptions Options;
+	if (!parseOptions(argc, argv, Options)) {
+		printUsage();
+		return 2;
+	}
+
+	printf("%.0f Hz, %.1f s per run, seeds %u to %u\n\n", Options.sampleRate, Options.seconds,
+		Options.seed, Options.seed + Options.numSeeds - 1);
+	printf("%-12s %6s %12s %10s %10s %14s %10s %10s %14s  %s\n", "path", "seed", "max error", "rel dB", "median dB", "first mismatch",
+		"gain dB", "run gain", "budget", "result");
+
+	int numRun = 0;
+	int numFailed = 0;
+
+	for (const CONFORMANCE::Path& P : CONFORMANCE::Paths) {
+		if (!Options.path.empty() && Options.path != P.name) {
+			continue;
+		}
+
+		for (int i = 0; i < Options.numSeeds; i++) {
+			unsigned seed = Options.seed + i;
+			CONFORMANCE::Result R = CONFORMANCE::runPath(P, seed, Options.seconds, Options.sampleRate);
+
+			char budget[32];
+			if (P.bitExact) {
+				snprintf(budget, sizeof(budget), "exact");
+			}
+			else if (P.stability) {
+				snprintf(budget, sizeof(budget), "gain %+.0f / %+.0f", P.budgetDb, P.runBudgetDb);
+			}
+			else {
+				snprintf(budget, sizeof(budget), "%.0f / %.0f dB", P.budgetDb, P.runBudgetDb);
+			}
+
+			printf("%-12s %6u %12.3g %10.1f %10.1f %14lld %10.1f %10.1f %14s  %s\n", P.name, seed, R.maxError, R.relativeErrorDb,
+				R.medianWindowDb, R.firstMismatch, R.maxWindowGainDb, R.runGainDb, budget, R.passed ? "pass" : "FAIL");
+
+			numRun++;
+			if (!R.passed) {
+				numFailed++;
+			}
+		}
+	}
+
+	if (numRun == 0) {
+		printf("No path named '%s'\n", Options.path.c_str());
+		printUsage();
+		return 2;
+	}
+
+	printf("\n%d of %d runs within budget\n", numRun - numFailed, numRun);
+	return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,999 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "CirculateEffect.h"
+#include "CirculateParameters.h"
+#include "DenormalProtection.h"
+#include "ReferenceEffect.h"
+#include "BandSplit.h"
+#include "BatchEffect.h"
+#include "ParallelRender.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Samples per window of the median error. Switching modes and control rate approximations of
+// fast modulation show up as a few bad windows, a wrong kernel shows up in all of them
+#define CONFORMANCE_WINDOW 4096
+// Windows quieter than this fraction of the mean (-20 dB) are left out of the stability gain
+#define CONFORMANCE_QUIET_WINDOW 0.01
+
+// Other stage topologies against the SVF reference, median then whole run. Held coefficients only
+// leave rounding. TDF2 loses precision at low centers with 32 bit memory
+#define BUDGET_TOPOLOGY_HELD -125.0
+#define BUDGET_TOPOLOGY_HELD_RUN -125.0
+#define BUDGET_LATTICE_FLOAT -94.0
+#define BUDGET_LATTICE_FLOAT_RUN -92.0
+#define BUDGET_TDF2_FLOAT -55.0
+#define BUDGET_TDF2_FLOAT_RUN -54.0
+
+// Once the coefficients move each topology's memory answers differently, so the error says
+// little and the lattice is checked for stability instead: its output energy over the
+// reference's, in the loudest window and over the run. The lattice measures at most +4.3 and
+// +0.1 dB over 16 seeds. TDF2 isn't run under automation, its memory isn't normalised and fast
+// sweeps pump energy into it (up to +18 dB in a window, +2.5 dB over a run, into the limiter),
+// so it is only for held or slowly moving coefficients
+#define BUDGET_LATTICE_WINDOW_GAIN 6.0
+#define BUDGET_LATTICE_RUN_GAIN 1.0
+
+// Spectral engine against the cascade, held settings, median then whole run. Only the float FFT's
+// rounding separates them: the engine matched 40 stages to 3e-7 when it was added, here it
+// measures at most 6e-8 (-133 dB) over 16 seeds. Half a stage goes through a second engine and
+// measures down to -112 dB
+#define SPECTRAL_CONFORMANCE_STAGES 40
+#define BUDGET_SPECTRAL -128.0
+#define BUDGET_SPECTRAL_RUN -128.0
+#define BUDGET_SPECTRAL_HALF -108.0
+#define BUDGET_SPECTRAL_HALF_RUN -108.0
+
+// Time chunked rendering against serial rendering, median then whole run. The seams match to
+// within what the cascade's memory has left after the estimated pre-roll
+#define CONFORMANCE_RENDER_CHUNKS 4
+#define BUDGET_RENDER_SEAMS -120.0
+#define BUDGET_RENDER_SEAMS_RUN -120.0
+
+/// <summary>
+/// Differential conformance of CirculateEffect against ReferenceEffect.
+///
+/// Each path is one way of running the cascade (kernels, float memory, lanes, control rate
+/// modulation, ...) with an error budget against the reference. A run drives both effects
+/// through the same AudioEffectParameters with randomized automation written straight into the
+/// chunk values, as the Python module does, at random chunk sizes, and compares the outputs.
+/// Runs are reproducible from the seed.
+///
+/// Paths that calculate every coefficient exactly must match bit for bit. The others are checked
+/// on the median error of CONFORMANCE_WINDOW sample windows, relative to the reference, in dB,
+/// and on the error of the whole run. The cascade's phase is very sensitive to g, so where a path
+/// approximates g (control rate interpolation, chord switches gliding in) the outputs drift apart
+/// for a while and the whole run error mostly measures how often that happened. The median is
+/// what the kernel itself does, the whole run budget bounds the rest.
+///
+/// Paths that aren't one CirculateEffect against the reference (the batch, the spectral engine,
+/// the time chunked render) bring their own run.
+///
+/// New processing paths get an entry in Paths, with the budgets set a few dB over the worst of
+/// what they measure over 16 seeds when they are known to be right.
+/// </summary>
+namespace CONFORMANCE {
+
+	struct Result {
+		double maxError = 0.0;
+		double relativeErrorDb = -INFINITY; // RMS of the difference over RMS of the reference
+		double medianWindowDb = -INFINITY; // median of the same over CONFORMANCE_WINDOW sample windows
+		long long firstMismatch = -1; // first sample that differs at all, -1 if none
+		double maxWindowGainDb = -INFINITY; // output energy over the reference's, loudest CONFORMANCE_WINDOW
+		double runGainDb = -INFINITY; // the same over the whole run
+		long long numSamples = 0;
+		bool passed = false;
+	};
+
+	/// <summary>
+	/// Randomized parameters and signals for a run, from an LCG so every run is reproducible
+	/// </summary>
+	class Scenario {
+	public:
+		Scenario(CIRCULATE_PARAMS::AudioEffectParameters& Parameters, unsigned seed) : Params(Parameters), rng(seed) {
+			random(); // spread out small seeds
+			// Always moving
+			automate(Params.Center, 0.0, 1.0);
+			automate(Params.Focus, 0.0, 1.0);
+			automate(Params.Depth, 0.0, 1.0);
+			automate(Params.Feedback, 0.0, 1.0);
+			automate(Params.Note, 0.0, 1.0);
+			automate(Params.NoteOffset, 0.0, 1.0);
+			toggle(Params.CenterType, 2, 2);
+		}
+
+		double random() {
+			rng = rng * 1664525u + 1013904223u;
+			return (rng >> 8) / 16777216.0;
+		}
+
+		/// <summary>
+		/// Move the parameter around low to high, per sample, from a random start
+		/// </summary>
+		void automate(CIRCULATE_PARAMS::ParamUnit& Unit, double low, double high) {
+			Unit.fillWith(low + random() * (high - low));
+			Automated.push_back({ &Unit, low, high, 0, 0 });
+		}
+
+		/// <summary>
+		/// Switch a list parameter between random entries, at chunk boundaries
+		/// </summary>
+		/// <param name="numUsed"> entries switched between, from the first</param>
+		void toggle(CIRCULATE_PARAMS::ParamUnit& Unit, int numEntries, int numUsed) {
+			Automated.push_back({ &Unit, 0.0, 0.0, numEntries, numUsed });
+		}
+
+		/// <summary>
+		/// Hold a parameter at a value for the whole run
+		/// </summary>
+		void fix(CIRCULATE_PARAMS::ParamUnit& Unit, double value) {
+			Automated.erase(std::remove_if(Automated.begin(), Automated.end(),
+				[&Unit](const Automation& A) { return A.Unit == &Unit; }), Automated.end());
+			Unit.fillWith(value);
+		}
+
+		/// <summary>
+		/// Hold the center frequency where it started, for paths that approximate the center at
+		/// control rate. With many stages the phase is so sensitive to g that the lag of the
+		/// interpolation behind a moving center is far larger than any error of the kernel,
+		/// which is what these paths are checked for
+		/// </summary>
+		void holdCenter() {
+			fix(Params.CenterType, 0.0);
+			fix(Params.Center, Params.Center.lastExplicit);
+		}
+
+		void useSidechain() {
+			mUseSidechain = true;
+		}
+
+		/// <summary>
+		/// Hold MIDI notes for the held notes chord mode, a new chord of 0 to BANK_LANES notes now and then
+		/// </summary>
+		void useHeldNotes() {
+			mUseHeldNotes = true;
+			pickHeldNotes();
+		}
+
+		bool hasHeldNotes() const {
+			return mUseHeldNotes;
+		}
+
+		const int* getHeldNotes() const {
+			return mHeldNotes;
+		}
+
+		int getNumHeldNotes() const {
+			return mNumHeldNotes;
+		}
+
+		bool hasSidechain() const {
+			return mUseSidechain;
+		}
+
+		/// <summary>
+		/// Random chunk size, mostly full chunks as from a host, with some short ones
+		/// </summary>
+		int nextChunkSize() {
+			if (random() < 0.5) {
+				return PROCESS_CHUNK_SIZE;
+			}
+			return 1 + static_cast<int>(random() * (PROCESS_CHUNK_SIZE - 1));
+		}
+
+		/// <summary>
+		/// Set up the parameters for the next chunk, the same order as the processor
+		/// </summary>
+		void fillChunk(int numSamples) {
+			for (Automation& A : Automated) {
+				if (A.numEntries > 0 && random() < 0.005) {
+					int entry = static_cast<int>(random() * A.numUsed);
+					A.Unit->lastExplicit = static_cast<double>(entry) / (A.numEntries - 1);
+				}
+			}
+			if (mUseHeldNotes && random() < 0.001) {
+				pickHeldNotes();
+			}
+
+			Params.setCurrentBlockSizeAndPreFill(numSamples);
+
+			for (Automation& A : Automated) {
+				if (A.numEntries > 0) {
+					continue;
+				}
+
+				// Mostly a random walk, as from a hand on a control or a drawn curve, with occasional jumps
+				double from = A.Unit->lastExplicit;
+				double to = from + (random() - 0.5) * 0.02 * (A.high - A.low);
+				double r = random();
+
+				if (r < 0.01) {
+					to = A.low + random() * (A.high - A.low);
+				}
+				to = std::min(std::max(to, A.low), A.high);
+
+				if (r < 0.02) {
+					int step = static_cast<int>(random() * numSamples);
+					for (int i = step; i < numSamples; i++) {
+						A.Unit->BlockValues[i] = to;
+					}
+				}
+				else {
+					for (int i = 0; i < numSamples; i++) {
+						A.Unit->BlockValues[i] = from + (to - from) * (i + 1) / numSamples;
+					}
+				}
+				A.Unit->lastExplicit = to;
+			}
+
+			Params.smoothAllParameters();
+		}
+
+		/// <summary>
+		/// Noise at a level that changes now and then, with silences and hot bursts for the limiter
+		/// </summary>
+		void fillInput(float* in, float* sidechain, int numSamples) {
+			if (random() < 0.05) {
+				double r = random();
+				mLevel = r < 0.2 ? 0.0f : (r < 0.3 ? 4.0f : static_cast<float>(random()));
+			}
+			for (int s = 0; s < numSamples; s++) {
+				in[s] = mLevel * static_cast<float>(random() * 2.0 - 1.0);
+			}
+
+			if (mUseSidechain) {
+				if (random() < 0.05) {
+					mGate = !mGate;
+				}
+				for (int s = 0; s < numSamples; s++) {
+					sidechain[s] = mGate ? static_cast<float>(random()) : 0.0f;
+				}
+			}
+		}
+
+		CIRCULATE_PARAMS::AudioEffectParameters& Params;
+
+	private:
+		struct Automation {
+			CIRCULATE_PARAMS::ParamUnit* Unit;
+			double low;
+			double high;
+			int numEntries; // list parameters, 0 for continuous
+			int numUsed;
+		};
+
+		std::vector<Automation> Automated;
+		unsigned rng;
+		float mLevel = 0.25f;
+		bool mUseSidechain = false;
+		bool mGate = true;
+
+		bool mUseHeldNotes = false;
+		int mHeldNotes[BANK_LANES] = {};
+		int mNumHeldNotes = 0;
+
+		// C2 to C7, none held now and then
+		void pickHeldNotes() {
+			mNumHeldNotes = static_cast<int>(random() * (BANK_LANES + 1));
+			for (int i = 0; i < mNumHeldNotes; i++) {
+				mHeldNotes[i] = 36 + static_cast<int>(random() * 61);
+			}
+		}
+	};
+
+	/// <summary>
+	/// ReferenceEffect at the reduced rate, in the same band split as CirculateEffect. The two
+	/// rates warp the response differently away from the center, so the band split path is held
+	/// to running the low band exactly as the reference would at that rate, which covers the
+	/// parameters taken at the low band samples and the center converted between the ranges.
+	/// The splitter is the same one, so this doesn't cover the crossover itself
+	/// </summary>
+	class ReferenceBandSplit {
+	public:
+		void setup(HELPERS::SetupInfo Setup, int stageLimit, CIRCULATE_PARAMS::AudioEffectParameters* Parameters) {
+			pParams = Parameters;
+
+			int factor = BandSplitter::getFactorForRate(static_cast<int>(Setup.sampleRate));
+			HELPERS::SetupInfo LowSetup = Setup;
+			LowSetup.sampleRate = Setup.sampleRate / factor;
+
+			LowParams = std::make_unique<CIRCULATE_PARAMS::AudioEffectParameters>(static_cast<int>(LowSetup.sampleRate));
+			Low.setup(LowSetup, stageLimit);
+			Low.getParams(LowParams.get());
+			Splitter.prepare(factor, PROCESS_CHUNK_SIZE);
+
+			// Same range limits as the effect at each rate
+			double maxHz = std::min<double>(MAX_FREQ_HZ, Setup.sampleRate / 2.0 - 500.0);
+			double lowMaxHz = std::min<double>(MAX_FREQ_HZ, LowSetup.sampleRate / 2.0 - 500.0);
+			mCenterScale = log(maxHz / MIN_FREQ_HZ) / log(lowMaxHz / MIN_FREQ_HZ);
+		}
+
+		void getBlock(const float* in, float* out, int numSamples) {
+			float low[PROCESS_CHUNK_SIZE + 1];
+			float processed[PROCESS_CHUNK_SIZE + 1];
+			int lowIndex[PROCESS_CHUNK_SIZE + 1];
+
+			int numLow = Splitter.split(in, numSamples, low, lowIndex);
+			if (numLow > 0) {
+				for (size_t p = 0; p < pParams->ParameterList.size(); p++) {
+					CIRCULATE_PARAMS::ParamUnit* Full = pParams->ParameterList[p];
+					CIRCULATE_PARAMS::ParamUnit* Reduced = LowParams->ParameterList[p];
+					Reduced->setCurrentBlockSize(numLow);
+					for (int j = 0; j < numLow; j++) {
+						Reduced->BlockValues[j] = Full->BlockValues[lowIndex[j]];
+					}
+					Reduced->lastExplicit = Full->lastExplicit;
+				}
+				for (int j = 0; j < numLow; j++) {
+					LowParams->Center.BlockValues[j] = std::min(LowParams->Center.BlockValues[j] * mCenterScale, 1.0);
+				}
+				Low.getBlock(low, processed, numLow);
+			}
+			Splitter.merge(low, processed, lowIndex, numLow, out, numSamples);
+		}
+
+	private:
+		ReferenceEffect Low;
+		std::unique_ptr<CIRCULATE_PARAMS::AudioEffectParameters> LowParams;
+		BandSplitter Splitter;
+		CIRCULATE_PARAMS::AudioEffectParameters* pParams = nullptr;
+		double mCenterScale = 1.0;
+	};
+
+	using ConfigureFunction = void (*)(Scenario&);
+
+	struct Path;
+	using RunFunction = Result (*)(const Path&, unsigned seed, double seconds, double sampleRate);
+
+	struct Path {
+		const char* name;
+		const char* description;
+		int stageLimit;
+		bool bitExact; // no difference allowed at all
+		double budgetDb; // max median window error, when not bit exact (max window gain for stability)
+		double runBudgetDb; // max whole run error, when not bit exact (max run gain for stability)
+		bool handover; // alternate between two effects with copyStateFrom, as linked channels do
+		ConfigureFunction configure;
+		int topology = CASCADE::kTopologySVF; // the reference is always the SVF
+		bool stability = false; // budgets are the max window and whole run gain over the reference, not error
+		RunFunction run = nullptr; // in place of runPath, for paths that aren't a CirculateEffect
+	};
+
+	/// <summary>
+	/// Error, window and gain measures of an output against what it should be, a block at a time
+	/// </summary>
+	class Comparison {
+	public:
+		/// <param name="position"> sample of the run the block starts at</param>
+		void add(const float* out, const float* expected, int numSamples, long long position) {
+			for (int s = 0; s < numSamples; s++) {
+				double error = fabs(static_cast<double>(out[s]) - expected[s]);
+				if (error > 0.0 && R.firstMismatch < 0) {
+					R.firstMismatch = position + s;
+				}
+				if (error > R.maxError) {
+					R.maxError = error;
+				}
+				errorEnergy += error * error;
+				referenceEnergy += static_cast<double>(expected[s]) * expected[s];
+				outputEnergy += static_cast<double>(out[s]) * out[s];
+
+				windowError += error * error;
+				windowReference += static_cast<double>(expected[s]) * expected[s];
+				windowOutput += static_cast<double>(out[s]) * out[s];
+				if (++windowPosition == CONFORMANCE_WINDOW) {
+					// Silent windows say nothing about the error
+					if (windowReference > 0.0) {
+						WindowErrors.push_back(windowError > 0.0 ? 10.0 * log10(windowError / windowReference) : -INFINITY);
+						WindowEnergies.push_back({ windowOutput, windowReference });
+					}
+					windowError = 0.0;
+					windowReference = 0.0;
+					windowOutput = 0.0;
+					windowPosition = 0;
+				}
+			}
+		}
+
+		/// <summary>
+		/// The measures, and whether they are within the path's budgets
+		/// </summary>
+		Result finish(const Path& P, long long numSamples) {
+			R.numSamples = numSamples;
+			if (errorEnergy > 0.0 && referenceEnergy > 0.0) {
+				R.relativeErrorDb = 10.0 * log10(errorEnergy / referenceEnergy);
+			}
+			else if (errorEnergy > 0.0) {
+				R.relativeErrorDb = INFINITY;
+			}
+
+			if (referenceEnergy > 0.0) {
+				R.runGainDb = 10.0 * log10(outputEnergy / referenceEnergy);
+
+				// Gain of the windows at a level that matters. In the quiet ones after the input
+				// stops the two are only ringing out, a topology's memory rings out differently
+				double floor = CONFORMANCE_QUIET_WINDOW * referenceEnergy / std::max<size_t>(WindowEnergies.size(), 1);
+				for (const auto& Energy : WindowEnergies) {
+					// Written so a NaN output sticks and fails the check
+					double gain = 10.0 * log10(Energy.first / Energy.second);
+					if (Energy.second >= floor && !(gain <= R.maxWindowGainDb)) {
+						R.maxWindowGainDb = gain;
+					}
+				}
+			}
+
+			if (!WindowErrors.empty()) {
+				std::nth_element(WindowErrors.begin(), WindowErrors.begin() + WindowErrors.size() / 2, WindowErrors.end());
+				R.medianWindowDb = WindowErrors[WindowErrors.size() / 2];
+			}
+
+			if (P.bitExact) {
+				R.passed = R.firstMismatch < 0;
+			}
+			else if (P.stability) {
+				R.passed = R.maxWindowGainDb <= P.budgetDb && R.runGainDb <= P.runBudgetDb;
+			}
+			else {
+				R.passed = R.medianWindowDb <= P.budgetDb && R.relativeErrorDb <= P.runBudgetDb;
+			}
+			return R;
+		}
+
+	private:
+		Result R;
+		double errorEnergy = 0.0;
+		double referenceEnergy = 0.0;
+		double outputEnergy = 0.0;
+
+		std::vector<double> WindowErrors;
+		std::vector<std::pair<double, double>> WindowEnergies; // output, reference
+		double windowError = 0.0;
+		double windowReference = 0.0;
+		double windowOutput = 0.0;
+		int windowPosition = 0;
+	};
+
+	/// <summary>
+	/// BatchEffect against a CirculateEffect per instance, in Hz mode on the same parameters.
+	/// Each host block gives every instance a step in Center, Focus and Feedback, and now and
+	/// then a new Depth, so the instances are regrouped between lanes (with their state) while
+	/// they run. Blocks are at most PROCESS_CHUNK_SIZE, as the Python module gives them
+	/// </summary>
+	inline Result runBatch(const Path& P, unsigned seed, double seconds, double sampleRate) {
+		// Three groups, the last one part full so empty lanes run too
+		const int numInstances = 2 * BATCH_LANES + BATCH_LANES / 2;
+		const int ids[] = { CIRCULATE_PARAMS::kCenter, CIRCULATE_PARAMS::kFocus, CIRCULATE_PARAMS::kDepth, CIRCULATE_PARAMS::kFeed };
+
+		DenormalHandler AntiDenormal;
+
+		// Same LCG as Scenario
+		unsigned rng = seed;
+		auto random = [&rng]() {
+			rng = rng * 1664525u + 1013904223u;
+			return (rng >> 8) / 16777216.0;
+		};
+		random(); // spread out small seeds
+
+		HELPERS::SetupInfo Setup;
+		Setup.sampleRate = sampleRate;
+		Setup.blockSize = PROCESS_CHUNK_SIZE;
+
+		BatchEffect Batch;
+		Batch.prepare(numInstances, sampleRate, P.stageLimit);
+
+		struct Instance {
+			std::unique_ptr<CIRCULATE_PARAMS::AudioEffectParameters> Params;
+			CirculateEffect Effect;
+			std::vector<float> In, Out, Expected;
+			float level = 0.25f;
+		};
+		std::vector<Instance> Instances(numInstances);
+		std::vector<const float*> Inputs(numInstances);
+		std::vector<float*> Outputs(numInstances);
+
+		for (int i = 0; i < numInstances; i++) {
+			Instance& I = Instances[i];
+			I.Params = std::make_unique<CIRCULATE_PARAMS::AudioEffectParameters>(static_cast<int>(sampleRate));
+			I.Effect.setSampleRateBlockSize(Setup);
+			I.Effect.getParams(I.Params.get());
+			I.Effect.setStageLimit(P.stageLimit);
+			I.Effect.reset();
+			I.In.resize(PROCESS_CHUNK_SIZE);
+			I.Out.resize(PROCESS_CHUNK_SIZE);
+			I.Expected.resize(PROCESS_CHUNK_SIZE);
+			Inputs[i] = I.In.data();
+			Outputs[i] = I.Out.data();
+
+			// Both start at their values, the batch snaps to them on its first block
+			I.Params->CenterType.fillWith(0.0);
+			for (int id : ids) {
+				double value = random();
+				I.Params->getParameter(id)->fillWith(value);
+				Batch.setParameter(id, i, value);
+			}
+		}
+
+		Comparison C;
+		long long totalSamples = static_cast<long long>(seconds * sampleRate);
+		long long position = 0;
+
+		while (position < totalSamples) {
+			int n = random() < 0.5 ? PROCESS_CHUNK_SIZE : 1 + static_cast<int>(random() * (PROCESS_CHUNK_SIZE - 1));
+			if (n > totalSamples - position) {
+				n = static_cast<int>(totalSamples - position);
+			}
+
+			for (int i = 0; i < numInstances; i++) {
+				Instance& I = Instances[i];
+
+				// A random walk as from a hand on a control, set as host changes are. Depth jumps.
+				// Not before the first block, the batch takes what is set then at once
+				for (int id : ids) {
+					if (position == 0) {
+						break;
+					}
+					CIRCULATE_PARAMS::ParamUnit* Unit = I.Params->getParameter(id);
+					double value;
+					if (id == CIRCULATE_PARAMS::kDepth) {
+						if (random() >= 0.05) {
+							continue;
+						}
+						value = random();
+					}
+					else {
+						value = std::min(std::max(Unit->lastExplicit + (random() - 0.5) * 0.02, 0.0), 1.0);
+					}
+					Unit->lastExplicit = value;
+					Batch.setParameter(id, i, value);
+				}
+
+				if (random() < 0.05) {
+					double r = random();
+					I.level = r < 0.2 ? 0.0f : (r < 0.3 ? 4.0f : static_cast<float>(random()));
+				}
+				for (int s = 0; s < n; s++) {
+					I.In[s] = I.level * static_cast<float>(random() * 2.0 - 1.0);
+				}
+			}
+
+			// First, getBlock may process in place
+			Batch.process(Inputs.data(), Outputs.data(), n);
+
+			for (Instance& I : Instances) {
+				I.Params->setCurrentBlockSizeAndPreFill(n);
+				I.Params->smoothAllParameters();
+				I.Effect.getBlock(I.In.data(), I.Expected.data(), n);
+				C.add(I.Out.data(), I.Expected.data(), n, position);
+			}
+			position += n;
+		}
+
+		return C.finish(P, position);
+	}
+
+	/// <summary>
+	/// RENDER::renderParallel split into CONFORMANCE_RENDER_CHUNKS chunks with the pre-roll it
+	/// estimates, against serial rendering of the same stereo buffer. Feedback off, the default
+	/// stage limit (P.stageLimit) at full depth,
+	/// a low focus (0 or 0.2) and the center held or rising from 0.05 or 0.3, where the stages
+	/// delay and ring the longest. The file is made long enough for the chunks to be longer than
+	/// the pre-roll, so it is split
+	/// </summary>
+	inline Result runRender(const Path& P, unsigned seed, double seconds, double sampleRate) {
+		const int numChannels = 2;
+
+		// Same LCG as Scenario
+		unsigned rng = seed;
+		auto random = [&rng]() {
+			rng = rng * 1664525u + 1013904223u;
+			return (rng >> 8) / 16777216.0;
+		};
+		random(); // spread out small seeds
+
+		RENDER::Instance Main(sampleRate, numChannels);
+
+		// Consecutive seeds go through the four combinations
+		double focus = (seed & 1) ? 0.2 : 0.0;
+		double center = (seed & 2) ? 0.3 : 0.05;
+		double rise = random() < 0.5 ? 0.0 : 0.2 * random();
+
+		std::vector<RENDER::Automation> Automations(4);
+		Automations[0].unit = &Main.Params.Focus;
+		Automations[0].constant = focus;
+		Automations[1].unit = &Main.Params.Depth;
+		Automations[1].constant = 1.0;
+		Automations[2].unit = &Main.Params.Feedback;
+		Automations[2].constant = 0.5;
+		Automations[3].unit = &Main.Params.Center;
+		Automations[3].constant = center;
+
+		// The center only rises, so the pre-roll is the one for where it starts
+		long long preroll = RENDER::estimatePreroll(Main, Automations, 1, false);
+		long long numSamples = std::max(static_cast<long long>(seconds * sampleRate),
+			CONFORMANCE_RENDER_CHUNKS * (preroll + CONFORMANCE_WINDOW));
+
+		std::vector<double> Center(numSamples);
+		for (long long i = 0; i < numSamples; i++) {
+			Center[i] = center + rise * i / numSamples;
+		}
+		Automations[3].values = Center.data();
+
+		// Noise at a level that changes now and then, as Scenario::fillInput
+		std::vector<float> Data(numChannels * numSamples);
+		float level = 0.25f;
+		for (long long i = 0; i < numSamples; i++) {
+			if (i % PROCESS_CHUNK_SIZE == 0 && random() < 0.05) {
+				double r = random();
+				level = r < 0.2 ? 0.0f : (r < 0.3 ? 4.0f : static_cast<float>(random()));
+			}
+			for (int c = 0; c < numChannels; c++) {
+				Data[c * numSamples + i] = level * static_cast<float>(random() * 2.0 - 1.0);
+			}
+		}
+		std::vector<float> Expected = Data;
+
+		WorkerPool Pool;
+		RENDER::RenderOptions Options;
+		Options.numThreads = CONFORMANCE_RENDER_CHUNKS;
+		RENDER::RenderReport Report = RENDER::renderParallel(Main, Pool, Data.data(), numChannels, numSamples, nullptr, Automations, Options);
+
+		// From cleared memory with the parameters at their first value, as renderParallel starts
+		RENDER::Instance Serial(sampleRate, numChannels);
+		for (const RENDER::Automation& A : Automations) {
+			Serial.getUnit(A.unit)->fillWith(A.values ? A.values[0] : A.constant);
+		}
+		Serial.process(Expected.data(), numSamples, numChannels, 0, numSamples, nullptr, Automations);
+
+		Comparison C;
+		for (int c = 0; c < numChannels; c++) {
+			for (long long i = 0; i < numSamples; i += PROCESS_CHUNK_SIZE) {
+				int n = static_cast<int>(std::min<long long>(PROCESS_CHUNK_SIZE, numSamples - i));
+				C.add(Data.data() + c * numSamples + i, Expected.data() + c * numSamples + i, n, i);
+			}
+		}
+
+		Result R = C.finish(P, numSamples);
+		R.passed = R.passed && Report.numChunks == CONFORMANCE_RENDER_CHUNKS;
+		return R;
+	}
+
+	/// <summary>
+	/// The spectral engine at numStages stages against ReferenceEffect at the whole stages, with
+	/// the engine's latency taken out. A fraction of a stage is checked as the reference's whole
+	/// stages followed by a second spectral engine at the fraction, which has the same latency.
+	/// Center and focus are held at random values, with feedback off and the input under the
+	/// limiter, none of which the engine applies
+	/// </summary>
+	inline Result runSpectralStages(const Path& P, unsigned seed, double seconds, double sampleRate, double numStages) {
+		DenormalHandler AntiDenormal;
+
+		// Same LCG as Scenario
+		unsigned rng = seed;
+		auto random = [&rng]() {
+			rng = rng * 1664525u + 1013904223u;
+			return (rng >> 8) / 16777216.0;
+		};
+		random(); // spread out small seeds
+
+		// Where the stages' response fits in the engine's padding
+		double center = 0.4 + 0.4 * random();
+		double focus = 0.6 * random();
+		int wholeStages = static_cast<int>(numStages);
+		double fraction = numStages - wholeStages;
+
+		HELPERS::SetupInfo Setup;
+		Setup.sampleRate = sampleRate;
+		Setup.blockSize = PROCESS_CHUNK_SIZE;
+
+		// Depth covers SPECTRAL_MAX_STAGES in the engine, the reference is set up with as many
+		auto makeParams = [&](double stages, double engine) {
+			auto Params = std::make_unique<CIRCULATE_PARAMS::AudioEffectParameters>(static_cast<int>(sampleRate));
+			Params->CenterType.fillWith(0.0);
+			Params->Center.fillWith(center);
+			Params->Focus.fillWith(focus);
+			Params->Depth.fillWith(stages / SPECTRAL_MAX_STAGES);
+			Params->Feedback.fillWith(0.5);
+			Params->Engine.fillWith(engine);
+			return Params;
+		};
+		auto SpectralParams = makeParams(numStages, 1.0);
+		auto ReferenceParams = makeParams(wholeStages, 0.0);
+		auto FractionParams = makeParams(fraction, 1.0);
+
+		CirculateEffect Spectral, Fraction;
+		Spectral.setSampleRateBlockSize(Setup);
+		Spectral.getParams(SpectralParams.get());
+		Spectral.reset();
+		Fraction.setSampleRateBlockSize(Setup);
+		Fraction.getParams(FractionParams.get());
+		Fraction.reset();
+
+		ReferenceEffect Reference;
+		Reference.setup(Setup, P.stageLimit);
+		Reference.getParams(ReferenceParams.get());
+
+		long long totalSamples = static_cast<long long>(seconds * sampleRate);
+		std::vector<float> Out(totalSamples), Expected(totalSamples);
+		std::vector<float> In(PROCESS_CHUNK_SIZE), Input(PROCESS_CHUNK_SIZE), Cascade(PROCESS_CHUNK_SIZE);
+		float level = 0.1f;
+
+		long long position = 0;
+		while (position < totalSamples) {
+			int n = random() < 0.5 ? PROCESS_CHUNK_SIZE : 1 + static_cast<int>(random() * (PROCESS_CHUNK_SIZE - 1));
+			if (n > totalSamples - position) {
+				n = static_cast<int>(totalSamples - position);
+			}
+
+			for (auto* Params : { SpectralParams.get(), ReferenceParams.get(), FractionParams.get() }) {
+				Params->setCurrentBlockSizeAndPreFill(n);
+				Params->smoothAllParameters();
+			}
+
+			// Noise at a level that changes now and then, with silences, dispersed well under the limiter
+			if (random() < 0.05) {
+				level = random() < 0.2 ? 0.0f : 0.1f * static_cast<float>(random());
+			}
+			for (int s = 0; s < n; s++) {
+				In[s] = level * static_cast<float>(random() * 2.0 - 1.0);
+			}
+
+			// getBlock may process in place, the reference gets the untouched input
+			std::copy(In.begin(), In.begin() + n, Input.begin());
+			Spectral.getBlock(Input.data(), Out.data() + position, n);
+
+			if (fraction > 0.0) {
+				Reference.getBlock(In.data(), Cascade.data(), n);
+				Fraction.getBlock(Cascade.data(), Expected.data() + position, n);
+			}
+			else {
+				Reference.getBlock(In.data(), Expected.data() + position, n);
+			}
+			position += n;
+		}
+
+		// Against the whole stages the engine's output is late by its latency
+		long long latency = (fraction > 0.0) ? 0 : SpectralDispersion::getLatency();
+
+		Comparison C;
+		for (long long i = 0; i + latency < totalSamples; i += PROCESS_CHUNK_SIZE) {
+			int n = static_cast<int>(std::min<long long>(PROCESS_CHUNK_SIZE, totalSamples - latency - i));
+			C.add(Out.data() + latency + i, Expected.data() + i, n, i);
+		}
+		return C.finish(P, totalSamples - latency);
+	}
+
+	inline Result runSpectral(const Path& P, unsigned seed, double seconds, double sampleRate) {
+		return runSpectralStages(P, seed, seconds, sampleRate, SPECTRAL_CONFORMANCE_STAGES);
+	}
+
+	inline Result runSpectralFraction(const Path& P, unsigned seed, double seconds, double sampleRate) {
+		return runSpectralStages(P, seed, seconds, sampleRate, SPECTRAL_CONFORMANCE_STAGES + 0.5);
+	}
+
+	// Normalised value of a list parameter entry
+	inline double listValue(int index, int numEntries) {
+		return static_cast<double>(index) / (numEntries - 1);
+	}
+
+	/// <summary>
+	/// Every mode of the cascade switching, as the handover path
+	/// </summary>
+	inline void configureModes(Scenario& S) {
+		S.holdCenter();
+		S.useSidechain();
+		S.automate(S.Params.Sidechain, 0.3, 0.7);
+		S.automate(S.Params.Spread, 0.0, 1.0);
+		S.toggle(S.Params.SpreadShape, CIRCULATE_PARAMS::kNumSpreadShapes, CIRCULATE_PARAMS::kNumSpreadShapes);
+		S.toggle(S.Params.Precision, 2, 2);
+		S.toggle(S.Params.Chord, CIRCULATE_PARAMS::kNumChordModes, CIRCULATE_PARAMS::kChordHeldNotes);
+	}
+
+	/// <summary>
+	/// Center and focus held, so the stage coefficients only change with depth
+	/// </summary>
+	inline void holdCoefficients(Scenario& S) {
+		S.holdCenter();
+		S.fix(S.Params.Focus, S.Params.Focus.lastExplicit);
+	}
+
+	inline const Path Paths[] = {
+		{ "cascade", "Unrolled double kernels, shared coefficients", UNROLLED_STAGES, true, 0.0, 0.0, false,
+			[](Scenario&) {} },
+
+		{ "float", "32 bit filter memory (Precision)", UNROLLED_STAGES, false, -115.0, -107.0, false,
+			[](Scenario& S) {
+				S.fix(S.Params.Precision, 1.0);
+			} },
+
+		{ "large", "Stage limit 512, unrolled blocks then the remaining stages", 512, true, 0.0, 0.0, false,
+			[](Scenario&) {} },
+
+		{ "sidechain", "Audio rate modulation, control rate g with fast exp2 and tan", UNROLLED_STAGES, false, -18.0, -12.0, false,
+			[](Scenario& S) {
+				S.holdCenter();
+				S.useSidechain();
+				S.automate(S.Params.Sidechain, 0.3, 0.7);
+			} },
+
+		{ "chord", "Parallel banks in SIMD lanes, control rate lane g", UNROLLED_STAGES, false, -65.0, -21.0, false,
+			[](Scenario& S) {
+				S.holdCenter();
+				S.fix(S.Params.Chord, listValue(CIRCULATE_PARAMS::kChordMajor, CIRCULATE_PARAMS::kNumChordModes));
+				S.toggle(S.Params.Chord, CIRCULATE_PARAMS::kNumChordModes, CIRCULATE_PARAMS::kChordHeldNotes);
+			} },
+
+		{ "chord-float", "Lanes with 32 bit memory", UNROLLED_STAGES, false, -65.0, -21.0, false,
+			[](Scenario& S) {
+				S.holdCenter();
+				S.fix(S.Params.Precision, 1.0);
+				S.fix(S.Params.Chord, listValue(CIRCULATE_PARAMS::kChordMajor, CIRCULATE_PARAMS::kNumChordModes));
+				S.toggle(S.Params.Chord, CIRCULATE_PARAMS::kNumChordModes, CIRCULATE_PARAMS::kChordHeldNotes);
+			} },
+
+		// A new chord glides in where the reference jumps, as in chord, but held notes jump further than
+		// chord intervals, so the outputs drift apart for longer. Held notes that don't change match to -112 dB
+		{ "held-notes", "Chord lanes on held MIDI notes (setHeldNotes), switching chord modes", UNROLLED_STAGES, false, -42.0, -21.0, false,
+			[](Scenario& S) {
+				// The note offset moves held note lanes as the center moves the others
+				S.holdCenter();
+				S.fix(S.Params.NoteOffset, S.Params.NoteOffset.lastExplicit);
+				S.fix(S.Params.Chord, listValue(CIRCULATE_PARAMS::kChordHeldNotes, CIRCULATE_PARAMS::kNumChordModes));
+				S.toggle(S.Params.Chord, CIRCULATE_PARAMS::kNumChordModes, CIRCULATE_PARAMS::kNumChordModes);
+				S.useHeldNotes();
+			} },
+
+		{ "spread", "Per stage coefficients held for SPREAD_CONTROL_INTERVAL samples", UNROLLED_STAGES, false, -28.0, -15.0, false,
+			[](Scenario& S) {
+				S.holdCenter();
+				S.automate(S.Params.Spread, 0.0, 1.0);
+				S.toggle(S.Params.SpreadShape, CIRCULATE_PARAMS::kNumSpreadShapes, CIRCULATE_PARAMS::kNumSpreadShapes);
+			} },
+
+		{ "handover", "Every mode switching, state copied between two effects as linked channels do", UNROLLED_STAGES, false, -18.0, -9.0, true,
+			[](Scenario& S) {
+				configureModes(S);
+			} },
+
+		{ "band-split", "Cascade on the decimated low band (48 kHz and up), against the reference at the reduced rate", UNROLLED_STAGES, true, 0.0, 0.0, false,
+			[](Scenario& S) {
+				S.fix(S.Params.BandSplit, 1.0);
+			} },
+
+		{ "lattice", "Normalized lattice stages, center and focus held", UNROLLED_STAGES, false, BUDGET_TOPOLOGY_HELD, BUDGET_TOPOLOGY_HELD_RUN, false,
+			[](Scenario& S) {
+				holdCoefficients(S);
+			}, CASCADE::kTopologyLattice },
+
+		{ "lattice-float", "Normalized lattice stages, center and focus held, 32 bit memory", UNROLLED_STAGES, false, BUDGET_LATTICE_FLOAT, BUDGET_LATTICE_FLOAT_RUN, false,
+			[](Scenario& S) {
+				holdCoefficients(S);
+				S.fix(S.Params.Precision, 1.0);
+			}, CASCADE::kTopologyLattice },
+
+		{ "lattice-sweep", "Normalized lattice stages, everything automated, stability", UNROLLED_STAGES, false, BUDGET_LATTICE_WINDOW_GAIN, BUDGET_LATTICE_RUN_GAIN, false,
+			[](Scenario&) {}, CASCADE::kTopologyLattice, true },
+
+		{ "lattice-modes", "Lattice with 512 stages, every mode switching and handover, stability", 512, false, BUDGET_LATTICE_WINDOW_GAIN, BUDGET_LATTICE_RUN_GAIN, true,
+			[](Scenario& S) {
+				configureModes(S);
+			}, CASCADE::kTopologyLattice, true },
+
+		{ "tdf2", "Transposed direct form II stages, center and focus held", UNROLLED_STAGES, false, BUDGET_TOPOLOGY_HELD, BUDGET_TOPOLOGY_HELD_RUN, false,
+			[](Scenario& S) {
+				holdCoefficients(S);
+			}, CASCADE::kTopologyTDF2 },
+
+		{ "tdf2-float", "Transposed direct form II stages, center and focus held, 32 bit memory", UNROLLED_STAGES, false, BUDGET_TDF2_FLOAT, BUDGET_TDF2_FLOAT_RUN, false,
+			[](Scenario& S) {
+				holdCoefficients(S);
+				S.fix(S.Params.Precision, 1.0);
+			}, CASCADE::kTopologyTDF2 },
+
+		{ "batch", "BatchEffect, instances in SIMD lanes regrouped as Depth moves, against a CirculateEffect each", UNROLLED_STAGES, true, 0.0, 0.0, false,
+			[](Scenario&) {}, CASCADE::kTopologySVF, false, runBatch },
+
+		{ "spectral", "Spectral engine at 40 stages against the cascade, held settings, latency taken out", SPECTRAL_MAX_STAGES, false, BUDGET_SPECTRAL, BUDGET_SPECTRAL_RUN, false,
+			[](Scenario&) {}, CASCADE::kTopologySVF, false, runSpectral },
+
+		{ "half-stage", "Spectral engine at 40.5 stages against 40 cascade stages and the engine at 0.5", SPECTRAL_MAX_STAGES, false, BUDGET_SPECTRAL_HALF, BUDGET_SPECTRAL_HALF_RUN, false,
+			[](Scenario&) {}, CASCADE::kTopologySVF, false, runSpectralFraction },
+
+		{ "render", "Python render split in time with the estimated pre-roll, against serial rendering, low focus", UNROLLED_STAGES, false, BUDGET_RENDER_SEAMS, BUDGET_RENDER_SEAMS_RUN, false,
+			[](Scenario&) {}, CASCADE::kTopologySVF, false, runRender },
+	};
+
+	/// <summary>
+	/// Run a path for a number of samples and compare with the reference
+	/// </summary>
+	inline Result runPath(const Path& P, unsigned seed, double seconds, double sampleRate) {
+		if (P.run) {
+			return P.run(P, seed, seconds, sampleRate);
+		}
+
+		DenormalHandler AntiDenormal;
+
+		CIRCULATE_PARAMS::AudioEffectParameters Params(static_cast<int>(sampleRate));
+		Scenario S(Params, seed);
+		P.configure(S);
+
+		HELPERS::SetupInfo Setup;
+		Setup.sampleRate = sampleRate;
+		Setup.blockSize = PROCESS_CHUNK_SIZE;
+
+		// Two effects for the handover path, otherwise only the first is used
+		CirculateEffect Effects[2];
+		for (CirculateEffect& Effect : Effects) {
+			Effect.setSampleRateBlockSize(Setup);
+			Effect.getParams(&Params);
+			Effect.setStageLimit(P.stageLimit);
+			Effect.setTopology(P.topology);
+			Effect.reset();
+		}
+		int active = 0;
+
+		ReferenceEffect Reference;
+		Reference.setup(Setup, P.stageLimit);
+		Reference.getParams(&Params);
+
+		// Band split only happens at rates high enough to split
+		bool bandSplit = Params.BandSplit.getLastValue() >= 0.5 && BandSplitter::getFactorForRate(static_cast<int>(sampleRate)) > 1;
+		ReferenceBandSplit ReferenceSplit;
+		if (bandSplit) {
+			ReferenceSplit.setup(Setup, P.stageLimit, &Params);
+		}
+
+		std::vector<float> In(PROCESS_CHUNK_SIZE), Sidechain(PROCESS_CHUNK_SIZE);
+		std::vector<float> Out(PROCESS_CHUNK_SIZE), Expected(PROCESS_CHUNK_SIZE);
+		// getBlock may process in place, the reference gets the untouched input
+		std::vector<float> Input(PROCESS_CHUNK_SIZE);
+
+		Comparison C;
+
+		long long totalSamples = static_cast<long long>(seconds * sampleRate);
+		long long position = 0;
+
+		while (position < totalSamples) {
+			int n = S.nextChunkSize();
+			if (n > totalSamples - position) {
+				n = static_cast<int>(totalSamples - position);
+			}
+
+			S.fillChunk(n);
+			S.fillInput(In.data(), Sidechain.data(), n);
+			const float* sidechain = S.hasSidechain() ? Sidechain.data() : nullptr;
+
+			// As the processor applies the notes of a block, after its parameter changes
+			if (S.hasHeldNotes()) {
+				for (CirculateEffect& Effect : Effects) {
+					Effect.setHeldNotes(S.getHeldNotes(), S.getNumHeldNotes());
+				}
+				Reference.setHeldNotes(S.getHeldNotes(), S.getNumHeldNotes());
+			}
+
+			if (P.handover && S.random() < 0.05) {
+				Effects[1 - active].copyStateFrom(Effects[active]);
+				active = 1 - active;
+			}
+
+			std::copy(In.begin(), In.begin() + n, Input.begin());
+			Effects[active].getBlock(Input.data(), Out.data(), n, sidechain);
+			if (bandSplit) {
+				ReferenceSplit.getBlock(In.data(), Expected.data(), n);
+			}
+			else {
+				Reference.getBlock(In.data(), Expected.data(), n, sidechain);
+			}
+
+			C.add(Out.data(), Expected.data(), n, position);
+			position += n;
+		}
+
+		return C.finish(P, position);
+	}
+}
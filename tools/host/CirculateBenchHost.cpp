@@ -0,0 +1,297 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// Headless host that loads the built Circulate.vst3 bundle through the SDK hosting classes and
+// times every process() call, so the whole shipped path (parameter queues, pre-fill, smoothing,
+// denormal handling, bypass) is measured rather than the DSP alone.
+//
+// Usage: CirculateBenchHost <path/to/Circulate.vst3> [--rate 48000] [--block 256] [--seconds 10]
+//        [--automation none|block|ramp|sample] [--offline] [--mono] [--editor n]
+//
+// --editor n times n editor creations (createView / release) instead of processing. There is no
+// window to attach to, so this measures building the editor and its description, not drawing.
+// It then loads a second instance and checks editors of both open at once, which share the
+// parsed description.
+
+#include "PluginHost.h"
+#include "pluginterfaces/gui/iplugview.h"
+#include "CirculateParameters.h"
+#include "../BenchStats.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace {
+
+	enum AutomationModes {
+		kAutomationNone, // no parameter changes
+		kAutomationBlock, // one point per block on each automated parameter
+		kAutomationRamp, // a point every 32 samples, as a DAW ramp
+		kAutomationSample // a point every sample, the worst case for the queue parsing
+	};
+
+	struct HostOptions {
+		std::string pluginPath;
+		double sampleRate = 48000.0;
+		int blockSize = 256;
+		double seconds = 10.0;
+		int automation = kAutomationRamp;
+		bool offline = false;
+		bool mono = false;
+		int numEditorOpens = 0;
+	};
+
+	bool parseOptions(int argc, char** argv, HostOptions& Options) {
+		if (argc < 2) return false;
+		Options.pluginPath = argv[1];
+
+		for (int i = 2; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--rate" && hasValue) Options.sampleRate = atof(argv[++i]);
+			else if (arg == "--block" && hasValue) Options.blockSize = atoi(argv[++i]);
+			else if (arg == "--seconds" && hasValue) Options.seconds = atof(argv[++i]);
+			else if (arg == "--offline") Options.offline = true;
+			else if (arg == "--mono") Options.mono = true;
+			else if (arg == "--editor" && hasValue) Options.numEditorOpens = atoi(argv[++i]);
+			else if (arg == "--automation" && hasValue) {
+				std::string mode = argv[++i];
+				if (mode == "none") Options.automation = kAutomationNone;
+				else if (mode == "block") Options.automation = kAutomationBlock;
+				else if (mode == "ramp") Options.automation = kAutomationRamp;
+				else if (mode == "sample") Options.automation = kAutomationSample;
+				else return false;
+			}
+			else return false;
+		}
+		return Options.blockSize > 0 && Options.sampleRate > 0.0 && Options.seconds > 0.0;
+	}
+
+	/// <summary>
+	/// Slow LFO shapes for the automated parameters, in normalised values
+	/// </summary>
+	double automationValue(ParamID id, double timeSeconds) {
+		switch (id) {
+		case CIRCULATE_PARAMS::kCenter: return 0.5 + 0.45 * sin(timeSeconds * 2.1);
+		case CIRCULATE_PARAMS::kDepth: return 0.5 + 0.5 * sin(timeSeconds * 0.9);
+		case CIRCULATE_PARAMS::kFeed: return 0.5 + 0.45 * sin(timeSeconds * 0.6);
+		case CIRCULATE_PARAMS::kFocus: return 0.5 + 0.4 * sin(timeSeconds * 1.7);
+		default: return 0.0;
+		}
+	}
+
+	const ParamID AutomatedParams[] = { CIRCULATE_PARAMS::kCenter, CIRCULATE_PARAMS::kDepth, CIRCULATE_PARAMS::kFeed, CIRCULATE_PARAMS::kFocus };
+
+	/// <summary>
+	/// Fill the parameter changes for one block, starting at sample position
+	/// </summary>
+	void fillParameterChanges(ParameterChanges& Changes, int automation, long long position, int numSamples, double sampleRate) {
+		Changes.clearQueue();
+		if (automation == kAutomationNone) return;
+
+		int interval = numSamples;
+		if (automation == kAutomationRamp) interval = 32;
+		if (automation == kAutomationSample) interval = 1;
+
+		for (ParamID id : AutomatedParams) {
+			int32 queueIndex = 0;
+			auto* queue = static_cast<ParameterValueQueue*>(Changes.addParameterData(id, queueIndex));
+			if (!queue) continue;
+			queue->clear();
+
+			for (int s = 0; s < numSamples; s += interval) {
+				int32 pointIndex = 0;
+				queue->addPoint(s, automationValue(id, (position + s) / sampleRate), pointIndex);
+			}
+		}
+	}
+
+	void fillInput(PluginHost& Host, int numSamples, unsigned& rng) {
+		for (int c = 0; c < Host.getNumChannels(); c++) {
+			float* buffer = Host.getInput(c);
+			for (int s = 0; s < numSamples; s++) {
+				rng = rng * 1664525u + 1013904223u;
+				buffer[s] = 0.25f * ((rng >> 8) / 16777216.0f - 0.5f);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Time creating and releasing the editor. The first creation is reported on its own,
+	/// as it includes anything cached for later editors.
+	/// </summary>
+	int benchmarkEditor(PluginHost& Host, int numOpens) {
+		auto Controller = Host.getController();
+		if (!Controller) {
+			fprintf(stderr, "Plug-in has no edit controller\n");
+			return 1;
+		}
+
+		BENCH::TimingStats FirstOpen;
+		BENCH::TimingStats Opens;
+		Opens.reserve(numOpens);
+
+		for (int i = 0; i < numOpens; i++) {
+			auto start = BENCH::Clock::now();
+			IPlugView* View = Controller->createView(ViewType::kEditor);
+			if (View) {
+				View->release();
+			}
+			double ns = BENCH::elapsedNs(start, BENCH::Clock::now());
+
+			if (!View) {
+				fprintf(stderr, "createView returned no editor\n");
+				return 1;
+			}
+			(i == 0 ? FirstOpen : Opens).add(ns, 1);
+		}
+
+		FirstOpen.print(stdout, "first editor", 0.0);
+		Opens.print(stdout, "later editors", 0.0);
+		return 0;
+	}
+
+	bool hasSize(IPlugView* View, ViewRect& Size) {
+		return View && View->getSize(&Size) == kResultTrue && Size.getWidth() > 0 && Size.getHeight() > 0;
+	}
+
+	/// <summary>
+	/// Two instances with their editors open at once, as in a session showing two Circulates.
+	/// Both editors use the one parsed description (SharedUIDescription), so change parameters
+	/// through each, close either while the other stays open and open it again, and remove the
+	/// second instance while the first's editor is open.
+	/// </summary>
+	int checkSharedEditors(PluginHost& Host, const std::string& pluginPath) {
+		auto ControllerA = Host.getController();
+		IPlugView* ViewA = nullptr;
+		ViewRect SizeA;
+		ViewRect SizeB;
+		bool passed = true;
+
+		{
+			PluginHost Second;
+			std::string error;
+			if (!Second.load(pluginPath, error)) {
+				fprintf(stderr, "Could not load a second instance: %s\n", error.c_str());
+				return 1;
+			}
+			auto ControllerB = Second.getController();
+			if (!ControllerA || !ControllerB) {
+				fprintf(stderr, "Plug-in has no edit controller\n");
+				return 1;
+			}
+
+			ViewA = ControllerA->createView(ViewType::kEditor);
+			IPlugView* ViewB = ControllerB->createView(ViewType::kEditor);
+			ControllerA->setParamNormalized(CIRCULATE_PARAMS::kCenter, 0.25);
+			ControllerB->setParamNormalized(CIRCULATE_PARAMS::kCenter, 0.75);
+			passed = passed && hasSize(ViewA, SizeA) && hasSize(ViewB, SizeB);
+
+			// First closed and opened again while the second stays open
+			if (ViewA) {
+				ViewA->release();
+			}
+			ViewA = ControllerA->createView(ViewType::kEditor);
+			ControllerA->setParamNormalized(CIRCULATE_PARAMS::kFocus, 0.9);
+			passed = passed && hasSize(ViewA, SizeA) && hasSize(ViewB, SizeB);
+
+			// And the other way round
+			if (ViewB) {
+				ViewB->release();
+			}
+			ViewB = ControllerB->createView(ViewType::kEditor);
+			passed = passed && hasSize(ViewA, SizeA) && hasSize(ViewB, SizeB);
+
+			if (ViewB) {
+				ViewB->release();
+			}
+		}
+
+		// The second instance is gone (its controller released the description), the first's
+		// editor is still open, and a new one can be made
+		passed = passed && hasSize(ViewA, SizeA);
+		if (ViewA) {
+			ViewA->release();
+		}
+		ViewA = ControllerA ? ControllerA->createView(ViewType::kEditor) : nullptr;
+		passed = passed && hasSize(ViewA, SizeA);
+		if (ViewA) {
+			ViewA->release();
+		}
+
+		printf("two editors open: %s\n", passed ? "ok" : "FAILED");
+		return passed ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv) {
+	HostOptions Options;
+	if (!parseOptions(argc, argv, Options)) {
+		fprintf(stderr, "usage: %s <Circulate.vst3> [--rate hz] [--block samples] [--seconds s] "
+			"[--automation none|block|ramp|sample] [--offline] [--mono] [--editor n]\n", argv[0]);
+		return 1;
+	}
+
+	PluginHost Host;
+	std::string error;
+	if (!Host.load(Options.pluginPath, error)) {
+		fprintf(stderr, "Could not load %s: %s\n", Options.pluginPath.c_str(), error.c_str());
+		return 1;
+	}
+	if (Options.numEditorOpens > 0) {
+		int result = benchmarkEditor(Host, Options.numEditorOpens);
+		if (result == 0) {
+			result = checkSharedEditors(Host, Options.pluginPath);
+		}
+		return result;
+	}
+
+	if (!Host.start(Options.sampleRate, Options.blockSize, Options.offline, Options.mono)) {
+		fprintf(stderr, "setupProcessing failed\n");
+		return 1;
+	}
+
+	ParameterChanges InputChanges(static_cast<int32>(sizeof(AutomatedParams) / sizeof(AutomatedParams[0])));
+
+	long long totalSamples = static_cast<long long>(Options.seconds * Options.sampleRate);
+	long long numBlocks = totalSamples / Options.blockSize;
+	double deadlineNs = Options.blockSize / Options.sampleRate * 1e9;
+
+	BENCH::TimingStats Stats;
+	Stats.reserve(static_cast<size_t>(numBlocks));
+
+	unsigned rng = 1;
+	// One second of warm up, not timed
+	long long warmupBlocks = static_cast<long long>(Options.sampleRate / Options.blockSize);
+
+	for (long long b = 0; b < numBlocks + warmupBlocks; b++) {
+		long long position = b * Options.blockSize;
+		fillParameterChanges(InputChanges, Options.automation, position, Options.blockSize, Options.sampleRate);
+		fillInput(Host, Options.blockSize, rng);
+
+		auto start = BENCH::Clock::now();
+		Host.process(Options.blockSize, &InputChanges);
+		auto end = BENCH::Clock::now();
+
+		if (b >= warmupBlocks) {
+			Stats.add(BENCH::elapsedNs(start, end), Options.blockSize);
+		}
+	}
+
+	Host.stop();
+
+	printf("%s, %.0f Hz, block %d, %s, %s\n", Options.pluginPath.c_str(), Options.sampleRate, Options.blockSize,
+		Options.offline ? "offline" : "realtime", Options.mono ? "mono" : "stereo");
+	Stats.print(stdout, "process()", deadlineNs);
+	printf("CPU load at realtime: %.2f %%\n", 100.0 * Stats.getTotal() / (numBlocks * deadlineNs));
+
+	return 0;
+}
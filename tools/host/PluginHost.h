@@ -0,0 +1,126 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+#pragma once
+#include "public.sdk/source/vst/hosting/module.h"
+#include "public.sdk/source/vst/hosting/hostclasses.h"
+#include "public.sdk/source/vst/hosting/plugprovider.h"
+#include "public.sdk/source/vst/hosting/processdata.h"
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "pluginterfaces/vst/ivstcomponent.h"
+#include "pluginterfaces/vst/ivsteditcontroller.h"
+
+#include <cstdio>
+#include <string>
+
+/// <summary>
+/// Minimal headless host for the tools: loads a .vst3 bundle with the SDK hosting classes,
+/// sets up the main bus and prepares the process buffers. Everything here runs on one thread.
+/// </summary>
+class PluginHost {
+public:
+	~PluginHost() {
+		stop();
+	}
+
+	/// <summary>
+	/// Load the bundle and create the first audio effect class in it
+	/// </summary>
+	bool load(const std::string& path, std::string& error) {
+		Steinberg::Vst::PluginContextFactory::instance().setPluginContext(&HostApp);
+
+		Module = VST3::Hosting::Module::create(path, error);
+		if (!Module) {
+			return false;
+		}
+
+		auto Factory = Module->getFactory();
+		for (auto& ClassInfo : Factory.classInfos()) {
+			if (ClassInfo.category() == kVstAudioEffectClass) {
+				Provider = Steinberg::owned(new Steinberg::Vst::PlugProvider(Factory, ClassInfo, true));
+				break;
+			}
+		}
+		if (!Provider || !Provider->initialize()) {
+			error = "no audio effect could be created";
+			return false;
+		}
+
+		Component = Steinberg::owned(Provider->getComponent());
+		Processor = Steinberg::FUnknownPtr<Steinberg::Vst::IAudioProcessor>(Component);
+		if (!Component || !Processor) {
+			error = "plug-in has no audio processor";
+			return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Set up the main bus (the sidechain stays inactive as in most hosts), activate and
+	/// start processing
+	/// </summary>
+	bool start(double sampleRate, int maxBlockSize, bool offline, bool mono) {
+		Steinberg::Vst::SpeakerArrangement Arrangement = mono ? Steinberg::Vst::SpeakerArr::kMono : Steinberg::Vst::SpeakerArr::kStereo;
+		Processor->setBusArrangements(&Arrangement, 1, &Arrangement, 1);
+		Component->activateBus(Steinberg::Vst::kAudio, Steinberg::Vst::kInput, 0, true);
+		Component->activateBus(Steinberg::Vst::kAudio, Steinberg::Vst::kOutput, 0, true);
+
+		Steinberg::Vst::ProcessSetup Setup { offline ? Steinberg::Vst::kOffline : Steinberg::Vst::kRealtime,
+			Steinberg::Vst::kSample32, maxBlockSize, sampleRate };
+		if (Processor->setupProcessing(Setup) != Steinberg::kResultOk) {
+			return false;
+		}
+		Component->setActive(true);
+		Processor->setProcessing(true);
+		isRunning = true;
+
+		Data.prepare(*Component, maxBlockSize, Steinberg::Vst::kSample32);
+		Data.processMode = Setup.processMode;
+		numChannels = mono ? 1 : 2;
+		return true;
+	}
+
+	void stop() {
+		if (isRunning) {
+			Processor->setProcessing(false);
+			Component->setActive(false);
+			isRunning = false;
+		}
+	}
+
+	float* getInput(int channel) {
+		return Data.inputs[0].channelBuffers32[channel];
+	}
+
+	int getNumChannels() const {
+		return numChannels;
+	}
+
+	Steinberg::tresult process(int numSamples, Steinberg::Vst::IParameterChanges* changes) {
+		Data.numSamples = numSamples;
+		Data.inputParameterChanges = changes;
+		return Processor->process(Data);
+	}
+
+	Steinberg::Vst::PlugProvider* getProvider() {
+		return Provider;
+	}
+
+	/// <summary>
+	/// The edit controller, connected to the component by the provider
+	/// </summary>
+	Steinberg::IPtr<Steinberg::Vst::IEditController> getController() {
+		return Steinberg::owned(Provider->getController());
+	}
+
+private:
+	Steinberg::Vst::HostApplication HostApp;
+	VST3::Hosting::Module::Ptr Module;
+	Steinberg::IPtr<Steinberg::Vst::PlugProvider> Provider;
+	Steinberg::IPtr<Steinberg::Vst::IComponent> Component;
+	Steinberg::IPtr<Steinberg::Vst::IAudioProcessor> Processor;
+	Steinberg::Vst::HostProcessData Data;
+	int numChannels = 2;
+	bool isRunning = false;
+};
@@ -0,0 +1,260 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// Precision harness for the 32 bit filter memory (the Precision parameter). Runs the effect with
+// float and with double memory side by side, on the same parameters and input, at the settings
+// where single precision is weakest: low centers (g close to 0, so s2 takes tiny increments),
+// high focus and the full 64 stages. For each case it reports
+//   noise floor - RMS of the float output's difference from the double output, relative to the
+//                 double output, over the whole input
+//   drift       - the same over the last second of input minus the first second, positive when
+//                 the error grows with time rather than staying at the rounding level
+//   tail        - energy of the float output over the last second of the silence after the
+//                 input, relative to the double output's, positive when the float memory rings
+//                 on or grows where the double memory decays
+// and checks each against its budget. Exits with 1 if any case is over budget.
+//
+// The memory is updated without compensation, so at low centers the float error does grow, by
+// about 20 dB over 10 seconds and a few dB more over 30. The budgets are a few dB over what the
+// default 10 seconds measure, so they catch a kernel change that makes it worse, and the noise
+// budgets hold the result well under audibility. At 30 seconds the lowest centers are over them.
+//
+// Usage: CirculatePrecision [--rate 48000] [--seconds 10] [--tail 2] [--case name]
+
+#include "CirculateEffect.h"
+#include "CirculateParameters.h"
+#include "DenormalProtection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Float tail over the double tail, in dB
+#define PRECISION_BUDGET_TAIL 1.0
+
+namespace {
+
+	struct PrecisionOptions {
+		double sampleRate = 48000.0;
+		double seconds = 10.0;
+		double tail = 2.0;
+		std::string caseName;
+	};
+
+	struct PrecisionCase {
+		const char* name;
+		double centerHz;
+		double focus; // normalised
+		double feedback; // normalised, 0.5 is none
+		double noiseBudgetDb; // max noise floor
+		double driftBudgetDb; // max error growth over the run
+	};
+
+	const PrecisionCase Cases[] = {
+		{ "mid",           1000.0, 0.5, 0.5, -105.0, 3.0 },
+		{ "mid-high-q",    1000.0, 1.0, 0.5, -100.0, 4.0 },
+		{ "low",             40.0, 0.5, 0.5, -85.0, 10.0 },
+		{ "low-high-q",      40.0, 1.0, 0.5, -75.0, 22.0 },
+		{ "lowest-high-q",   20.0, 1.0, 0.5, -83.0, 19.0 },
+		{ "low-feedback",    40.0, 1.0, 0.95, -75.0, 22.0 },
+		{ "high-high-q",   8000.0, 1.0, 0.5, -93.0, 3.0 },
+	};
+
+	struct PrecisionResult {
+		double noiseDb = -INFINITY;
+		double driftDb = 0.0;
+		double tailDb = 0.0;
+		bool finite = true;
+		bool passed = false;
+	};
+
+	void printUsage() {
+		printf("Usage: CirculatePrecision [--rate 48000] [--seconds 10] [--tail 2] [--case name]\n\nCases (64 stages):\n");
+		for (const PrecisionCase& C : Cases) {
+			printf("  %-14s %6.0f Hz, focus %.2f, feedback %.2f (noise %.0f dB, drift %.0f dB)\n", C.name, C.centerHz, C.focus,
+				C.feedback, C.noiseBudgetDb, C.driftBudgetDb);
+		}
+	}
+
+	bool parseOptions(int argc, char* argv[], PrecisionOptions& Options) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--rate" && hasValue) {
+				Options.sampleRate = atof(argv[++i]);
+			}
+			else if (arg == "--seconds" && hasValue) {
+				Options.seconds = atof(argv[++i]);
+			}
+			else if (arg == "--tail" && hasValue) {
+				Options.tail = atof(argv[++i]);
+			}
+			else if (arg == "--case" && hasValue) {
+				Options.caseName = argv[++i];
+			}
+			else {
+				return false;
+			}
+		}
+		return Options.sampleRate > 0.0 && Options.seconds >= 2.0 && Options.tail >= 1.0;
+	}
+
+	double toDb(double ratio) {
+		return ratio > 0.0 ? 10.0 * log10(ratio) : -INFINITY;
+	}
+
+	PrecisionResult runCase(const PrecisionCase& C, const PrecisionOptions& Options) {
+		DenormalHandler AntiDenormal;
+
+		CIRCULATE_PARAMS::AudioEffectParameters Params(static_cast<int>(Options.sampleRate));
+
+		HELPERS::SetupInfo Setup;
+		Setup.sampleRate = Options.sampleRate;
+		Setup.blockSize = PROCESS_CHUNK_SIZE;
+
+		// Index 0 keeps double memory, 1 float
+		CirculateEffect Effects[2];
+		for (CirculateEffect& Effect : Effects) {
+			Effect.setSampleRateBlockSize(Setup);
+			Effect.getParams(&Params);
+			Effect.setStageLimit(UNROLLED_STAGES);
+			Effect.reset();
+		}
+
+		// Center in Hz, as the effect maps it
+		double maxHz = std::min<double>(MAX_FREQ_HZ, Options.sampleRate / 2.0 - 500.0);
+		double center = log(C.centerHz / MIN_FREQ_HZ) / log(maxHz / MIN_FREQ_HZ);
+
+		Params.CenterType.fillWith(0.0);
+		Params.Center.fillWith(center);
+		Params.Focus.fillWith(C.focus);
+		Params.Depth.fillWith(1.0);
+		Params.Feedback.fillWith(C.feedback);
+		for (CIRCULATE_PARAMS::ParamUnit* Unit : Params.ParameterList) {
+			Unit->lastExplicit = Unit->getLastValue();
+		}
+
+		long long rate = static_cast<long long>(Options.sampleRate);
+		long long inputSamples = static_cast<long long>(Options.seconds * Options.sampleRate);
+		long long totalSamples = inputSamples + static_cast<long long>(Options.tail * Options.sampleRate);
+
+		std::vector<float> In(PROCESS_CHUNK_SIZE), Input(PROCESS_CHUNK_SIZE);
+		std::vector<float> Out[2] = { std::vector<float>(PROCESS_CHUNK_SIZE), std::vector<float>(PROCESS_CHUNK_SIZE) };
+
+		double errorEnergy = 0.0, referenceEnergy = 0.0;
+		double firstError = 0.0, firstReference = 0.0;
+		double lastError = 0.0, lastReference = 0.0;
+		double tailEnergy[2] = { 0.0, 0.0 };
+
+		PrecisionResult R;
+		unsigned rng = 12345u;
+		long long position = 0;
+
+		while (position < totalSamples) {
+			int n = static_cast<int>(std::min<long long>(PROCESS_CHUNK_SIZE, totalSamples - position));
+
+			for (int s = 0; s < n; s++) {
+				rng = rng * 1664525u + 1013904223u;
+				In[s] = position + s < inputSamples ? 0.25f * static_cast<float>((rng >> 8) / 8388608.0 - 1.0) : 0.0f;
+			}
+
+			for (int e = 0; e < 2; e++) {
+				Params.setCurrentBlockSizeAndPreFill(n);
+				Params.Precision.fillWith(static_cast<double>(e));
+				Params.Precision.lastExplicit = static_cast<double>(e);
+				Params.smoothAllParameters();
+
+				std::copy(In.begin(), In.begin() + n, Input.begin());
+				Effects[e].getBlock(Input.data(), Out[e].data(), n);
+			}
+
+			for (int s = 0; s < n; s++) {
+				long long i = position + s;
+				double reference = Out[0][s];
+				double error = static_cast<double>(Out[1][s]) - reference;
+
+				if (!std::isfinite(Out[1][s])) {
+					R.finite = false;
+				}
+
+				if (i < inputSamples) {
+					errorEnergy += error * error;
+					referenceEnergy += reference * reference;
+					if (i < rate) {
+						firstError += error * error;
+						firstReference += reference * reference;
+					}
+					if (i >= inputSamples - rate) {
+						lastError += error * error;
+						lastReference += reference * reference;
+					}
+				}
+				else if (i >= totalSamples - rate) {
+					tailEnergy[0] += reference * reference;
+					tailEnergy[1] += static_cast<double>(Out[1][s]) * Out[1][s];
+				}
+			}
+
+			position += n;
+		}
+
+		R.noiseDb = toDb(errorEnergy / referenceEnergy);
+		R.driftDb = toDb(lastError / lastReference) - toDb(firstError / firstReference);
+		if (!std::isfinite(R.driftDb)) {
+			R.driftDb = 0.0; // both windows exact
+		}
+
+		// Both silent (flushed to zero) is as stable as it gets
+		if (tailEnergy[1] > 0.0) {
+			R.tailDb = tailEnergy[0] > 0.0 ? toDb(tailEnergy[1] / tailEnergy[0]) : INFINITY;
+		}
+
+		R.passed = R.finite && R.noiseDb <= C.noiseBudgetDb && R.driftDb <= C.driftBudgetDb && R.tailDb <= PRECISION_BUDGET_TAIL;
+		return R;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	PrecisionOptions Options;
+	if (!parseOptions(argc, argv, Options)) {
+		printUsage();
+		return 2;
+	}
+
+	printf("%.0f Hz, %.1f s of noise then %.1f s of silence, %d stages, float memory against double\n", Options.sampleRate,
+		Options.seconds, Options.tail, UNROLLED_STAGES);
+	printf("Tail budget %.0f dB\n\n", PRECISION_BUDGET_TAIL);
+	printf("%-14s %10s %10s %10s %10s %10s  %s\n", "case", "noise dB", "budget", "drift dB", "budget", "tail dB", "result");
+
+	int numRun = 0;
+	int numFailed = 0;
+
+	for (const PrecisionCase& C : Cases) {
+		if (!Options.caseName.empty() && Options.caseName != C.name) {
+			continue;
+		}
+
+		PrecisionResult R = runCase(C, Options);
+		printf("%-14s %10.1f %10.0f %10.1f %10.0f %10.1f  %s\n", C.name, R.noiseDb, C.noiseBudgetDb, R.driftDb, C.driftBudgetDb, R.tailDb,
+			R.passed ? "pass" : (R.finite ? "FAIL" : "FAIL (not finite)"));
+
+		numRun++;
+		if (!R.passed) {
+			numFailed++;
+		}
+	}
+
+	if (numRun == 0) {
+		printf("No case named '%s'\n", Options.caseName.c_str());
+		printUsage();
+		return 2;
+	}
+
+	printf("\n%d of %d cases within budget\n", numRun - numFailed, numRun);
+	return numFailed > 0 ? 1 : 0;
+}
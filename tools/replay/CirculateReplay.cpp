@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// Replays a capture file (recorded by the plug-in with CIRCULATE_CAPTURE=<file> set) into the
+// built bundle: the same block sizes and parameter queue points, in the same order, with the
+// input replaced by deterministic noise at the captured peak level (silence stays silence, dual
+// mono stays dual mono). Each process() call is timed, and the slowest blocks are listed so a
+// spike can be traced back to the automation that caused it.
+//
+// A capture whose recorder dropped blocks (the ring was full) has gaps and isn't replayed unless
+// --allow-dropped is given. Each capture is its own file, <CIRCULATE_CAPTURE>.<pid>.<n>.
+//
+// Usage: CirculateReplay <path/to/Circulate.vst3> <capture file> [--repeat n] [--slowest n] [--allow-dropped]
+
+#include "PluginHost.h"
+#include "AutomationCapture.h"
+#include "../BenchStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace {
+
+	/// <summary>
+	/// Parameter queues of one captured block, the points are stored in queue order
+	/// </summary>
+	void fillParameterChanges(ParameterChanges& Changes, const std::vector<CAPTURE::PointRecord>& Points) {
+		Changes.clearQueue();
+
+		ParameterValueQueue* queue = nullptr;
+		for (size_t p = 0; p < Points.size(); p++) {
+			if (!queue || queue->getParameterId() != Points[p].paramID) {
+				int32 queueIndex = 0;
+				queue = static_cast<ParameterValueQueue*>(Changes.addParameterData(Points[p].paramID, queueIndex));
+				if (!queue) continue;
+				queue->clear();
+			}
+			int32 pointIndex = 0;
+			queue->addPoint(Points[p].sampleOffset, Points[p].value, pointIndex);
+		}
+	}
+
+	void fillInput(PluginHost& Host, const CAPTURE::BlockHeader& Block, unsigned& rng) {
+		int numChannels = Host.getNumChannels();
+		for (int c = 0; c < numChannels; c++) {
+			float* buffer = Host.getInput(c);
+			if (c > 0 && (Block.flags & CAPTURE::kChannelsIdentical)) {
+				std::copy(Host.getInput(0), Host.getInput(0) + Block.numSamples, buffer);
+				continue;
+			}
+			for (int s = 0; s < Block.numSamples; s++) {
+				rng = rng * 1664525u + 1013904223u;
+				buffer[s] = Block.inputPeak * ((rng >> 8) / 8388608.0f - 1.0f);
+			}
+		}
+	}
+
+	struct SlowBlock {
+		long long index = 0;
+		double ns = 0.0;
+		int numSamples = 0;
+		unsigned numPoints = 0;
+	};
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <Circulate.vst3> <capture file> [--repeat n] [--slowest n] [--allow-dropped]\n", argv[0]);
+		return 1;
+	}
+	std::string pluginPath = argv[1];
+	std::string capturePath = argv[2];
+	int numRepeats = 1;
+	int numSlowest = 10;
+	bool allowDropped = false;
+	for (int i = 3; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--allow-dropped") allowDropped = true;
+		else if (arg == "--repeat" && i + 1 < argc) numRepeats = atoi(argv[++i]);
+		else if (arg == "--slowest" && i + 1 < argc) numSlowest = atoi(argv[++i]);
+	}
+
+	CAPTURE::CaptureReader Reader;
+	if (!Reader.open(capturePath)) {
+		fprintf(stderr, "Could not read capture %s\n", capturePath.c_str());
+		return 1;
+	}
+	const CAPTURE::FileHeader& Header = Reader.getHeader();
+
+	if (!Reader.isComplete()) {
+		fprintf(stderr, "Warning: %s has no trailer (the host didn't stop the plug-in), blocks may be missing\n", capturePath.c_str());
+	}
+	else if (Reader.getTrailer().droppedBlocks > 0) {
+		fprintf(stderr, "%s: %u of %llu blocks were dropped while recording, the replay has gaps%s\n", capturePath.c_str(),
+			Reader.getTrailer().droppedBlocks, static_cast<unsigned long long>(Reader.getTrailer().recordedBlocks + Reader.getTrailer().droppedBlocks),
+			allowDropped ? "" : " (--allow-dropped to replay anyway)");
+		if (!allowDropped) {
+			return 1;
+		}
+	}
+
+	// Channel count is taken from the first block
+	CAPTURE::BlockHeader Block;
+	std::vector<CAPTURE::PointRecord> Points;
+	bool mono = Reader.readBlock(Block, Points) && Block.numChannels == 1;
+	Reader.rewind();
+
+	PluginHost Host;
+	std::string error;
+	if (!Host.load(pluginPath, error)) {
+		fprintf(stderr, "Could not load %s: %s\n", pluginPath.c_str(), error.c_str());
+		return 1;
+	}
+	if (!Host.start(Header.sampleRate, Header.maxBlockSize, Header.processMode == kOffline, mono)) {
+		fprintf(stderr, "setupProcessing failed\n");
+		return 1;
+	}
+
+	// One queue per parameter, grown as needed by addParameterData
+	ParameterChanges InputChanges(64);
+	BENCH::TimingStats Stats;
+	std::vector<SlowBlock> SlowBlocks;
+	unsigned rng = 1;
+	long long numBlocks = 0;
+
+	for (int r = 0; r < numRepeats; r++) {
+		Reader.rewind();
+		long long index = 0;
+
+		while (Reader.readBlock(Block, Points)) {
+			if (Block.numSamples > Header.maxBlockSize) {
+				fprintf(stderr, "Block %lld is larger than the captured max block size, skipped\n", index);
+				index++;
+				continue;
+			}
+			fillParameterChanges(InputChanges, Points);
+			fillInput(Host, Block, rng);
+
+			auto start = BENCH::Clock::now();
+			Host.process(Block.numSamples, &InputChanges);
+			double ns = BENCH::elapsedNs(start, BENCH::Clock::now());
+
+			Stats.add(ns, Block.numSamples);
+			SlowBlocks.push_back({ index, ns, Block.numSamples, Block.numPoints });
+			index++;
+		}
+		numBlocks = index;
+	}
+	Host.stop();
+
+	double deadlineNs = Header.maxBlockSize / Header.sampleRate * 1e9;
+	printf("%s: %lld blocks, %.0f Hz, max block %d, %s\n", capturePath.c_str(), numBlocks, Header.sampleRate,
+		Header.maxBlockSize, Header.processMode == kOffline ? "offline" : "realtime");
+	Stats.print(stdout, "process()", deadlineNs);
+
+	numSlowest = std::min(numSlowest, static_cast<int>(SlowBlocks.size()));
+	std::partial_sort(SlowBlocks.begin(), SlowBlocks.begin() + numSlowest, SlowBlocks.end(),
+		[](const SlowBlock& a, const SlowBlock& b) { return a.ns > b.ns; });
+	for (int i = 0; i < numSlowest; i++) {
+		printf("  block %8lld  %8.2f us  %5d samples  %6u points\n", SlowBlocks[i].index, SlowBlocks[i].ns / 1000.0,
+			SlowBlocks[i].numSamples, SlowBlocks[i].numPoints);
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// State loading check. Loads states into the processor as older versions saved them, from the
+// 8 values of version 2 (64 bytes) up to every value, and reads them back with getState. The
+// values a state has must come back as saved, the ones appended since must come back at their
+// defaults, not at the 0.0 readDouble leaves when the stream has run out. Exits with 1 if any
+// value is wrong.
+//
+// Usage: CirculateStateCheck
+
+#include "processor.h"
+#include "CirculateParameters.h"
+#include "base/source/fstreamer.h"
+#include "public.sdk/source/common/memorystream.h"
+
+#include <cstdio>
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace {
+
+	// Values in the order getState writes them, the first 8 are in every version
+	struct StateValue {
+		const char* name;
+		double saved; // different from the default
+		double defaultValue;
+	};
+
+	const StateValue Values[] = {
+		{ "depth", 0.25, DEFAULT_DEPTH },
+		{ "center", 0.75, DEFAULT_CENTER },
+		{ "note", 0.25, DEFAULT_NOTE },
+		{ "focus", 0.75, DEFAULT_FOCUS },
+		{ "type", 1.0, DEFAULT_SWITCH },
+		{ "offset", 0.25, DEFAULT_OFFSET },
+		{ "bypass", 1.0, 0.0 },
+		{ "feed", 0.75, DEFAULT_FEED },
+		{ "stereo", 1.0, DEFAULT_STEREO },
+		{ "sidechain", 0.25, DEFAULT_SIDECHAIN },
+		{ "chord", 0.5, DEFAULT_CHORD },
+		{ "precision", 1.0, DEFAULT_PRECISION },
+		{ "engine", 1.0, DEFAULT_ENGINE },
+		{ "spread", 0.5, DEFAULT_SPREAD },
+		{ "spread shape", 1.0, DEFAULT_SPREAD_SHAPE },
+		{ "stage limit", 1.0, DEFAULT_STAGE_LIMIT },
+		{ "band split", 1.0, DEFAULT_BAND_SPLIT },
+	};
+	const int numValues = sizeof(Values) / sizeof(Values[0]);
+	const int numVersion2Values = 8;
+
+	/// <summary>
+	/// Load a state of the first numSaved values into a new processor and check what getState gives back
+	/// </summary>
+	/// <returns> number of wrong values, -1 if the state didn't load</returns>
+	int checkState(int numSaved) {
+		auto* Processor = new CirculateVST::CirculateProcessor;
+		Processor->initialize(nullptr);
+
+		// setState needs the parameters, which are made here
+		ProcessSetup Setup { kRealtime, kSample32, PROCESS_CHUNK_SIZE, 48000.0 };
+		Processor->setupProcessing(Setup);
+
+		MemoryStream Saved;
+		IBStreamer Writer(&Saved, kLittleEndian);
+		for (int i = 0; i < numSaved; i++) {
+			Writer.writeDouble(Values[i].saved);
+		}
+		Saved.seek(0, IBStream::kIBSeekSet, nullptr);
+
+		int numWrong = -1;
+		if (Processor->setState(&Saved) == kResultOk) {
+			MemoryStream Loaded;
+			Processor->getState(&Loaded);
+			Loaded.seek(0, IBStream::kIBSeekSet, nullptr);
+
+			IBStreamer Reader(&Loaded, kLittleEndian);
+			numWrong = 0;
+			for (int i = 0; i < numValues; i++) {
+				double expected = (i < numSaved) ? Values[i].saved : Values[i].defaultValue;
+				double value = 0.0;
+				if (!Reader.readDouble(value) || value != expected) {
+					printf("  %d values saved: %s is %g, expected %g\n", numSaved, Values[i].name, value, expected);
+					numWrong++;
+				}
+			}
+		}
+
+		Processor->terminate();
+		Processor->release();
+		return numWrong;
+	}
+}
+
+int main() {
+	printf("%-8s %8s %8s  %s\n", "values", "bytes", "wrong", "result");
+
+	int numFailed = 0;
+	for (int numSaved = numVersion2Values; numSaved <= numValues; numSaved++) {
+		int numWrong = checkState(numSaved);
+		bool passed = numWrong == 0;
+		printf("%-8d %8d %8d  %s\n", numSaved, numSaved * static_cast<int>(sizeof(double)), numWrong,
+			passed ? "pass" : (numWrong < 0 ? "FAIL (not loaded)" : "FAIL"));
+		if (!passed) {
+			numFailed++;
+		}
+	}
+
+	printf("\n%d of %d states loaded as saved\n", numValues - numVersion2Values + 1 - numFailed, numValues - numVersion2Values + 1);
+	return numFailed > 0 ? 1 : 0;
+}
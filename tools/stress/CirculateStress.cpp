@@ -0,0 +1,491 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2025 Anis Dadou (GullDSP)
+//------------------------------------------------------------------------
+
+// Worst case block time harness. Drives adversarial automation and block sizes through
+// AudioEffectParameters and CirculateEffect (the same calls the processor makes for one channel)
+// and reports the per block time distribution against a deadline. Average ns/sample hides the
+// spikes that cause dropouts, so the tail percentiles are what to budget against.
+//
+// --depths runs every case at each number of stages, --topologies in each stage topology
+// (CASCADE::Topologies), --counters adds the hardware counters of the timed blocks
+// (PerfCounters.h) and --csv writes a row per case with the timings and counters.
+//
+// Usage: CirculateStress [--rate 48000] [--blocks 32,128,512,2048|random] [--seconds 5]
+//        [--deadline-percent 100] [--scenario name] [--stage-limit 64] [--depths 8,32,64]
+//        [--topologies svf,lattice,tdf2] [--counters] [--csv results.csv] [--strict] [--trace trace.json]
+
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#include "CirculateEffect.h"
+#include "CirculateParameters.h"
+#include "DenormalProtection.h"
+#include "Trace.h"
+#include "../BenchStats.h"
+#include "../PerfCounters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace {
+
+	struct StressOptions {
+		double sampleRate = 48000.0;
+		std::vector<int> BlockSizes = { 32, 128, 512, 2048 };
+		bool randomBlockSizes = false;
+		double seconds = 5.0;
+		double deadlinePercent = 100.0;
+		std::string scenario;
+		std::string tracePath;
+		std::string csvPath;
+		int stageLimit = UNROLLED_STAGES; // full Depth is this many stages
+		std::vector<int> Depths; // stages of the static Depth, empty for just the stage limit
+		std::vector<int> Topologies; // empty for just the SVF
+		bool counters = false;
+		bool strict = false;
+	};
+
+	const char* TopologyNames[CASCADE::kNumTopologies] = { "svf", "lattice", "tdf2" };
+
+	/// <summary>
+	/// Comma separated topology names
+	/// </summary>
+	bool parseTopologies(const std::string& list, std::vector<int>& Topologies) {
+		Topologies.clear();
+		size_t start = 0;
+		while (start < list.size()) {
+			size_t end = list.find(',', start);
+			if (end == std::string::npos) end = list.size();
+			std::string name = list.substr(start, end - start);
+
+			int topology = -1;
+			for (int t = 0; t < CASCADE::kNumTopologies; t++) {
+				if (name == TopologyNames[t]) topology = t;
+			}
+			if (topology < 0) return false;
+			Topologies.push_back(topology);
+			start = end + 1;
+		}
+		return !Topologies.empty();
+	}
+
+	/// <summary>
+	/// Comma separated positive or zero integers
+	/// </summary>
+	bool parseList(const std::string& list, std::vector<int>& Values) {
+		Values.clear();
+		size_t start = 0;
+		while (start < list.size()) {
+			size_t end = list.find(',', start);
+			if (end == std::string::npos) end = list.size();
+			std::string entry = list.substr(start, end - start);
+			if (entry.empty() || entry.find_first_not_of("0123456789") != std::string::npos) return false;
+			Values.push_back(atoi(entry.c_str()));
+			start = end + 1;
+		}
+		return !Values.empty();
+	}
+
+	/// <summary>
+	/// Everything a scenario can change for one block
+	/// </summary>
+	struct BlockContext {
+		ParameterChanges* Changes = nullptr;
+		float* in = nullptr;
+		float* sidechain = nullptr; // nullptr unless the scenario fills it
+		int numSamples = 0;
+		long long position = 0;
+		unsigned* rng = nullptr;
+
+		double random() {
+			*rng = *rng * 1664525u + 1013904223u;
+			return (*rng >> 8) / 16777216.0;
+		}
+
+		/// <summary>
+		/// Add a point every interval samples with the value from valueAt(sample position)
+		/// </summary>
+		template <typename ValueFunction>
+		void addPoints(ParamID id, int interval, ValueFunction valueAt) {
+			int32 queueIndex = 0;
+			auto* queue = static_cast<ParameterValueQueue*>(Changes->addParameterData(id, queueIndex));
+			if (!queue) return;
+			queue->clear();
+
+			for (int s = 0; s < numSamples; s += interval) {
+				int32 pointIndex = 0;
+				queue->addPoint(s, valueAt(position + s), pointIndex);
+			}
+		}
+
+		void fillNoise(float level) {
+			for (int s = 0; s < numSamples; s++) {
+				in[s] = level * static_cast<float>(random() * 2.0 - 1.0);
+			}
+		}
+	};
+
+	using ScenarioFunction = void (*)(BlockContext&);
+
+	struct Scenario {
+		const char* name;
+		const char* description;
+		ScenarioFunction fill;
+		bool useSidechain;
+	};
+
+	// Normalised value of a list parameter entry
+	double listValue(int index, int numEntries) {
+		return static_cast<double>(index) / (numEntries - 1);
+	}
+
+	const Scenario Scenarios[] = {
+		{ "baseline", "Full Depth (the stage limit), no automation",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+			}, false },
+
+		{ "depth-every-sample", "random Depth every sample, stage count jumps reset filter memory",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				B.addPoints(CIRCULATE_PARAMS::kDepth, 1, [&B](long long) { return B.random(); });
+			}, false },
+
+		{ "depth-sweep", "Depth 0 to the stage limit and back every 128 samples",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				B.addPoints(CIRCULATE_PARAMS::kDepth, 1, [](long long t) { return fabs(static_cast<double>(t % 128) / 64.0 - 1.0); });
+			}, false },
+
+		{ "center-sweep", "Center full range at 10 Hz, a point every sample",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				B.addPoints(CIRCULATE_PARAMS::kCenter, 1, [](long long t) { return 0.5 + 0.5 * sin(t * (2.0 * 3.14159265 * 10.0 / 48000.0)); });
+			}, false },
+
+		{ "feedback-snap", "Feed alternating between the extremes every sample",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				B.addPoints(CIRCULATE_PARAMS::kFeed, 1, [](long long t) { return (t & 1) ? 1.0 : 0.0; });
+			}, false },
+
+		{ "limiter", "Maximum feedback and focus with a hot input, the limiter engages",
+			[](BlockContext& B) {
+				B.fillNoise(4.0f);
+				B.addPoints(CIRCULATE_PARAMS::kFeed, B.numSamples, [](long long) { return 1.0; });
+				B.addPoints(CIRCULATE_PARAMS::kFocus, B.numSamples, [](long long) { return 1.0; });
+			}, false },
+
+		{ "sidechain", "Sidechain at +4 octaves with a gated envelope",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				for (int s = 0; s < B.numSamples; s++) {
+					B.sidechain[s] = ((B.position + s) % 4800 < 2400) ? static_cast<float>(B.random()) : 0.0f;
+				}
+				B.addPoints(CIRCULATE_PARAMS::kSidechain, B.numSamples, [](long long) { return 1.0; });
+			}, true },
+
+		{ "chord-switching", "Chord mode changed every block, Center every sample",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				int mode = static_cast<int>(B.random() * CIRCULATE_PARAMS::kNumChordModes) % CIRCULATE_PARAMS::kNumChordModes;
+				B.addPoints(CIRCULATE_PARAMS::kChord, B.numSamples, [mode](long long) { return listValue(mode, CIRCULATE_PARAMS::kNumChordModes); });
+				B.addPoints(CIRCULATE_PARAMS::kCenter, 1, [](long long t) { return 0.5 + 0.4 * sin(t * 0.001); });
+			}, false },
+
+		{ "precision-switching", "Precision toggled every block",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				double precision = (B.position / B.numSamples) & 1 ? 1.0 : 0.0;
+				B.addPoints(CIRCULATE_PARAMS::kPrecision, B.numSamples, [precision](long long) { return precision; });
+			}, false },
+
+		{ "spread-sweep", "Spread swept over the full range, shape changed every block, Center every sample",
+			[](BlockContext& B) {
+				B.fillNoise(0.25f);
+				int shape = static_cast<int>(B.random() * CIRCULATE_PARAMS::kNumSpreadShapes) % CIRCULATE_PARAMS::kNumSpreadShapes;
+				B.addPoints(CIRCULATE_PARAMS::kSpreadShape, B.numSamples, [shape](long long) { return listValue(shape, CIRCULATE_PARAMS::kNumSpreadShapes); });
+				B.addPoints(CIRCULATE_PARAMS::kSpread, 1, [](long long t) { return 0.5 + 0.5 * sin(t * 0.0007); });
+				B.addPoints(CIRCULATE_PARAMS::kCenter, 1, [](long long t) { return 0.5 + 0.4 * sin(t * 0.001); });
+			}, false },
+
+		{ "everything", "All of the above at once",
+			[](BlockContext& B) {
+				B.fillNoise(4.0f);
+				for (int s = 0; s < B.numSamples; s++) {
+					B.sidechain[s] = static_cast<float>(B.random());
+				}
+				B.addPoints(CIRCULATE_PARAMS::kDepth, 1, [&B](long long) { return B.random(); });
+				B.addPoints(CIRCULATE_PARAMS::kCenter, 1, [](long long t) { return 0.5 + 0.5 * sin(t * 0.0013); });
+				B.addPoints(CIRCULATE_PARAMS::kFeed, 1, [](long long t) { return (t & 1) ? 1.0 : 0.0; });
+				B.addPoints(CIRCULATE_PARAMS::kFocus, B.numSamples, [](long long) { return 1.0; });
+				B.addPoints(CIRCULATE_PARAMS::kSidechain, B.numSamples, [](long long) { return 1.0; });
+				B.addPoints(CIRCULATE_PARAMS::kChord, B.numSamples, [](long long) { return listValue(CIRCULATE_PARAMS::kChordMajor, CIRCULATE_PARAMS::kNumChordModes); });
+			}, true },
+	};
+
+	/// <summary>
+	/// One row per case: the timing distribution in microseconds, then each counter per sample,
+	/// empty when it isn't available
+	/// </summary>
+	void writeCsvRow(FILE* out, const char* scenario, int blockSize, int numStages, int topology, const BENCH::TimingStats& Stats,
+		size_t deadlineMisses, const BENCH::PerfCounters& Counters) {
+		long long numSamples = std::max<long long>(Stats.getTotalSamples(), 1);
+		fprintf(out, "%s,%d,%d,%s,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu", scenario, blockSize, numStages, TopologyNames[topology], Stats.getNumCalls(),
+			Stats.getTotal() / std::max<size_t>(Stats.getNumCalls(), 1) / 1000.0, Stats.getPercentile(50) / 1000.0,
+			Stats.getPercentile(99) / 1000.0, Stats.getPercentile(99.9) / 1000.0, Stats.getPercentile(100) / 1000.0,
+			Stats.getTotal() / numSamples, deadlineMisses);
+		for (int id = 0; id < BENCH::kNumCounters; id++) {
+			double value = 0.0;
+			if (Counters.read(id, value)) {
+				fprintf(out, ",%.4f", value / numSamples);
+			}
+			else {
+				fprintf(out, ",");
+			}
+		}
+		fprintf(out, "\n");
+	}
+
+	bool parseOptions(int argc, char** argv, StressOptions& Options) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--rate" && hasValue) Options.sampleRate = atof(argv[++i]);
+			else if (arg == "--seconds" && hasValue) Options.seconds = atof(argv[++i]);
+			else if (arg == "--deadline-percent" && hasValue) Options.deadlinePercent = atof(argv[++i]);
+			else if (arg == "--scenario" && hasValue) Options.scenario = argv[++i];
+			else if (arg == "--trace" && hasValue) Options.tracePath = argv[++i];
+			else if (arg == "--stage-limit" && hasValue) Options.stageLimit = atoi(argv[++i]);
+			else if (arg == "--csv" && hasValue) Options.csvPath = argv[++i];
+			else if (arg == "--counters") Options.counters = true;
+			else if (arg == "--strict") Options.strict = true;
+			else if (arg == "--depths" && hasValue) {
+				if (!parseList(argv[++i], Options.Depths)) return false;
+			}
+			else if (arg == "--topologies" && hasValue) {
+				if (!parseTopologies(argv[++i], Options.Topologies)) return false;
+			}
+			else if (arg == "--blocks" && hasValue) {
+				std::string list = argv[++i];
+				Options.BlockSizes.clear();
+				if (list == "random") {
+					Options.randomBlockSizes = true;
+					Options.BlockSizes.push_back(4096);
+					continue;
+				}
+				if (!parseList(list, Options.BlockSizes)) return false;
+				for (int size : Options.BlockSizes) {
+					if (size <= 0) return false;
+				}
+			}
+			else return false;
+		}
+
+		for (int depth : Options.Depths) {
+			if (depth > Options.stageLimit) return false;
+		}
+		return !Options.BlockSizes.empty() && Options.sampleRate > 0.0 && Options.seconds > 0.0 &&
+			Options.stageLimit > 0 && Options.stageLimit <= MAX_NUM_STAGES;
+	}
+
+	/// <summary>
+	/// Run one scenario at one (max) block size, number of stages and topology, timing every block.
+	/// The counters, when open, count the timed blocks only
+	/// </summary>
+	void runScenario(const Scenario& S, int maxBlockSize, int numStages, int topology, bool randomBlockSizes, const StressOptions& Options,
+		BENCH::TimingStats& Stats, BENCH::PerfCounters& Counters, size_t& deadlineMisses) {
+		CIRCULATE_PARAMS::AudioEffectParameters Params(static_cast<int>(Options.sampleRate));
+		CirculateEffect Effect;
+		Effect.setStageLimit(Options.stageLimit);
+		Effect.setTopology(topology);
+		HELPERS::SetupInfo Setup;
+		Setup.blockSize = maxBlockSize;
+		Setup.sampleRate = Options.sampleRate;
+		Effect.setSampleRateBlockSize(Setup);
+		Effect.getParams(&Params);
+		Effect.reset();
+
+		// Static Depth (the heaviest by default) unless the scenario automates it
+		double depth = static_cast<double>(numStages) / Options.stageLimit;
+		Params.Depth.fillWith(depth);
+		Params.Depth.lastExplicit = depth;
+
+		ParameterChanges Changes(8);
+		std::vector<float> In(maxBlockSize), Out(maxBlockSize), Sidechain(maxBlockSize);
+		unsigned rng = 1;
+
+		BlockContext B;
+		B.Changes = &Changes;
+		B.in = In.data();
+		B.sidechain = Sidechain.data();
+		B.rng = &rng;
+
+		long long totalSamples = static_cast<long long>(Options.seconds * Options.sampleRate);
+		long long position = 0;
+		deadlineMisses = 0;
+
+		while (position < totalSamples) {
+			int numSamples = maxBlockSize;
+			if (randomBlockSizes) {
+				rng = rng * 1664525u + 1013904223u;
+				numSamples = 1 + static_cast<int>((rng >> 8) % maxBlockSize);
+			}
+
+			Changes.clearQueue();
+			B.numSamples = numSamples;
+			B.position = position;
+			S.fill(B);
+
+			Counters.start();
+			auto start = BENCH::Clock::now();
+			{
+				DenormalHandler AntiDenormal;
+				CIRCULATE_TRACE_SCOPE(S.name);
+
+				{
+					CIRCULATE_TRACE_SCOPE("queue decode");
+					for (int32 q = 0; q < Changes.getParameterCount(); q++) {
+						Params.setParamQueue(Changes.getParameterData(q));
+					}
+				}
+
+				// Chunked as in the processor
+				for (int chunkStart = 0; chunkStart < numSamples; chunkStart += PROCESS_CHUNK_SIZE) {
+					int chunkSize = std::min<int>(PROCESS_CHUNK_SIZE, numSamples - chunkStart);
+					{
+						CIRCULATE_TRACE_SCOPE("parameters");
+						Params.setCurrentBlockSizeAndPreFill(chunkSize);
+						Params.readParamChanges(chunkStart, chunkSize);
+						Params.smoothAllParameters();
+					}
+
+					Effect.getBlock(In.data() + chunkStart, Out.data() + chunkStart, chunkSize,
+						S.useSidechain ? Sidechain.data() + chunkStart : nullptr);
+				}
+				Params.finishParamQueues();
+			}
+			double ns = BENCH::elapsedNs(start, BENCH::Clock::now());
+			Counters.stop();
+
+			double deadlineNs = numSamples / Options.sampleRate * 1e9 * Options.deadlinePercent / 100.0;
+			if (ns > deadlineNs) {
+				deadlineMisses++;
+			}
+			Stats.add(ns, numSamples);
+			position += numSamples;
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	StressOptions Options;
+	if (!parseOptions(argc, argv, Options)) {
+		fprintf(stderr, "usage: %s [--rate hz] [--blocks 32,128,512|random] [--seconds s] [--deadline-percent p] "
+			"[--scenario name] [--stage-limit n] [--depths 8,32,64] [--topologies svf,lattice,tdf2] [--counters] [--csv file] "
+			"[--strict] [--trace file]\n\n"
+			"scenarios:\n", argv[0]);
+		for (const Scenario& S : Scenarios) {
+			fprintf(stderr, "  %-22s %s\n", S.name, S.description);
+		}
+		return 1;
+	}
+
+	printf("%.0f Hz, %.1f s per run, deadline %.0f %% of the block duration, stage limit %d\n", Options.sampleRate, Options.seconds,
+		Options.deadlinePercent, Options.stageLimit);
+
+	BENCH::PerfCounters Counters;
+	if (Options.counters && !Counters.open()) {
+		return 1;
+	}
+
+	FILE* csv = nullptr;
+	if (!Options.csvPath.empty()) {
+		csv = fopen(Options.csvPath.c_str(), "w");
+		if (!csv) {
+			fprintf(stderr, "Can't write %s\n", Options.csvPath.c_str());
+			return 1;
+		}
+		fprintf(csv, "scenario,block,stages,topology,blocks,mean_us,p50_us,p99_us,p99.9_us,max_us,ns_per_sample,deadline_misses");
+		for (int id = 0; id < BENCH::kNumCounters; id++) {
+			fprintf(csv, ",%s_per_sample", BENCH::PerfCounters::getName(id));
+		}
+		fprintf(csv, "\n");
+	}
+
+	// Scenarios that automate Depth run the same at every depth
+	std::vector<int> Depths = Options.Depths;
+	if (Depths.empty()) {
+		Depths.push_back(Options.stageLimit);
+	}
+	std::vector<int> Topologies = Options.Topologies;
+	if (Topologies.empty()) {
+		Topologies.push_back(CASCADE::kTopologySVF);
+	}
+
+	// Trace builds: the buffer of this thread, allocated before the timed blocks
+	CIRCULATE_TRACE_RESERVE(1);
+
+	bool anyMissed = false;
+	for (const Scenario& S : Scenarios) {
+		if (!Options.scenario.empty() && Options.scenario != S.name) continue;
+
+		for (int blockSize : Options.BlockSizes) {
+			for (int numStages : Depths) {
+				for (int topology : Topologies) {
+					BENCH::TimingStats Stats;
+					size_t deadlineMisses = 0;
+					Counters.clear();
+					runScenario(S, blockSize, numStages, topology, Options.randomBlockSizes, Options, Stats, Counters, deadlineMisses);
+
+					char label[64];
+					if (Options.randomBlockSizes) {
+						snprintf(label, sizeof(label), "%s/1-%d", S.name, blockSize);
+					}
+					else {
+						snprintf(label, sizeof(label), "%s/%d", S.name, blockSize);
+					}
+					if (!Options.Depths.empty()) {
+						size_t length = strlen(label);
+						snprintf(label + length, sizeof(label) - length, " x%d", numStages);
+					}
+					if (!Options.Topologies.empty()) {
+						size_t length = strlen(label);
+						snprintf(label + length, sizeof(label) - length, " %s", TopologyNames[topology]);
+					}
+
+					// Deadline misses are counted per block, as the deadline scales with random block sizes
+					Stats.print(stdout, label, 0.0);
+					if (Counters.isOpen()) {
+						Counters.print(stdout, "", Stats.getTotalSamples());
+					}
+					if (deadlineMisses > 0) {
+						printf("%-28s %zu of %zu blocks over the deadline\n", "", deadlineMisses, Stats.getNumCalls());
+						anyMissed = true;
+					}
+					if (csv) {
+						writeCsvRow(csv, S.name, blockSize, numStages, topology, Stats, deadlineMisses, Counters);
+					}
+				}
+			}
+		}
+	}
+
+	if (csv) {
+		fclose(csv);
+	}
+
+	if (!Options.tracePath.empty() && !CIRCULATE_TRACE_EXPORT(Options.tracePath.c_str())) {
+		fprintf(stderr, "No trace written, build with CIRCULATE_ENABLE_TRACE\n");
+	}
+
+	return (Options.strict && anyMissed) ? 2 : 0;
+}